@@ -0,0 +1,171 @@
+//
+//  affinity.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#endif
+
+#include "affinity.hpp"
+
+namespace Affinity {
+
+    bool ParsePin(std::string_view name, Pin &pin)
+    {
+        if (name == "none") pin = Pin::None;
+        else if (name == "core") pin = Pin::Core;
+        else if (name == "node") pin = Pin::Node;
+        else return false;
+        return true;
+    }
+
+    const char* Name(Pin pin)
+    {
+        switch (pin) {
+            case Pin::Core: return "core";
+            case Pin::Node: return "node";
+            default: return "none";
+        }
+    }
+
+    static bool s_number(std::string_view s, int &n)
+    {
+        auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), n);
+        return ec == std::errc() && end == s.data() + s.size() && n >= 0;
+    }
+
+    bool ParseCpuList(std::string_view list, std::vector<int> &cpus)
+    {
+        cpus.clear();
+        while (!list.empty() && (list.back() == '\n' || list.back() == ' ')) list.remove_suffix(1);
+        while (!list.empty()) {
+            const auto comma = list.find(',');
+            auto range = list.substr(0, comma);
+            list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+
+            int first, last;
+            const auto dash = range.find('-');
+            if (!s_number(range.substr(0, dash), first)) return false;
+            if (dash == std::string_view::npos) last = first;
+            else if (!s_number(range.substr(dash + 1), last) || last < first) return false;
+            for (int c = first; c <= last; c++) cpus.push_back(c);
+        }
+        return true;
+    }
+
+    // The CPUs this process may run on.
+    static std::vector<int> s_allowed()
+    {
+        std::vector<int> cpus;
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+            for (int c = 0; c < CPU_SETSIZE; c++) if (CPU_ISSET(c, &set)) cpus.push_back(c);
+#endif
+        if (cpus.empty())
+            for (int c = 0; c < std::max(1, static_cast<int>(std::thread::hardware_concurrency())); c++) cpus.push_back(c);
+        return cpus;
+    }
+
+    std::vector<Node> Topology()
+    {
+        const auto allowed = s_allowed();
+        std::vector<Node> nodes;
+#if defined(__linux__)
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", ec)) {
+            const auto name = entry.path().filename().string();
+            Node node;
+            if (!name.starts_with("node") || !s_number(std::string_view(name).substr(4), node.id)) continue;
+
+            std::ifstream is(entry.path() / "cpulist");
+            std::string list;
+            std::vector<int> cpus;
+            if (!std::getline(is, list) || !ParseCpuList(list, cpus)) continue;
+            for (const int c : cpus)
+                if (std::binary_search(allowed.begin(), allowed.end(), c)) node.cpus.push_back(c);
+            if (!node.cpus.empty()) nodes.push_back(std::move(node));
+        }
+        std::sort(nodes.begin(), nodes.end(), [](const Node &a, const Node &b) { return a.id < b.id; });
+#endif
+        if (nodes.empty()) nodes.push_back({-1, allowed});
+        return nodes;
+    }
+
+    std::vector<Placement> Place(Pin pin, const std::vector<Node> &nodes, int engines, int threads)
+    {
+        std::vector<Placement> placements(size_t(std::max(0, engines)));
+        if (pin == Pin::None || nodes.empty()) return placements;
+
+        std::vector<int> every;
+        for (const auto& n : nodes) every.insert(every.end(), n.cpus.begin(), n.cpus.end());
+        std::vector<size_t> next(nodes.size());     // the next CPU a node hands out
+
+        for (size_t i = 0; i < placements.size(); i++) {
+            const auto& node = nodes[i % nodes.size()];
+            auto& p = placements[i];
+            if (size_t(threads) > node.cpus.size()) {
+                p.cpus = every;
+                continue;
+            }
+            p.node = node.id;
+            if (pin == Pin::Node) {
+                p.cpus = node.cpus;
+                continue;
+            }
+            auto& at = next[i % nodes.size()];
+            for (int t = 0; t < threads; t++, at++) p.cpus.push_back(node.cpus[at % node.cpus.size()]);
+        }
+        return placements;
+    }
+
+    Scope::Scope(const Placement &placement)
+    {
+#if defined(__linux__)
+        if (!placement.cpus.empty()) {
+            cpu_set_t set, before;
+            CPU_ZERO(&set);
+            for (const int c : placement.cpus) if (c < CPU_SETSIZE) CPU_SET(c, &set);
+            if (sched_getaffinity(0, sizeof(before), &before) == 0 && sched_setaffinity(0, sizeof(set), &set) == 0)
+                for (int c = 0; c < CPU_SETSIZE; c++) if (CPU_ISSET(c, &before)) cpus_.push_back(c);
+        }
+        // the hash is allocated by the engine as it starts: preferred, not bound, a full node still works.
+        constexpr size_t BITS = 8 * sizeof(unsigned long);
+        if (placement.node >= 0 && placement.node < 1024) {
+            nodes_.assign(1024 / BITS, 0);
+            std::vector<unsigned long> mask(1024 / BITS, 0);
+            mask[size_t(placement.node) / BITS] = 1ul << (size_t(placement.node) % BITS);
+            // maxnode counts one more bit than the mask holds.
+            policy_ = syscall(SYS_get_mempolicy, &mode_, nodes_.data(), 1024 + 1, nullptr, 0) == 0
+                   && syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(), 1024 + 1) == 0;
+        }
+#else
+        (void)placement;
+#endif
+    }
+
+    Scope::~Scope()
+    {
+#if defined(__linux__)
+        if (!cpus_.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (const int c : cpus_) CPU_SET(c, &set);
+            sched_setaffinity(0, sizeof(set), &set);
+        }
+        if (policy_) syscall(SYS_set_mempolicy, mode_, nodes_.data(), 1024 + 1);
+#endif
+    }
+}
@@ -0,0 +1,71 @@
+//
+//  affinity.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef affinity_hpp
+#define affinity_hpp
+
+#include <stdio.h>
+#include <string_view>
+#include <vector>
+
+// Pins the engine processes to cores, and keeps each one on a NUMA node: an engine that migrates to the
+// other socket finds its hash in the memory of the first one. The CPU mask and the memory policy of a
+// process are inherited by the processes it forks (and their threads), so the engine is started with
+// the placement set on the thread that forks it, then the thread gets its own back.
+// Linux only: elsewhere nothing is pinned.
+namespace Affinity {
+
+    enum class Pin {
+        None,   // the scheduler places the engines
+        Core,   // every engine on cores of its own (as many as its threads), all on one node
+        Node,   // every engine on the cores of a node, shared with the other engines of the node
+    };
+
+    // Parses --pin: "none", "core" or "node".
+    bool ParsePin(std::string_view name, Pin &pin);
+    const char* Name(Pin pin);
+
+    struct Node {
+        int id {-1};            // -1: unknown, no NUMA information
+        std::vector<int> cpus;
+    };
+
+    // Where an engine runs: no cpus is anywhere, no node (-1) is wherever its memory is first touched.
+    struct Placement {
+        std::vector<int> cpus;
+        int node {-1};
+    };
+
+    // Parses a kernel CPU list, "0-3,8,10-11". False if it is malformed.
+    bool ParseCpuList(std::string_view list, std::vector<int> &cpus);
+
+    // The NUMA nodes of the machine with the CPUs we may run on (sched_getaffinity), the ones without any
+    // left out. A single node of unknown id where there is no NUMA information.
+    std::vector<Node> Topology();
+
+    // The placements of `engines` engines of `threads` threads each, spread round robin over the nodes.
+    // With Pin::Core a node hands out its CPUs in order, and again from the first once they are all
+    // taken. An engine with more threads than a node has CPUs gets every CPU, and no node.
+    std::vector<Placement> Place(Pin pin, const std::vector<Node> &nodes, int engines, int threads);
+
+    // The processes forked by this thread while the scope lives run on the placement. Failures (no such
+    // CPU, no NUMA support) leave the thread, and the engine, as they were.
+    class Scope {
+    public:
+        explicit Scope(const Placement &placement);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        std::vector<int> cpus_;             // the CPUs of the thread before, empty if not pinned
+        bool policy_ {false};               // the memory policy was changed
+        int mode_ {};
+        std::vector<unsigned long> nodes_;  // the node mask of the memory policy before
+    };
+}
+
+#endif /* affinity_hpp */
@@ -0,0 +1,495 @@
+//
+//  batch.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "batch.hpp"
+#include "ingest.hpp"
+#include "interrupt.hpp"
+#include "notation.hpp"
+#include "sharpness.hpp"
+#include "utils.hpp"
+
+namespace Batch {
+    using namespace Stockfish;
+
+    bool ParseLine(std::string_view line, std::string &fen, std::string &id)
+    {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) line.remove_suffix(1);
+        if (line.empty() || line.front() == '#') return false;
+
+        // board, side to move, castling and en passant are always there.
+        std::istringstream is {std::string(line)};
+        std::string field;
+        fen.clear();
+        id.clear();
+        for (int i = 0; i < 4 && is >> field; i++) {
+            if (i) fen += ' ';
+            fen += field;
+        }
+
+        // a FEN has the two counters next, an EPD has operations ("id \"name\";", "hmvc 3;", ...).
+        std::string rest;
+        std::getline(is, rest);
+        std::istringstream ops(rest);
+        std::string counters[2];
+        if ((ops >> counters[0] >> counters[1])
+            && std::all_of(counters[0].begin(), counters[0].end(), ::isdigit)
+            && std::all_of(counters[1].begin(), counters[1].end(), ::isdigit)) {
+            fen += ' ' + counters[0] + ' ' + counters[1];
+            return true;
+        }
+
+        // the counters of an EPD are the hmvc and fmvn operations, written by -s.
+        if (auto halfmove = Operation(line, "hmvc"), fullmove = Operation(line, "fmvn"); !halfmove.empty() && !fullmove.empty()
+            && std::all_of(halfmove.begin(), halfmove.end(), ::isdigit) && std::all_of(fullmove.begin(), fullmove.end(), ::isdigit))
+            fen += ' ' + halfmove + ' ' + fullmove;
+
+        if (auto pos = rest.find("id "); pos != std::string::npos) {
+            auto start = rest.find('"', pos);
+            auto end = start == std::string::npos ? start : rest.find('"', start + 1);
+            if (end != std::string::npos) id = rest.substr(start + 1, end - start - 1);
+        }
+        return true;
+    }
+
+    static std::string_view s_trim(std::string_view s)
+    {
+        auto first = s.find_first_not_of(" \t");
+        if (first == std::string_view::npos) return {};
+        return s.substr(first, s.find_last_not_of(" \t") - first + 1);
+    }
+
+    std::string Operation(std::string_view line, std::string_view opcode)
+    {
+        // the operations come after the four fields of the position.
+        size_t start = 0;
+        for (int i = 0; i < 4; i++) {
+            start = line.find_first_not_of(" \t", start);
+            start = start == std::string_view::npos ? start : line.find_first_of(" \t", start);
+            if (start == std::string_view::npos) return {};
+        }
+
+        // "opcode operand...;", a ';' between quotes does not end the operation.
+        auto ops = line.substr(start);
+        while (!ops.empty()) {
+            size_t end = 0;
+            for (bool quoted = false; end < ops.size() && (quoted || ops[end] != ';'); end++)
+                if (ops[end] == '"') quoted = !quoted;
+            auto op = s_trim(ops.substr(0, end));
+            ops.remove_prefix(std::min(end + 1, ops.size()));
+
+            auto space = op.find_first_of(" \t");
+            if (op.substr(0, space) != opcode) continue;
+            auto operand = space == std::string_view::npos ? std::string_view() : s_trim(op.substr(space));
+            if (operand.size() >= 2 && operand.front() == '"' && operand.back() == '"')
+                operand = operand.substr(1, operand.size() - 2);
+            return std::string(operand);
+        }
+        return {};
+    }
+
+    // The fields of the position itself, see Sketch::Fields.
+    static Sketch::Fields s_fields(const ::Position &pos, const Record &r)
+    {
+        return {pos.side_to_move(), popcount(pos.pieces()), r.legal_moves, r.depth};
+    }
+
+    // The record of pos before any search. True if there is something to ask the engine.
+    static bool s_begin(Record &r, ::Position &pos, int depth)
+    {
+        r.fen = pos.fen();
+        r.depth = depth;
+        r.legal_moves = count_legal(pos).total;
+
+        // nothing to ask the engine: mate or stalemate.
+        if (r.legal_moves == 0) {
+            r.eval = !pos.checkers() ? 0 : pos.side_to_move() == WHITE ? -1 : 1;
+            return false;
+        }
+        return true;
+    }
+
+    // The sharpness and the moves of the record, from the evaluations of the moves.
+    static void s_finish(Record &r, ::Position &pos, const MoveList<LEGAL> &moves, const std::vector<double> &evals)
+    {
+        r.sharpness = Sharpness::TotalVar(evals, r.eval, pos.side_to_move());
+
+        r.moves.reserve(evals.size());
+        for (size_t i = 0; i < evals.size(); i++) {
+            Notation::MoveBuffer san, lan;
+            Notation::to_san(pos, moves.begin()[i], san);
+            Notation::to_lan(moves.begin()[i], lan);
+            double loss = pos.side_to_move() == WHITE ? r.eval - evals[i] : evals[i] - r.eval;
+            r.moves.push_back({san, lan, evals[i], loss, Sharpness::Verdict(loss)});
+        }
+        std::stable_sort(r.moves.begin(), r.moves.end(), [](const auto &a, const auto &b) { return a.loss < b.loss; });
+    }
+
+    Record Analyse(Engine &engine, ::Position &pos)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Record r {};
+        if (!s_begin(r, pos, engine.Depth())) return r;
+
+        // same as Sharpness::ComputePosition, but we keep the evaluations for the record.
+        r.eval = engine.Eval(pos);
+        auto moves = pos.GetMoves();
+        auto evals = engine.EvalMoves(moves, pos);
+        s_finish(r, pos, moves, evals);
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        r.seconds = elapsed.count();
+        return r;
+    }
+
+    Coro::Task<Record> Analyse(Coro::Engine &engine, ::Position &pos)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Record r {};
+        if (!s_begin(r, pos, engine.Depth())) co_return r;
+
+        auto moves = pos.GetMoves();
+        std::vector<Coro::Task<double>> searches;
+        searches.push_back(engine.Eval(pos));
+        for (const auto m : moves) searches.push_back(engine.EvalMove(m, pos));
+        auto evals = co_await Coro::All(std::move(searches));
+        r.eval = evals.front();
+        evals.erase(evals.begin());
+        s_finish(r, pos, moves, evals);
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        r.seconds = elapsed.count();
+        co_return r;
+    }
+
+    static void s_report(std::ostream &log, size_t done, size_t failed, std::chrono::steady_clock::time_point start)
+    {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        double per_minute = elapsed.count() > 0 ? 60.0 * static_cast<double>(done) / elapsed.count() : 0;
+        log << "[batch] " << done << " positions (" << failed << " failed) in " << elapsed.count() << "s, "
+        << per_minute << " positions/min" << std::endl;
+    }
+
+    // next_line(std::string_view&) gives the next line of the input, false at the end.
+    template<typename NextLine>
+    static size_t s_run(Engine &engine, NextLine &&next_line, std::ostream &out, std::ostream &log, const Options &opts)
+    {
+        auto start = std::chrono::steady_clock::now();
+        size_t done {}, failed {}, resumed {};
+        std::string fen, id;
+        std::string_view line;
+        ::Position pos {};
+
+        // formatting and writing happen on the writer thread, a slow reader does not hold the engine.
+        Output::Writer writer(out, opts.format);
+        while (!Interrupt::Requested() && next_line(line)) {
+            if (!ParseLine(line, fen, id)) continue;
+            if (id.empty()) id = std::to_string(done + 1);
+
+            Record r {};
+            try {
+                pos.Set(fen);
+                if (auto journaled = opts.journal ? opts.journal->Find(done, pos.fen()) : nullptr) {
+                    r = *journaled;
+                    resumed++;
+                } else {
+                    r = Analyse(engine, pos);
+                    if (opts.journal) opts.journal->Append(done, r);
+                }
+                // the store starts over with every run, the resumed positions are written to it too.
+                if (opts.store) opts.store->Append(pos, r);
+                if (opts.report) {
+                    auto fields = s_fields(pos, r);
+                    fields.source = [&](std::string_view opcode) { return Operation(line, opcode); };
+                    opts.report->Add(fields, r.sharpness);
+                }
+            } catch (const std::runtime_error &e) {
+                // most likely the signal cut the engine short: the position is analysed again on resume.
+                if (Interrupt::Requested()) break;
+                r.fen = fen;
+                r.depth = engine.Depth();
+                r.error = e.what();
+                failed++;
+            }
+            r.id = id;
+            writer.Push(std::move(r));
+
+            done++;
+            if (opts.report_every && done % opts.report_every == 0) s_report(log, done, failed, start);
+        }
+        s_report(log, done, failed, start);
+        if (resumed) log << "[batch] " << resumed << " positions taken from the journal" << std::endl;
+        if (Interrupt::Requested()) log << "[batch] interrupted after " << done << " positions" << std::endl;
+
+        return done;
+    }
+
+    size_t Run(Engine &engine, std::istream &in, std::ostream &out, std::ostream &log, const Options &opts)
+    {
+        std::string buffer;
+        return s_run(engine, [&](std::string_view &line) {
+            if (!std::getline(in, buffer)) return false;
+            line = buffer;
+            return true;
+        }, out, log, opts);
+    }
+
+    size_t Run(Engine &engine, std::string_view text, std::ostream &out, std::ostream &log, const Options &opts)
+    {
+        Ingest::RecordCursor cursor(text, Ingest::Format::Lines);
+        return s_run(engine, [&](std::string_view &line) { return cursor.Next(line); }, out, log, opts);
+    }
+
+    // A position of a run over a Reactor::Loop, from its line to its record.
+    struct Pending {
+        size_t index {};            // in the input, for the journal
+        std::string line;           // the operations, for the report
+        std::string id;
+        std::string fen;
+        Record r {};
+        bool done {};
+        bool analysed {};           // by the engines, not taken from the journal
+    };
+
+    // The errors of the engines are the record of the position.
+    static Coro::Task<void> s_analyse(Coro::Engine &engine, Pending &p)
+    {
+        ::Position pos {};
+        pos.Set(p.fen);
+        try {
+            p.r = co_await Analyse(engine, pos);
+        } catch (const std::runtime_error &e) {
+            p.r = {.fen = pos.fen(), .depth = engine.Depth(), .error = e.what()};
+        }
+        p.done = true;
+    }
+
+    // next_line(std::string_view&) gives the next line of the input, false at the end.
+    template<typename NextLine>
+    static size_t s_run(Reactor::Loop &loop, int depth, NextLine &&next_line, std::ostream &out, std::ostream &log,
+                        const Options &opts)
+    {
+        auto start = std::chrono::steady_clock::now();
+        size_t read {}, done {}, failed {}, resumed {};
+        std::string fen, id;
+        std::string_view line;
+        bool eof {false};
+
+        // a couple of positions per engine keep every engine busy, even at the end of a position.
+        const size_t max_in_flight = 2 * loop.engines();
+        std::deque<std::unique_ptr<Pending>> window;
+        // a transposition between two positions of the input is searched once.
+        Coro::Searches searches;
+        Coro::Scheduler scheduler(loop);
+        Coro::Engine engine(loop, depth, &searches);
+
+        Output::Writer writer(out, opts.format);
+        while (true) {
+            // no new position after a signal, the ones in flight are finished and written.
+            while (!eof && !Interrupt::Requested() && window.size() < max_in_flight) {
+                if (!next_line(line)) { eof = true; break; }
+                if (!ParseLine(line, fen, id)) continue;
+
+                auto p = std::make_unique<Pending>();
+                p->index = read++;
+                p->line = line;
+                p->id = id.empty() ? std::to_string(read) : id;
+                try {
+                    ::Position pos {};
+                    pos.Set(fen);
+                    p->fen = pos.fen();
+                    if (auto journaled = opts.journal ? opts.journal->Find(p->index, p->fen) : nullptr) {
+                        p->r = *journaled;
+                        p->done = true;
+                        resumed++;
+                    }
+                } catch (const std::runtime_error &e) {
+                    p->r = {.fen = fen, .depth = depth, .error = e.what()};
+                    p->done = true;
+                }
+                window.push_back(std::move(p));
+                if (!window.back()->done) {
+                    window.back()->analysed = true;
+                    scheduler.Spawn(s_analyse(engine, *window.back()));
+                }
+            }
+
+            // records are written in the input order, each one as soon as the ones before it are.
+            while (!window.empty() && window.front()->done) {
+                Pending &p = *window.front();
+                if (!p.r.error.empty()) {
+                    failed++;
+                } else {
+                    ::Position pos {};
+                    pos.Set(p.r.fen);
+                    if (opts.store) opts.store->Append(pos, p.r);
+                    if (p.analysed && opts.journal) opts.journal->Append(p.index, p.r);
+                    if (opts.report) {
+                        auto fields = s_fields(pos, p.r);
+                        fields.source = [&](std::string_view opcode) { return Operation(p.line, opcode); };
+                        opts.report->Add(fields, p.r.sharpness);
+                    }
+                }
+                p.r.id = std::move(p.id);
+                writer.Push(std::move(p.r));
+                window.pop_front();
+
+                done++;
+                if (opts.report_every && done % opts.report_every == 0) s_report(log, done, failed, start);
+            }
+
+            if (window.empty() && (eof || Interrupt::Requested())) break;
+            scheduler.Poll();
+        }
+        s_report(log, done, failed, start);
+        log << "[batch] " << loop.alive() << " of " << loop.engines() << " engines, "
+        << searches.searched() << " searches run for " << searches.asked() << " asked, "
+        << (loop.completed() ? loop.nodes() / loop.completed() : 0) << " nodes per search, "
+        << loop.stolen() << " off their engine" << std::endl;
+        if (loop.nps()) log << "[batch] " << loop.nps() << " nodes per second per engine" << std::endl;
+        if (loop.replaced()) log << "[batch] " << loop.replaced() << " engines replaced by a spare" << std::endl;
+        if (loop.retried()) log << "[batch] " << loop.retried() << " searches run again, their engine exited" << std::endl;
+        if (resumed) log << "[batch] " << resumed << " positions taken from the journal" << std::endl;
+        if (Interrupt::Requested()) log << "[batch] interrupted after " << done << " positions" << std::endl;
+
+        return done;
+    }
+
+    size_t Run(Reactor::Loop &loop, int depth, std::istream &in, std::ostream &out, std::ostream &log, const Options &opts)
+    {
+        std::string buffer;
+        return s_run(loop, depth, [&](std::string_view &line) {
+            if (!std::getline(in, buffer)) return false;
+            line = buffer;
+            return true;
+        }, out, log, opts);
+    }
+
+    size_t Run(Reactor::Loop &loop, int depth, std::string_view text, std::ostream &out, std::ostream &log, const Options &opts)
+    {
+        Ingest::RecordCursor cursor(text, Ingest::Format::Lines);
+        return s_run(loop, depth, [&](std::string_view &line) { return cursor.Next(line); }, out, log, opts);
+    }
+
+    std::string AnnotateGame(Engine &engine, Pgn::Game &game, Store::Writer *store, Sketch::Report *report)
+    {
+        ::Position pos {};
+        try {
+            pos.Set(game.InitialFen());
+        } catch (const std::runtime_error &e) {
+            return e.what();
+        }
+
+        for (auto& ply : game.plies) {
+            Move m = Notation::from_san(pos, ply.san);
+            if (m == MOVE_NONE) return "illegal move " + ply.san + " in " + pos.fen();
+            // written back as standard SAN, whatever the suffixes of the input.
+            Notation::MoveBuffer san;
+            Notation::to_san(pos, m, san, Notation::Checks::Pgn);
+            ply.san = san;
+            pos.DoMove(m);
+
+            auto r = Analyse(engine, pos);
+            if (store) store->Append(pos, r);
+            if (report) {
+                auto fields = s_fields(pos, r);
+                fields.source = [&](std::string_view tag) { return game.Tag(std::string(tag)); };
+                report->Add(fields, r.sharpness);
+            }
+            std::ostringstream cmd;
+            cmd << std::fixed << std::setprecision(4) << "[%sharp " << r.sharpness << ' ' << r.eval << ']';
+            ply.comment = ply.comment.empty() ? cmd.str() : cmd.str() + ' ' + ply.comment;
+        }
+        return {};
+    }
+
+    // next_game(Pgn::Game&) reads the next game of the input, false at the end. It is called under the lock.
+    template<typename NextGame>
+    static size_t s_annotate(std::vector<std::unique_ptr<Engine>> &engines, NextGame &&next_game,
+                             std::ostream &out, std::ostream &log, Store::Writer *store, Sketch::Report *report)
+    {
+        // Each worker takes the next game from the reader, tagged with its position in the input.
+        // Finished games wait in `done` until all the games before them have been written.
+        const size_t max_in_flight = 4 * engines.size();
+        auto start = std::chrono::steady_clock::now();
+
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::map<size_t, Pgn::Game> done;
+        size_t next_read {}, next_write {};
+        bool eof {false};
+
+        auto worker = [&](Engine &engine) {
+            // the plies of a game follow each other on one engine, whose hash is only cleared between games.
+            for (bool first = true; ; first = false) {
+                Pgn::Game game;
+                size_t seq;
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    cv.wait(lock, [&]{ return eof || next_read - next_write < max_in_flight; });
+                    if (eof || Interrupt::Requested()) return;
+                    if (!next_game(game)) { eof = true; cv.notify_all(); return; }
+                    seq = next_read++;
+                }
+
+                if (!first) engine.NewGame();
+                auto error = AnnotateGame(engine, game, store, report);
+
+                std::lock_guard<std::mutex> lock(mtx);
+                if (!error.empty())
+                    log << "[pgn] game " << seq + 1 << " (" << game.Tag("White") << " - " << game.Tag("Black")
+                    << "): " << error << std::endl;
+
+                done.emplace(seq, std::move(game));
+                while (!done.empty() && done.begin()->first == next_write) {
+                    Pgn::Write(out, done.begin()->second);
+                    done.erase(done.begin());
+                    next_write++;
+                }
+                out.flush();
+                cv.notify_all();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (auto& engine : engines) threads.emplace_back(worker, std::ref(*engine));
+        for (auto& t : threads) t.join();
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        log << "[pgn] " << next_write << " games in " << elapsed.count() << "s, "
+        << (elapsed.count() > 0 ? 60.0 * static_cast<double>(next_write) / elapsed.count() : 0) << " games/min"
+        << " (" << engines.size() << " engines)" << std::endl;
+
+        return next_write;
+    }
+
+    size_t AnnotatePgn(std::vector<std::unique_ptr<Engine>> &engines, std::istream &in, std::ostream &out,
+                       std::ostream &log, Store::Writer *store, Sketch::Report *report)
+    {
+        Pgn::Reader reader(in);
+        return s_annotate(engines, [&](Pgn::Game &game) { return reader.Next(game); }, out, log, store, report);
+    }
+
+    size_t AnnotatePgn(std::vector<std::unique_ptr<Engine>> &engines, std::string_view text, std::ostream &out,
+                       std::ostream &log, Store::Writer *store, Sketch::Report *report)
+    {
+        Ingest::RecordCursor cursor(text, Ingest::Format::Pgn);
+        return s_annotate(engines, [&](Pgn::Game &game) {
+            for (std::string_view record; cursor.Next(record); )
+                if (Pgn::Parse(record, game)) return true;
+            return false;
+        }, out, log, store, report);
+    }
+}
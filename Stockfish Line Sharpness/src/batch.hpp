@@ -0,0 +1,86 @@
+//
+//  batch.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef batch_hpp
+#define batch_hpp
+
+#include <stdio.h>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <vector>
+
+#include "stock_wrapper.hpp"
+#include "pgn.hpp"
+#include "output.hpp"
+#include "store.hpp"
+#include "journal.hpp"
+#include "sketch.hpp"
+#include "reactor.hpp"
+#include "coro.hpp"
+
+// Batch analysis of many positions, on an already started engine or on the engines of a Reactor::Loop
+// (by default one per core, see Plan).
+// Input is read one line at a time and every result is written as soon as it is ready,
+// so memory does not grow with the size of the input.
+namespace Batch {
+
+    using Record = Output::Record;
+
+    struct Options {
+        size_t report_every {100};  // positions between two throughput reports, 0 = only at the end
+        Output::Format format {Output::Format::Text};
+        Store::Writer *store {nullptr};  // if set, every position is also appended to the store, the resumed ones too
+        Journal::Log *journal {nullptr}; // if set, positions found in the journal are not analysed again
+        Sketch::Report *report {nullptr};  // if set, the sharpness of every position is added to it
+    };
+
+    // Splits an EPD or FEN line into the FEN (with the counters, if present) and the id operation.
+    // Returns false for empty lines and comments (starting with '#').
+    bool ParseLine(std::string_view line, std::string &fen, std::string &id);
+    // The operand of an EPD operation ("eco" in "... eco \"B90\";"), unquoted. Empty if not there.
+    std::string Operation(std::string_view line, std::string_view opcode);
+
+    // The complexity is not computed, it costs a search per depth.
+    Record Analyse(Engine &engine, Position &pos);
+    // Same on the engines of a Reactor::Loop (see coro.hpp), the position and its moves are searched together.
+    Coro::Task<Record> Analyse(Coro::Engine &engine, Position &pos);
+
+    // Analyses every position in `in`, writing one record per line to `out` (from a writer thread) and the throughput
+    // (positions per minute) to `log`. Stops after the current position on SIGINT/SIGTERM (see Interrupt).
+    // Returns the number of positions analysed.
+    size_t Run(Engine &engine, std::istream &in, std::ostream &out,
+               std::ostream &log = std::cerr, const Options &opts = {});
+    // Same, over text already in memory (see Ingest::MappedFile), lines are not copied.
+    size_t Run(Engine &engine, std::string_view text, std::ostream &out,
+               std::ostream &log = std::cerr, const Options &opts = {});
+
+    // Same, with the searches spread over the engines of the loop (see Reactor): the position and every
+    // legal move are searches of their own (a search asked twice, by transposition, is run once), two
+    // positions per engine are in flight, the records keep the input order. After SIGINT/SIGTERM the
+    // positions in flight are finished and written.
+    size_t Run(Reactor::Loop &loop, int depth, std::istream &in, std::ostream &out,
+               std::ostream &log = std::cerr, const Options &opts = {});
+    size_t Run(Reactor::Loop &loop, int depth, std::string_view text, std::ostream &out,
+               std::ostream &log = std::cerr, const Options &opts = {});
+
+    // Analyses the position after every ply and adds a "[%sharp <sharpness> <eval>]" command to the
+    // comment of the move. Stops at the first illegal move, returns the error (empty if none).
+    // The positions are also appended to `store` and their sharpness added to `report` (grouped by the
+    // tags of the game), if given.
+    std::string AnnotateGame(Engine &engine, Pgn::Game &game, Store::Writer *store = nullptr,
+                             Sketch::Report *report = nullptr);
+
+    // Annotates every game read from `in` and writes it to `out`. Games are analysed concurrently,
+    // one per engine, but written in the input order; at most 4 games per engine are held in memory.
+    // No new game is started after SIGINT/SIGTERM. Returns the number of games written.
+    size_t AnnotatePgn(std::vector<std::unique_ptr<Engine>> &engines, std::istream &in, std::ostream &out,
+                       std::ostream &log = std::cerr, Store::Writer *store = nullptr, Sketch::Report *report = nullptr);
+    size_t AnnotatePgn(std::vector<std::unique_ptr<Engine>> &engines, std::string_view text, std::ostream &out,
+                       std::ostream &log = std::cerr, Store::Writer *store = nullptr, Sketch::Report *report = nullptr);
+}
+
+#endif /* batch_hpp */
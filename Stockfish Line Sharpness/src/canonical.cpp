@@ -0,0 +1,106 @@
+//
+//  canonical.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <stdexcept>
+
+#include "canonical.hpp"
+#include "fen.hpp"
+
+namespace Canonical {
+    using namespace Stockfish;
+
+    int castling_rights(const Position &pos)
+    {
+        int rights = NO_CASTLING;
+        for (auto cr : {WHITE_OO, WHITE_OOO, BLACK_OO, BLACK_OOO}) {
+            if (!pos.can_castle(cr)) continue;
+
+            Color c = cr & WHITE_CASTLING ? WHITE : BLACK;
+            Square rsq = relative_square(c, cr & KING_SIDE ? SQ_H1 : SQ_A1);
+            if (pos.square<KING>(c) == relative_square(c, SQ_E1)
+                && pos.castling_rook_square(cr) == rsq
+                && pos.piece_on(rsq) == (c == WHITE ? W_ROOK : B_ROOK))
+                rights |= cr;
+        }
+        return rights;
+    }
+
+    Square ep_square(const Position &pos)
+    {
+        Square ep = pos.ep_square();
+        if (ep == SQ_NONE) return SQ_NONE;
+
+        // the pawns that could take are the ones attacking the ep square "backwards".
+        Bitboard b = pawn_attacks_bb(~pos.side_to_move(), ep) & pos.pieces(pos.side_to_move(), PAWN);
+        while (b)
+            if (pos.legal(make<EN_PASSANT>(pop_lsb(b), ep))) return ep;
+
+        return SQ_NONE;
+    }
+
+    Key key(const Position &pos)
+    {
+        // the raw key, key() also mixes in the rule50 counter.
+        Key k = pos.state()->key;
+
+        int rights = castling_rights(pos);
+        if (rights != pos.state()->castlingRights)
+            k ^= Zobrist::castling[pos.state()->castlingRights] ^ Zobrist::castling[rights];
+
+        Square ep = pos.ep_square();
+        if (ep != SQ_NONE && ep_square(pos) == SQ_NONE)
+            k ^= Zobrist::enpassant[file_of(ep)];
+
+        return k;
+    }
+
+    std::string fen(const Position &pos)
+    {
+        // board and side to move are already canonical.
+        std::string full = pos.fen();
+        std::string out = full.substr(0, full.find(' ') + 2);
+        out += ' ';
+
+        int rights = castling_rights(pos);
+        if (rights & WHITE_OO)  out += 'K';
+        if (rights & WHITE_OOO) out += 'Q';
+        if (rights & BLACK_OO)  out += 'k';
+        if (rights & BLACK_OOO) out += 'q';
+        if (!rights) out += '-';
+
+        Square ep = ep_square(pos);
+        if (ep == SQ_NONE) out += " -";
+        else {
+            out += ' ';
+            out += char('a' + file_of(ep));
+            out += char('1' + rank_of(ep));
+        }
+
+        return out + " 0 1";
+    }
+
+    static void s_set(std::string_view fen, Position &pos, StateInfo &si)
+    {
+        FenError err = parseFEN(fen, pos, &si);
+        if (err != FEN_OK)
+            throw std::runtime_error("Please enter a valid FEN string: " + std::string(fen_error_string(err)));
+    }
+
+    std::string fen(std::string_view fen)
+    {
+        StateInfo si;
+        Position pos;
+        s_set(fen, pos, si);
+        return Canonical::fen(pos);
+    }
+
+    Key key(std::string_view fen)
+    {
+        StateInfo si;
+        Position pos;
+        s_set(fen, pos, si);
+        return key(pos);
+    }
+}
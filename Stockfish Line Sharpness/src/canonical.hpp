@@ -0,0 +1,39 @@
+//
+//  canonical.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef canonical_hpp
+#define canonical_hpp
+
+#include <stdio.h>
+#include <string>
+#include <string_view>
+
+#include "mini_stock/position.h"
+
+// The same position can be written in many ways: the move counters depend on the game it comes from,
+// an en passant square is written after every double push even when no pawn can take, and castling
+// rights are sometimes left in after the king or the rook are gone. Canonicalisation removes all of
+// that, so that equal positions coming from different games share the same FEN and the same key.
+namespace Canonical {
+
+    // Castling rights that can still be used at some point: the king and the rook are on their starting squares.
+    int castling_rights(const Stockfish::Position &pos);
+
+    // The en passant square only if there is a legal en passant capture, SQ_NONE otherwise.
+    Stockfish::Square ep_square(const Stockfish::Position &pos);
+
+    // Zobrist key of the canonical position. It does not depend on the move counters.
+    Stockfish::Key key(const Stockfish::Position &pos);
+
+    // FEN of the canonical position, the counters are always "0 1".
+    std::string fen(const Stockfish::Position &pos);
+
+    // Same as above, starting from a FEN string. Throws std::runtime_error if the FEN is not valid.
+    std::string fen(std::string_view fen);
+    Stockfish::Key key(std::string_view fen);
+
+}
+
+#endif /* canonical_hpp */
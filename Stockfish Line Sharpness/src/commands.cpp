@@ -6,29 +6,51 @@
 //
 #include <string>
 #include <iostream>
+#include <stdexcept>
+#include <memory>
+#include <algorithm>
 
 #include "stock_wrapper.hpp"
 #include "utils.hpp"
 #include "sharpness.hpp"
 #include "commands.hpp"
+#include "interrupt.hpp"
 
 
 
 //TODO: Make them more solid, incredibly janky as of now.
-std::vector<double> LineSharpness(Engine &engine, const std::vector<Stockfish::Move> &moves, Position& pos)
+std::vector<double> LineSharpness(Engine &engine, const std::vector<Stockfish::Move> &moves, Position& pos,
+                                  Journal::Log *journal)
 {
     std::vector<double> sharpnesses {};
     sharpnesses.reserve(moves.size()+1);
     Position tmp {pos.fen()};
     
-    auto ratio = Sharpness::ComputePosition(engine, tmp);
-    sharpnesses.emplace_back(ratio);
+    // the i-th position of the line, from the journal if it is there. False if a signal cut the engine short.
+    auto compute = [&](uint64_t i) {
+        if (journal)
+            if (auto r = journal->Find(i, tmp.fen())) { sharpnesses.emplace_back(r->sharpness); return true; }
+        Output::Record r {};
+        r.fen = tmp.fen();
+        r.depth = engine.Depth();
+        try {
+            r.sharpness = Sharpness::ComputePosition(engine, tmp);
+        } catch (const std::runtime_error &) {
+            if (Interrupt::Requested()) return false;
+            throw;
+        }
+        if (journal) journal->Append(i, r);
+        sharpnesses.emplace_back(r.sharpness);
+        return true;
+    };
+    
+    if (Interrupt::Requested() || !compute(0)) return sharpnesses;
     
     for (int count {}; const auto mm : moves) {
+        if (Interrupt::Requested()) break;
         PROGRESS_BAR(count)
         tmp.DoMove(mm);
-        ratio = Sharpness::ComputePosition(engine, tmp);
-        sharpnesses.emplace_back(ratio);
+        if (!compute(count + 1)) break;
         
         ++count;
     }
@@ -36,19 +58,83 @@ std::vector<double> LineSharpness(Engine &engine, const std::vector<Stockfish::M
     return sharpnesses;
 }
 
+static void s_print_position(Position &pos, double base_eval, int depth, double movedist, double pos_complexity)
+{
+    auto moves = Stockfish::count_legal(pos);
+    std::cout << "Eval: " << base_eval << " (depth: " << depth << ")" << std::endl;
+    std::cout << "In this position there are " << moves.total << " possible moves ("
+    << moves.captures << " captures).\n"
+    << (pos.side_to_move() ? "Black" : "White") << " to move" << std::endl;
+    std::cout << "Sharpness ratio of: " << movedist << std::endl;
+    std::cout << "Complexity score of: " << pos_complexity << std::endl;
+}
+
 double PositionSharpness(Engine &engine, Position &pos)
 {
-    auto moves = pos.GetMoves();
     auto movedist = Sharpness::ComputePosition(engine, pos);
     auto pos_complexity = Sharpness::Complexity(engine, pos, engine.Depth());
     // print the ratio
     
     double base_eval = engine.Eval(pos);
-    std::cout << "Eval: " << base_eval << " (depth: " << engine.Depth() << ")" << std::endl;
-    std::cout << "In this position there are " << moves.size() << " possible moves.\n"
-    << (pos.side_to_move() ? "Black" : "White") << " to move" << std::endl;
-    std::cout << "Sharpness ratio of: " << movedist << std::endl;
-    std::cout << "Complexity score of: " << pos_complexity << std::endl;
+    s_print_position(pos, base_eval, engine.Depth(), movedist, pos_complexity);
     
     return movedist;
 }
+
+static Coro::Task<double> s_value(double value)
+{
+    co_return value;
+}
+
+Coro::Task<std::vector<double>> LineSharpness(Coro::Engine &engine, const std::vector<Stockfish::Move> &moves,
+                                              Position &pos, Journal::Log *journal)
+{
+    // every position of the line on its own, they are analysed together.
+    std::vector<std::unique_ptr<Position>> positions;
+    positions.push_back(std::make_unique<Position>(pos.fen()));
+    for (const auto mm : moves) {
+        positions.push_back(std::make_unique<Position>(positions.back()->fen()));
+        positions.back()->DoMove(mm);
+    }
+    
+    std::vector<double> sharpnesses {};
+    sharpnesses.reserve(positions.size());
+    const size_t wave = std::max<size_t>(1, engine.loop().engines());
+    for (size_t first {}; first < positions.size() && !Interrupt::Requested(); first += wave) {
+        const size_t last = std::min(positions.size(), first + wave);
+        std::vector<Coro::Task<double>> analyses;
+        std::vector<bool> journaled;
+        for (size_t i = first; i < last; i++) {
+            const auto* r = journal ? journal->Find(i, positions[i]->fen()) : nullptr;
+            journaled.push_back(r != nullptr);
+            analyses.push_back(r ? s_value(r->sharpness) : Sharpness::ComputePosition(engine, *positions[i]));
+        }
+        auto results = co_await Coro::All(std::move(analyses));
+        
+        for (size_t i = first; i < last; i++) {
+            if (journal && !journaled[i - first]) {
+                Output::Record r {};
+                r.fen = positions[i]->fen();
+                r.depth = engine.Depth();
+                r.sharpness = results[i - first];
+                journal->Append(i, r);
+            }
+            sharpnesses.emplace_back(results[i - first]);
+        }
+    }
+    
+    co_return sharpnesses;
+}
+
+Coro::Task<double> PositionSharpness(Coro::Engine &engine, Position &pos)
+{
+    // the three analyses are independent, they run together.
+    std::vector<Coro::Task<double>> analyses;
+    analyses.push_back(Sharpness::ComputePosition(engine, pos));
+    analyses.push_back(Sharpness::Complexity(engine, pos, engine.Depth()));
+    analyses.push_back(engine.Eval(pos));
+    auto results = co_await Coro::All(std::move(analyses));
+    
+    s_print_position(pos, results[2], engine.Depth(), results[0], results[1]);
+    co_return results[0];
+}
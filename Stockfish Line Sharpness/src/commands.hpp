@@ -11,9 +11,19 @@
 #include <stdio.h>
 
 #include "stock_wrapper.hpp"
+#include "journal.hpp"
+#include "coro.hpp"
 
-std::vector<double> LineSharpness(Engine&, const std::vector<Stockfish::Move>&, Position&);
+// Stops early on SIGINT/SIGTERM (see Interrupt). With a journal, the positions already in it are not analysed again.
+std::vector<double> LineSharpness(Engine&, const std::vector<Stockfish::Move>&, Position&, Journal::Log* = nullptr);
 
 double PositionSharpness(Engine&, Position&);
 
+// The same on the engines of a Reactor::Loop (see coro.hpp): the positions of the line are analysed as many
+// at a time as there are engines, with all their searches in flight.
+Coro::Task<std::vector<double>> LineSharpness(Coro::Engine&, const std::vector<Stockfish::Move>&, Position&,
+                                              Journal::Log* = nullptr);
+
+Coro::Task<double> PositionSharpness(Coro::Engine&, Position&);
+
 #endif /* commands_hpp */
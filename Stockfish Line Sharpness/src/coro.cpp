@@ -0,0 +1,198 @@
+//
+//  coro.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <stdexcept>
+
+#include "coro.hpp"
+#include "canonical.hpp"
+#include "notation.hpp"
+#include "utils.hpp"
+
+namespace Coro {
+
+    Task<void> All(std::vector<Task<void>> tasks)
+    {
+        for (auto& t : tasks) t.Start();
+        std::exception_ptr error;
+        for (auto& t : tasks) {
+            try {
+                co_await t;
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        if (error) std::rethrow_exception(error);
+    }
+
+    void Engine::SearchAwaiter::await_suspend(std::coroutine_handle<> h)
+    {
+        // the awaiter lives in the frame of the suspended coroutine until it is resumed.
+        search.done = [this, h](const Reactor::Result &r) {
+            result = r;
+            h.resume();
+        };
+        loop.Submit(std::move(search));
+    }
+
+    Reactor::Result Engine::SearchAwaiter::await_resume()
+    {
+        if (!result.error.empty()) throw std::runtime_error(result.error);
+        return std::move(result);
+    }
+
+    bool Searches::Awaiter::await_ready() const noexcept
+    {
+        return entry.done;
+    }
+
+    void Searches::Awaiter::await_suspend(std::coroutine_handle<> h)
+    {
+        entry.waiting.push_back(h);
+    }
+
+    Reactor::Result Searches::Awaiter::await_resume()
+    {
+        if (!entry.result.error.empty()) throw std::runtime_error(entry.result.error);
+        return entry.result;
+    }
+
+    Searches::Awaiter Searches::Find(Reactor::Loop &loop, Reactor::Search search)
+    {
+        asked_++;
+        const SearchKey k {search.key, search.depth};
+        auto [it, inserted] = entries_.try_emplace(k);
+        if (inserted) {
+            searched_++;
+            order_.push_back(k);
+            search.done = [this, k](const Reactor::Result &r) { Done(k, r); };
+            loop.Submit(std::move(search));
+        }
+        return {it->second};
+    }
+
+    void Searches::Done(const SearchKey &key, const Reactor::Result &result)
+    {
+        auto it = entries_.find(key);
+        Entry &e = it->second;
+        e.result = result;
+        e.done = true;
+        // the awaiters read the result as they are resumed, the entry can go once they all were.
+        auto waiting = std::move(e.waiting);
+        e.waiting.clear();
+        for (auto h : waiting) h.resume();
+
+        if (!result.error.empty()) {
+            entries_.erase(key);
+            std::erase(order_, key);
+        }
+        // the searches still running are not evicted, the table can be over capacity for a while.
+        while (entries_.size() > capacity_ && entries_.find(order_.front())->second.done) {
+            entries_.erase(order_.front());
+            order_.pop_front();
+        }
+    }
+
+    // The canonical position with its halfmove clock, which the engines scale their evaluation with.
+    static Stockfish::Key s_key(const ::Position &pos)
+    {
+        return Canonical::key(pos) ^ Stockfish::make_key(uint64_t(pos.rule50_count()));
+    }
+
+    // A search shared through the table of the engine, if it has one.
+    static Task<Reactor::Result> s_search(Reactor::Loop &loop, Searches *searches, Reactor::Search search)
+    {
+        Reactor::Result result;
+        if (searches) {
+            result = co_await searches->Find(loop, std::move(search));
+        } else {
+            // a named awaiter: GCC 12 loses track of a braced temporary one across the suspension.
+            Engine::SearchAwaiter awaiter {loop, std::move(search)};
+            result = co_await awaiter;
+        }
+        co_return result;
+    }
+
+    // The score is from the point of view of the side to move of the searched position.
+    static Task<double> s_eval(Task<Reactor::Result> search, Stockfish::Color col)
+    {
+        auto result = co_await search;
+        co_return Utils::lc0_cp_to_win(Utils::centipawns(col, std::vector<std::string>{result.info}) * 100);
+    }
+
+    static Task<std::string> s_best_move(Task<Reactor::Result> search)
+    {
+        auto result = co_await search;
+        co_return result.bestmove;
+    }
+
+    Task<double> Engine::Eval(const ::Position &pos) const
+    {
+        const auto key = s_key(pos);
+        return s_eval(s_search(loop_, searches_, {"fen " + pos.fen(), depth_, {}, key, key}), pos.side_to_move());
+    }
+
+    Task<double> Engine::EvalMove(Stockfish::Move m, const ::Position &pos) const
+    {
+        Notation::MoveBuffer lan;
+        Notation::to_lan(m, lan);
+        // the position after the move: the same search as its eval, routed with the other moves of pos.
+        ::Position child(pos.fen());
+        child.DoMove(m);
+        Reactor::Search search {"fen " + pos.fen() + " moves " + lan, depth_, {}, s_key(child), s_key(pos)};
+        return s_eval(s_search(loop_, searches_, std::move(search)), ~pos.side_to_move());
+    }
+
+    Task<std::vector<double>> Engine::EvalMoves(const Stockfish::MoveList<Stockfish::LEGAL> &moves, const ::Position &pos) const
+    {
+        std::vector<Task<double>> searches;
+        searches.reserve(moves.size());
+        for (const auto m : moves) searches.push_back(EvalMove(m, pos));
+        return All(std::move(searches));
+    }
+
+    Task<std::string> Engine::GetBestMove(const ::Position &pos) const
+    {
+        const auto key = s_key(pos);
+        return s_best_move(s_search(loop_, searches_, {"fen " + pos.fen(), depth_, {}, key, key}));
+    }
+
+    void Scheduler::Spawn(Task<void> task)
+    {
+        task.Start();
+        tasks_.push_back(std::move(task));
+    }
+
+    void Scheduler::Sweep()
+    {
+        std::exception_ptr error;
+        std::erase_if(tasks_, [&](auto &t) {
+            if (!t.done()) return false;
+            try {
+                t.Get();
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+            return true;
+        });
+        if (error) std::rethrow_exception(error);
+    }
+
+    void Scheduler::Poll(int timeout_ms)
+    {
+        // a task can end without a search (a mate on the board), or from the search of another task.
+        Sweep();
+        if (!loop_.pending()) {
+            if (!tasks_.empty()) throw std::logic_error("the tasks are waiting, but not on the engines");
+            return;
+        }
+        loop_.Poll(timeout_ms);
+        Sweep();
+    }
+
+    void Scheduler::Run()
+    {
+        while (!tasks_.empty()) Poll();
+    }
+}
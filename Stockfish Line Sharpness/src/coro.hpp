@@ -0,0 +1,269 @@
+//
+//  coro.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef coro_hpp
+#define coro_hpp
+
+#include <stdio.h>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "reactor.hpp"
+#include "position.hpp"
+
+// Coroutines over the engines of a Reactor::Loop: the engine wait points are awaitables
+// (co_await engine.Eval(pos)), so the algorithms read as blocking loops, but thousands of them can be
+// in flight on a few engines, resumed by the loop as the engines answer. Everything runs on the thread
+// that polls the loop: no locks.
+// The tasks and the searches they await make a graph, run in dependency order: a task asks for a search
+// only once the ones it depends on are done. With a Searches table the graph shares its nodes, the same
+// search asked by two analyses (the eval of a child, the eval of a move of its parent) is run once.
+namespace Coro {
+
+    template<typename T = void> class Task;
+
+    namespace detail {
+        struct PromiseBase {
+            std::coroutine_handle<> continuation {std::noop_coroutine()};
+            std::exception_ptr error {};
+            bool started {false};
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            // resumes whoever awaits the task, if anyone does.
+            struct Final {
+                bool await_ready() noexcept { return false; }
+                template<typename P>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept { return h.promise().continuation; }
+                void await_resume() noexcept {}
+            };
+            Final final_suspend() noexcept { return {}; }
+            void unhandled_exception() { error = std::current_exception(); }
+
+            void rethrow() const { if (error) std::rethrow_exception(error); }
+        };
+
+        template<typename T>
+        struct Promise : PromiseBase {
+            std::optional<T> value {};
+            template<typename U> void return_value(U &&v) { value.emplace(std::forward<U>(v)); }
+            T take() { rethrow(); return std::move(*value); }
+        };
+
+        template<>
+        struct Promise<void> : PromiseBase {
+            void return_void() {}
+            void take() { rethrow(); }
+        };
+    }
+
+    // A lazy coroutine: it starts when it is awaited (or spawned), the awaiter is resumed when it ends.
+    // Exceptions are rethrown to the awaiter.
+    template<typename T>
+    class Task {
+    public:
+        struct promise_type : detail::Promise<T> {
+            Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        };
+
+        Task(Task &&other) noexcept : h_(std::exchange(other.h_, {})) {}
+        Task& operator=(Task &&other) noexcept
+        {
+            if (this != &other) {
+                if (h_) h_.destroy();
+                h_ = std::exchange(other.h_, {});
+            }
+            return *this;
+        }
+        ~Task() { if (h_) h_.destroy(); }
+
+        // Runs the task up to its first wait.
+        void Start()
+        {
+            if (h_.promise().started) return;
+            h_.promise().started = true;
+            h_.resume();
+        }
+        bool done() const { return h_.done(); }
+        // The result of a task that is done, rethrows its exception.
+        T Get() { return h_.promise().take(); }
+
+        bool await_ready() const noexcept { return h_.done(); }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            h_.promise().continuation = awaiting;
+            if (h_.promise().started) return std::noop_coroutine();
+            h_.promise().started = true;
+            return h_;
+        }
+        T await_resume() { return h_.promise().take(); }
+
+    private:
+        explicit Task(std::coroutine_handle<promise_type> h) : h_(h) {}
+
+        std::coroutine_handle<promise_type> h_;
+    };
+
+    // Runs the tasks concurrently, the results are in the order of the tasks. Every task is awaited
+    // even if one throws (a task destroyed while its search is queued would be resumed later),
+    // then the first exception is rethrown.
+    template<typename T>
+    Task<std::vector<T>> All(std::vector<Task<T>> tasks)
+    {
+        for (auto& t : tasks) t.Start();
+        std::vector<T> results;
+        results.reserve(tasks.size());
+        std::exception_ptr error;
+        for (auto& t : tasks) {
+            try {
+                results.push_back(co_await t);
+            } catch (...) {
+                if (!error) error = std::current_exception();
+                results.emplace_back();
+            }
+        }
+        if (error) std::rethrow_exception(error);
+        co_return results;
+    }
+
+    Task<void> All(std::vector<Task<void>> tasks);
+
+    // The searches of a run, keyed by the position searched (Canonical::key() and the halfmove clock,
+    // whatever the way it is written) and the depth: a search asked again, while it runs or once it is
+    // done, is not run again. The last `capacity` results are kept. Failed searches are forgotten, they
+    // are run again if asked. The table must outlive the searches of the loop.
+    class Searches {
+        struct Entry;
+    public:
+        explicit Searches(size_t capacity = 1 << 16) : capacity_(capacity) {}
+
+        Searches(const Searches&) = delete;
+        Searches& operator=(const Searches&) = delete;
+
+        struct Awaiter {
+            Entry &entry;
+
+            bool await_ready() const noexcept;
+            void await_suspend(std::coroutine_handle<> h);
+            Reactor::Result await_resume();
+        };
+        // co_await searches.Find(loop, search) gives the result of the search, submitted to the loop the
+        // first time its key and depth are asked (its callback is replaced).
+        Awaiter Find(Reactor::Loop &loop, Reactor::Search search);
+
+        // Searches asked, and the ones actually run.
+        size_t asked() const { return asked_; }
+        size_t searched() const { return searched_; }
+
+    private:
+        struct SearchKey {
+            Stockfish::Key key;
+            int depth;
+            bool operator==(const SearchKey&) const = default;
+        };
+        struct Hash {
+            size_t operator()(const SearchKey &k) const { return size_t(k.key ^ (uint64_t(k.depth) * 0x9E3779B97F4A7C15ull)); }
+        };
+        struct Entry {
+            bool done {};
+            Reactor::Result result {};
+            std::vector<std::coroutine_handle<>> waiting;
+        };
+
+        void Done(const SearchKey &key, const Reactor::Result &result);
+
+        size_t capacity_;
+        std::unordered_map<SearchKey, Entry, Hash> entries_;    // nodes: an Entry does not move
+        std::deque<SearchKey> order_;                           // the oldest first, for eviction
+        size_t asked_ {}, searched_ {};
+    };
+
+    // A handle on the engines of a loop, with the depth of its searches, and the table that shares them
+    // (none: every search is run). Handles are cheap: an algorithm that searches at another depth makes its own.
+    class Engine {
+    public:
+        explicit Engine(Reactor::Loop &loop, int depth = 15, Searches *searches = nullptr)
+            : loop_(loop), depth_(depth), searches_(searches) {}
+
+        Reactor::Loop& loop() const { return loop_; }
+        int Depth() const { return depth_; }
+        int Depth(int depth) { return depth_ = depth; }
+        // The same engines and table, another depth.
+        Engine At(int depth) const { return Engine(loop_, depth, searches_); }
+
+        // co_await engine.Search("fen ...") gives the Reactor::Result, or throws std::runtime_error
+        // if the engine exited. Never shared nor routed: the key of the position is not known.
+        struct SearchAwaiter {
+            Reactor::Loop &loop;
+            Reactor::Search search;
+            Reactor::Result result {};
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> h);
+            Reactor::Result await_resume();
+        };
+        SearchAwaiter Search(std::string position) const { return {loop_, {std::move(position), depth_, {}}}; }
+
+        // The same values as ::Engine: expected scores in [-1, 1] from white's point of view. The searches
+        // of a position and of its moves are routed to the same engine (see Reactor::Loop).
+        // The position is read when the task is made, it can change before the task ends.
+        Task<double> Eval(const ::Position &pos) const;
+        Task<double> EvalMove(Stockfish::Move m, const ::Position &pos) const;
+        // Every move is searched concurrently.
+        Task<std::vector<double>> EvalMoves(const Stockfish::MoveList<Stockfish::LEGAL> &moves, const ::Position &pos) const;
+        // In long algebraic notation, as ::Engine::GetBestMove().
+        Task<std::string> GetBestMove(const ::Position &pos) const;
+
+    private:
+        Reactor::Loop &loop_;
+        int depth_;
+        Searches *searches_;
+    };
+
+    // Runs tasks to completion on the thread that polls the loop.
+    class Scheduler {
+    public:
+        explicit Scheduler(Reactor::Loop &loop) : loop_(loop) {}
+
+        // Starts the task: it runs up to its first search.
+        void Spawn(Task<void> task);
+
+        // Polls the engines once (see Reactor::Loop::Poll()) and forgets the tasks that are done.
+        // Rethrows the first exception of a task.
+        void Poll(int timeout_ms = -1);
+        // Polls until every task spawned is done. Signals do not stop it: the searches in flight are
+        // finished, the tasks check Interrupt::Requested() to stop early.
+        void Run();
+        // Runs the task (and the ones spawned) to completion, returns its result.
+        template<typename T>
+        T Run(Task<T> task)
+        {
+            task.Start();
+            while (!task.done()) {
+                if (!loop_.pending()) throw std::logic_error("the task is waiting, but not on the engines");
+                Poll();
+            }
+            Run();
+            return task.Get();
+        }
+
+        size_t active() const { return tasks_.size(); }
+
+    private:
+        void Sweep();
+
+        Reactor::Loop &loop_;
+        std::vector<Task<void>> tasks_;
+    };
+}
+
+#endif /* coro_hpp */
@@ -0,0 +1,235 @@
+//
+//  dedupe.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <algorithm>
+#include <filesystem>
+#include <queue>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "dedupe.hpp"
+#include "canonical.hpp"
+#include "ingest.hpp"
+#include "pgn.hpp"
+#include "replay.hpp"
+
+namespace Dedupe {
+    using namespace Stockfish;
+
+    // What an entry of the table costs on top of its FEN: the node, the bucket and the allocator, roughly.
+    static constexpr size_t ENTRY_BYTES = sizeof(std::pair<const Key, Entry>) + 4 * sizeof(void*);
+
+    BloomFilter::BloomFilter(size_t bytes)
+        : words_(std::max<size_t>(bytes / sizeof(uint64_t), 1)), slots_(words_.size() * 32) {}
+
+    size_t BloomFilter::slot(Key key, int i) const
+    {
+        // Zobrist keys are already uniformly distributed: double hashing on the two halves.
+        return (key + uint64_t(i) * ((key >> 32) | 1)) % slots_;
+    }
+
+    int BloomFilter::State(Key key) const
+    {
+        int state = 3;
+        for (int i = 0; i < PROBES; i++) {
+            size_t s = slot(key, i);
+            state = std::min(state, int(words_[s / 32] >> (2 * (s % 32))) & 3);
+        }
+        return state;
+    }
+
+    void BloomFilter::Mark(Key key, int state)
+    {
+        for (int i = 0; i < PROBES; i++) {
+            size_t s = slot(key, i);
+            uint64_t &w = words_[s / 32];
+            int shift = 2 * (s % 32);
+            if (int((w >> shift) & 3) < state)
+                w = (w & ~(uint64_t(3) << shift)) | (uint64_t(state) << shift);
+        }
+    }
+
+    // The runs are unlinked as soon as they are created, they go away with the process even if it crashes.
+    static FILE* s_temp_file(const std::string &dir)
+    {
+        auto folder = dir.empty() ? std::filesystem::temp_directory_path() : std::filesystem::path(dir);
+        std::string name = (folder / "line_sharpness_dedupe_XXXXXX").string();
+        int fd = ::mkstemp(name.data());
+        if (fd < 0) throw std::runtime_error("could not create a dedupe run in " + folder.string());
+        ::unlink(name.c_str());
+
+        FILE *f = ::fdopen(fd, "w+b");
+        if (!f) {
+            ::close(fd);
+            throw std::runtime_error("could not open a dedupe run in " + folder.string());
+        }
+        return f;
+    }
+
+    // Run format: key, count, FEN length (a FEN is always shorter than 256 characters) and FEN.
+    static void s_write(FILE *f, const Entry &e)
+    {
+        uint8_t len = static_cast<uint8_t>(e.fen.size());
+        std::fwrite(&e.key, sizeof(e.key), 1, f);
+        std::fwrite(&e.count, sizeof(e.count), 1, f);
+        std::fwrite(&len, sizeof(len), 1, f);
+        std::fwrite(e.fen.data(), 1, len, f);
+    }
+
+    static bool s_read(FILE *f, Entry &e)
+    {
+        uint8_t len;
+        if (std::fread(&e.key, sizeof(e.key), 1, f) != 1
+            || std::fread(&e.count, sizeof(e.count), 1, f) != 1
+            || std::fread(&len, sizeof(len), 1, f) != 1) return false;
+        e.fen.resize(len);
+        return std::fread(e.fen.data(), 1, len, f) == len;
+    }
+
+    PositionSet::PositionSet(const Options &opts) : opts_(opts)
+    {
+        if (opts_.bloom_mb) bloom_ = std::make_unique<BloomFilter>(opts_.bloom_mb << 20);
+    }
+
+    PositionSet::~PositionSet()
+    {
+        for (auto f : runs_) std::fclose(f);
+    }
+
+    void PositionSet::Add(const Position &pos)
+    {
+        Key key = Canonical::key(pos);
+        occurrences_++;
+
+        if (auto it = table_.find(key); it != table_.end()) {
+            it->second.count++;
+            return;
+        }
+
+        uint64_t count = 1;
+        if (bloom_) {
+            int state = bloom_->State(key);
+            if (state == 0) { bloom_->Mark(key, 1); return; }
+            // the first occurrence was let through without being stored, count it now. A position
+            // in state 2 is already counted in a spilled run.
+            if (state == 1) count = 2;
+            bloom_->Mark(key, 2);
+        }
+
+        auto &e = table_[key];
+        e = Entry {key, count, Canonical::fen(pos)};
+        bytes_ += ENTRY_BYTES + e.fen.capacity();
+        if (bytes_ > (opts_.memory_mb << 20)) Spill();
+    }
+
+    void PositionSet::Spill()
+    {
+        std::vector<const Entry*> sorted;
+        sorted.reserve(table_.size());
+        for (const auto& [key, e] : table_) sorted.push_back(&e);
+        std::sort(sorted.begin(), sorted.end(), [](auto a, auto b) { return a->key < b->key; });
+
+        FILE *f = s_temp_file(opts_.spill_dir);
+        runs_.push_back(f);
+        for (auto e : sorted) s_write(f, *e);
+        if (std::fflush(f) != 0 || std::ferror(f)) throw std::runtime_error("could not write a dedupe run");
+
+        spilled_++;
+        table_.clear();
+        bytes_ = 0;
+    }
+
+    void PositionSet::Drain(const std::function<void(const Entry&)> &f)
+    {
+        if (runs_.empty()) {
+            std::vector<const Entry*> sorted;
+            sorted.reserve(table_.size());
+            for (const auto& [key, e] : table_) sorted.push_back(&e);
+            std::sort(sorted.begin(), sorted.end(), [](auto a, auto b) { return a->key < b->key; });
+            for (auto e : sorted)
+                if (e->count >= opts_.min_count) f(*e);
+        } else {
+            // what is left in memory becomes the last run, then the runs are merged by key.
+            if (!table_.empty()) Spill();
+
+            std::vector<Entry> heads(runs_.size());
+            using Head = std::pair<Key, size_t>;
+            std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heap;
+            auto advance = [&](size_t i) { if (s_read(runs_[i], heads[i])) heap.emplace(heads[i].key, i); };
+
+            for (size_t i = 0; i < runs_.size(); i++) {
+                std::rewind(runs_[i]);
+                advance(i);
+            }
+            while (!heap.empty()) {
+                auto [key, i] = heap.top();
+                heap.pop();
+                Entry merged = std::move(heads[i]);
+                advance(i);
+                while (!heap.empty() && heap.top().first == key) {
+                    size_t j = heap.top().second;
+                    heap.pop();
+                    merged.count += heads[j].count;
+                    advance(j);
+                }
+                if (merged.count >= opts_.min_count) f(merged);
+            }
+
+            for (auto run : runs_) std::fclose(run);
+            runs_.clear();
+        }
+        table_.clear();
+        bytes_ = 0;
+    }
+
+    Stats AddGames(PositionSet &set, std::istream &pgn)
+    {
+        Stats stats {};
+        Pgn::Reader reader(pgn);
+        Pgn::Game game;
+        Replay::Replayer replayer;
+        while (reader.Next(game)) {
+            stats.games++;
+            if (!replayer.Reset(game.InitialFen())) { stats.rejected++; continue; }
+            set.Add(replayer.position());
+            for (const auto& ply : game.plies) {
+                if (!replayer.Play(ply.san)) { stats.rejected++; break; }
+                set.Add(replayer.position());
+            }
+        }
+        return stats;
+    }
+
+    Stats AddGames(PositionSet &set, std::string_view pgn)
+    {
+        Stats stats {};
+        Replay::Replayer replayer;
+        Ingest::for_each_record(pgn, Ingest::Format::Pgn, [&](std::string_view record) {
+            stats.games++;
+            Replay::MovetextCursor cursor(record);
+            if (!replayer.Reset(cursor.Fen().empty() ? std::string_view(Pgn::StartFen) : cursor.Fen())) {
+                stats.rejected++;
+                return;
+            }
+            set.Add(replayer.position());
+            for (std::string_view san; cursor.Next(san); ) {
+                if (!replayer.Play(san)) { stats.rejected++; break; }
+                set.Add(replayer.position());
+            }
+        });
+        return stats;
+    }
+
+    void WriteEntry(std::ostream &os, const Entry &e)
+    {
+        // the canonical FEN always ends with " 0 1", an EPD has no counters.
+        std::string_view epd = e.fen;
+        epd = epd.substr(0, epd.rfind(' ', epd.rfind(' ') - 1));
+
+        char id[17];
+        std::snprintf(id, sizeof(id), "%016llx", static_cast<unsigned long long>(e.key));
+        os << epd << " id \"" << id << "\"; c0 \"" << e.count << "\";\n";
+    }
+}
@@ -0,0 +1,119 @@
+//
+//  dedupe.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef dedupe_hpp
+#define dedupe_hpp
+
+#include <stdio.h>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "mini_stock/position.h"
+
+// Counts the positions of a game database, so that the engine analyses every position once.
+// Positions are keyed by Canonical::key(), the same position reached with different move counters
+// or with unusable castling/en passant rights is counted once. The table stays within a memory
+// budget by spilling sorted runs to disk, which are merged back at the end.
+namespace Dedupe {
+
+    struct Options {
+        size_t memory_mb {256};     // budget of the in-memory table, before spilling a run
+        size_t bloom_mb {0};        // size of the Bloom filter in front of the table, 0 disables it
+        uint64_t min_count {1};     // positions seen fewer times are not emitted
+        std::string spill_dir {};   // where the runs are written, default = the system temporary directory
+    };
+
+    struct Entry {
+        Stockfish::Key key {};
+        uint64_t count {};
+        std::string fen;            // Canonical::fen() of the first occurrence
+    };
+
+    // Bloom filter with 2 bit counters: a position is unseen (0), seen once (1) or stored (2).
+    // Positions seen only once, the vast majority past the opening, never reach the table.
+    class BloomFilter {
+    public:
+        explicit BloomFilter(size_t bytes);
+
+        // The smallest counter of the key, an upper bound of its real state.
+        int State(Stockfish::Key key) const;
+        // Raises the counters of the key to state.
+        void Mark(Stockfish::Key key, int state);
+
+    private:
+        static constexpr int PROBES = 4;
+        size_t slot(Stockfish::Key key, int i) const;
+
+        std::vector<uint64_t> words_;   // 32 counters per word
+        size_t slots_ {};
+    };
+
+    class PositionSet {
+    public:
+        explicit PositionSet(const Options &opts = {});
+        ~PositionSet();
+
+        PositionSet(const PositionSet&) = delete;
+        PositionSet& operator=(const PositionSet&) = delete;
+
+        // Counts one occurrence of pos.
+        void Add(const Stockfish::Position &pos);
+
+        // Calls f(entry) once per unique position seen at least min_count times, in key order,
+        // then empties the set. With the Bloom filter on, the positions seen once are not emitted
+        // and a false positive of the filter can make a count one off.
+        void Drain(const std::function<void(const Entry&)> &f);
+
+        uint64_t occurrences() const { return occurrences_; }
+        size_t runs() const { return spilled_; }
+
+    private:
+        void Spill();
+
+        Options opts_;
+        std::unordered_map<Stockfish::Key, Entry> table_;
+        size_t bytes_ {};
+        std::unique_ptr<BloomFilter> bloom_;
+        std::vector<FILE*> runs_;
+        size_t spilled_ {};
+        uint64_t occurrences_ {};
+    };
+
+    struct Stats {
+        size_t games {};
+        size_t rejected {};         // games with a FEN or a move that could not be replayed
+    };
+
+    // Adds every position of every game (the initial one included) to the set. The games are
+    // replayed with the trusted path (see Replay), a game with a bad move is counted up to that move.
+    Stats AddGames(PositionSet &set, std::istream &pgn);
+    Stats AddGames(PositionSet &set, std::string_view pgn);
+
+    // One EPD line per position: the canonical FEN, the key as id, and the count as c0, so that the
+    // output can be analysed with the batch mode.
+    void WriteEntry(std::ostream &os, const Entry &e);
+
+    // Counts the positions of pgn and writes the unique ones to out. Returns the number written.
+    template<typename Input>
+    size_t Run(Input &&pgn, std::ostream &out, std::ostream &log = std::cerr, const Options &opts = {})
+    {
+        PositionSet set(opts);
+        auto stats = AddGames(set, pgn);
+        size_t unique {};
+        set.Drain([&](const Entry &e) { WriteEntry(out, e); unique++; });
+        out.flush();
+        log << "[dedupe] " << stats.games << " games (" << stats.rejected << " rejected), " << set.occurrences()
+        << " positions, " << unique << " unique (" << set.runs() << " runs spilled)" << std::endl;
+        return unique;
+    }
+}
+
+#endif /* dedupe_hpp */
@@ -7,6 +7,7 @@
 
 #include "fen.hpp"
 #include <iostream>
+#include <cstring>
 
 int checkFEN(const char* FEN)
 {
@@ -66,40 +67,40 @@ int checkFEN(const char* FEN)
                             if (file == 7) if (!white) k_castl = true;
                         }
                         // too many (c)ooks
-                        if (w_pieces_c[ROOK] > 9 || b_pieces_c[ROOK] > 9) return -3;
-                        white ? R[w_pieces_c[ROOK]++] = pos : r[b_pieces_c[ROOK]++] = pos;
+                        if (w_pieces_c[Fen::ROOK] > 9 || b_pieces_c[Fen::ROOK] > 9) return -3;
+                        white ? R[w_pieces_c[Fen::ROOK]++] = pos : r[b_pieces_c[Fen::ROOK]++] = pos;
                         break;
                     case 'B':
                         if (row % 2) { // ood rows means odd files are light.
                             if (file % 2) {
-                                if (white && w_pieces_c[LBISHOP] > 4) return -3;
-                                if (!white && b_pieces_c[LBISHOP] > 4) return -3;
-                                white ? BL[w_pieces_c[LBISHOP]++] = pos : bl[b_pieces_c[LBISHOP]++] = pos;
+                                if (white && w_pieces_c[Fen::LBISHOP] > 4) return -3;
+                                if (!white && b_pieces_c[Fen::LBISHOP] > 4) return -3;
+                                white ? BL[w_pieces_c[Fen::LBISHOP]++] = pos : bl[b_pieces_c[Fen::LBISHOP]++] = pos;
                             } else {
-                                if (white && w_pieces_c[DBISHOP] > 4) return -3;
-                                if (!white && b_pieces_c[DBISHOP] > 4) return -3;
-                                white ? BD[w_pieces_c[DBISHOP]++] = pos : bd[b_pieces_c[DBISHOP]++] = pos;
+                                if (white && w_pieces_c[Fen::DBISHOP] > 4) return -3;
+                                if (!white && b_pieces_c[Fen::DBISHOP] > 4) return -3;
+                                white ? BD[w_pieces_c[Fen::DBISHOP]++] = pos : bd[b_pieces_c[Fen::DBISHOP]++] = pos;
                             }
                         } else {
                             // even rows means even files are light.
                             if (file % 2) { // odd files
-                                if (white && w_pieces_c[DBISHOP] > 4) return -3;
-                                if (!white && b_pieces_c[DBISHOP] > 4) return -3;
-                                white ? BD[w_pieces_c[DBISHOP]++] = pos : bd[b_pieces_c[DBISHOP]++] = pos;
+                                if (white && w_pieces_c[Fen::DBISHOP] > 4) return -3;
+                                if (!white && b_pieces_c[Fen::DBISHOP] > 4) return -3;
+                                white ? BD[w_pieces_c[Fen::DBISHOP]++] = pos : bd[b_pieces_c[Fen::DBISHOP]++] = pos;
                             } else {
-                                if (white && w_pieces_c[LBISHOP] > 4) return -3;
-                                if (!white && b_pieces_c[LBISHOP] > 4) return -3;
-                                white ? BL[w_pieces_c[LBISHOP]++] = pos : bl[b_pieces_c[LBISHOP]++] = pos;
+                                if (white && w_pieces_c[Fen::LBISHOP] > 4) return -3;
+                                if (!white && b_pieces_c[Fen::LBISHOP] > 4) return -3;
+                                white ? BL[w_pieces_c[Fen::LBISHOP]++] = pos : bl[b_pieces_c[Fen::LBISHOP]++] = pos;
                             }
                         }
                         break;
                     case 'Q':
-                        if (w_pieces_c[QUEEN] > 9 || b_pieces_c[QUEEN] > 9) return -3;
-                        white ? Q[w_pieces_c[QUEEN]++] = pos : q[b_pieces_c[QUEEN]++] = pos;
+                        if (w_pieces_c[Fen::QUEEN] > 9 || b_pieces_c[Fen::QUEEN] > 9) return -3;
+                        white ? Q[w_pieces_c[Fen::QUEEN]++] = pos : q[b_pieces_c[Fen::QUEEN]++] = pos;
                         break;
                     case 'N':
-                        if (w_pieces_c[KNIGHT] > 9 || b_pieces_c[KNIGHT] > 9) return -3;
-                        white ? N[w_pieces_c[KNIGHT]++] = pos : n[b_pieces_c[KNIGHT]++] = pos;
+                        if (w_pieces_c[Fen::KNIGHT] > 9 || b_pieces_c[Fen::KNIGHT] > 9) return -3;
+                        white ? N[w_pieces_c[Fen::KNIGHT]++] = pos : n[b_pieces_c[Fen::KNIGHT]++] = pos;
                         break;
                     default: return -5;
                     }
@@ -225,3 +226,203 @@ int checkFEN(const char* FEN)
     
     return 0;
 }
+
+const char* fen_error_string(FenError err)
+{
+    switch (err) {
+        case FEN_OK: return "ok";
+        case FEN_COLUMN: return "column consistency error";
+        case FEN_PIECE: return "pieces consistency error";
+        case FEN_ILLEGAL_POSITION: return "illegal position";
+        case FEN_FORMAT: return "badly formatted string";
+        case FEN_CASTLING: return "inconsistent castling";
+        case FEN_EP_SQUARE: return "inconsistent en passant square";
+        default: return "unknown error";
+    }
+}
+
+FenError parseFEN(std::string_view fen, Stockfish::Position& pos, Stockfish::StateInfo* si)
+{
+    using namespace Stockfish;
+    
+    // The checks, and their order, are the same of checkFEN, so that the same error is reported.
+    // The pieces are only referred to through PieceToChar, the counters by their Fen:: indices.
+    static constexpr std::string_view PieceToChar(" PNBRQK  pnbrqk");
+    size_t idx = 0;
+    auto next = [&]() -> char { return idx < fen.size() ? fen[idx++] : '\0'; };
+    auto peek = [&]() -> char { return idx < fen.size() ? fen[idx] : '\0'; };
+    
+    std::memset(static_cast<void*>(&pos), 0, sizeof(Position));
+    std::memset(static_cast<void*>(si), 0, sizeof(StateInfo));
+    pos.st = si;
+    
+    int kings = 0;
+    int w_pieces_c[5] {};
+    int b_pieces_c[5] {};
+    int w_pawns[8] {};
+    int b_pawns[8] {};
+    bool K_castl, Q_castl, k_castl, q_castl;
+    K_castl = Q_castl = k_castl = q_castl = false;
+    char c;
+    
+    // 1. Piece placement
+    for (int row = 7; row >= 0; row--) {
+        int file = 0;
+        do {
+            c = next();
+            if (c >= '1' && c <= '8') {
+                file += c - '0';
+                if (file > 8) return FEN_COLUMN;
+                continue;
+            }
+            bool white = c < 'a';
+            Piece pc = Piece(PieceToChar.find(c));
+            if (!white) c += 'A' - 'a';
+            switch (c) {
+                case 'K':
+                    if (kings > 1) return FEN_PIECE;
+                    if ((row == 0 || row == 7) && (file == 4)) {
+                        if (white) { K_castl = Q_castl = true; }
+                        else { k_castl = q_castl = true; }
+                    }
+                    kings++;
+                    break;
+                case 'P':
+                    if (row == 0 || row == 7) return FEN_ILLEGAL_POSITION;
+                    white ? w_pawns[file]++ : b_pawns[file]++;
+                    break;
+                case 'R':
+                    if (row == 0 && white) {
+                        if (file == 0) Q_castl = true;
+                        if (file == 7) K_castl = true;
+                    }
+                    if (row == 7 && !white) {
+                        if (file == 0) q_castl = true;
+                        if (file == 7) k_castl = true;
+                    }
+                    if (w_pieces_c[Fen::ROOK] > 9 || b_pieces_c[Fen::ROOK] > 9) return FEN_PIECE;
+                    white ? w_pieces_c[Fen::ROOK]++ : b_pieces_c[Fen::ROOK]++;
+                    break;
+                case 'B': {
+                    // odd rows means odd files are light, even rows means even files are light.
+                    int complex = (row % 2) == (file % 2) ? Fen::LBISHOP : Fen::DBISHOP;
+                    int* count = white ? w_pieces_c : b_pieces_c;
+                    if (count[complex] > 4) return FEN_PIECE;
+                    count[complex]++;
+                    break;
+                }
+                case 'Q':
+                    if (w_pieces_c[Fen::QUEEN] > 9 || b_pieces_c[Fen::QUEEN] > 9) return FEN_PIECE;
+                    white ? w_pieces_c[Fen::QUEEN]++ : b_pieces_c[Fen::QUEEN]++;
+                    break;
+                case 'N':
+                    if (w_pieces_c[Fen::KNIGHT] > 9 || b_pieces_c[Fen::KNIGHT] > 9) return FEN_PIECE;
+                    white ? w_pieces_c[Fen::KNIGHT]++ : b_pieces_c[Fen::KNIGHT]++;
+                    break;
+                default: return FEN_FORMAT;
+            }
+            pos.put_piece(pc, make_square(File(file), Rank(row)));
+            file++;
+        } while (file < 8);
+        
+        c = next();
+        if (row > 0 && c != '/') return FEN_FORMAT;
+        if (row == 0 && c != ' ') return FEN_FORMAT;
+    }
+    
+    int w_tot_pieces = sum(w_pieces_c, 5) + sum(w_pawns, 8);
+    int b_tot_pieces = sum(b_pieces_c, 5) + sum(b_pawns, 8);
+    
+    for (auto p: w_pawns) if (p > 6) return FEN_ILLEGAL_POSITION;
+    for (auto p: b_pawns) if (p > 6) return FEN_ILLEGAL_POSITION;
+    
+    // enough enemy pieces have been exchanged to allow for the pawn formation, see checkFEN.
+    static constexpr int AH[7] {0, 0, 1, 3, 6, 10, 15};
+    static constexpr int CF[7] {0, 0, 1, 2, 4, 6, 9};
+    static constexpr int BG[7] {0, 0, 1, 2, 4, 7, 11};
+    for (int i = 0; i < 8; i++) {
+        const int* exchanges = i == 0 ? AH : (i == 1 || i == 7) ? BG : CF;
+        if ( b_tot_pieces + exchanges[w_pawns[i]] > 15 ) return FEN_ILLEGAL_POSITION;
+        if ( w_tot_pieces + exchanges[b_pawns[i]] > 15 ) return FEN_ILLEGAL_POSITION;
+    }
+    
+    // 2. Active color
+    c = next();
+    if (c != 'w' && c != 'b') return FEN_FORMAT;
+    pos.sideToMove = c == 'w' ? WHITE : BLACK;
+    if (next() != ' ') return FEN_FORMAT;
+    
+    // 3. Castling availability
+    int castling = NO_CASTLING;
+    bool end = false;
+    while ((c = next())) {
+        switch (c) {
+            case 'K': if (!K_castl) return FEN_CASTLING; castling |= WHITE_OO; break;
+            case 'Q': if (!Q_castl) return FEN_CASTLING; castling |= WHITE_OOO; break;
+            case 'k': if (!k_castl) return FEN_CASTLING; castling |= BLACK_OO; break;
+            case 'q': if (!k_castl) return FEN_CASTLING; castling |= BLACK_OOO; break;
+            case '-': end = true; next(); break;
+            case ' ': end = true; break;
+            default: return FEN_FORMAT;
+        }
+        if (end) break;
+    }
+    
+    // 4. En passant square
+    Square ep = SQ_NONE;
+    c = next();
+    if (c >= 'a' && c <= 'h') {
+        char r = peek();
+        if (r != '3' && r != '6') return FEN_EP_SQUARE;
+        next();
+        if (r == (pos.sideToMove == WHITE ? '6' : '3'))
+            ep = make_square(File(c - 'a'), Rank(r - '1'));
+    } else if (c != '-') return FEN_FORMAT;
+    
+    // 5-6. Halfmove clock and fullmove number
+    int counters[2] {};
+    int n_counters = 0;
+    bool in_number = false;
+    while ((c = next())) {
+        if (c >= '0' && c <= '9') {
+            if (!in_number) n_counters++;
+            in_number = true;
+            if (n_counters <= 2) counters[n_counters-1] = counters[n_counters-1] * 10 + (c - '0');
+        } else if (c == ' ') in_number = false;
+        else return FEN_FORMAT;
+    }
+    
+    // Not checked by checkFEN, but we can't set up a position without them.
+    if (pos.count<KING>(WHITE) != 1 || pos.count<KING>(BLACK) != 1) return FEN_PIECE;
+    
+    // Castling rights are only set if there is a rook to castle with, between the king and the corner.
+    for (CastlingRights cr : {WHITE_OO, WHITE_OOO, BLACK_OO, BLACK_OOO}) {
+        if (!(castling & cr)) continue;
+        Color col = cr & WHITE_CASTLING ? WHITE : BLACK;
+        Square ksq = pos.square<KING>(col);
+        if (rank_of(ksq) != relative_rank(col, RANK_1)) continue;
+        
+        Piece rook = Piece(PieceToChar.find(col == WHITE ? 'R' : 'r'));
+        Square rsq = relative_square(col, cr & KING_SIDE ? SQ_H1 : SQ_A1);
+        Direction step = cr & KING_SIDE ? WEST : EAST;
+        while (rsq != ksq && pos.piece_on(rsq) != rook) rsq += step;
+        if (rsq != ksq) pos.set_castling_right(col, rsq);
+    }
+    
+    // En passant square will be considered only if it can actually be captured, as Position::set() does.
+    if (ep != SQ_NONE) {
+        Color us = pos.sideToMove;
+        bool enpassant = pawn_attacks_bb(~us, ep) & pos.pieces(us, PAWN)
+                      && (pos.pieces(~us, PAWN) & (ep + pawn_push(~us)))
+                      && !(pos.pieces() & (ep | (ep + pawn_push(us))));
+        si->epSquare = enpassant ? ep : SQ_NONE;
+    } else si->epSquare = SQ_NONE;
+    
+    si->rule50 = counters[0];
+    // Convert from fullmove starting from 1 to gamePly starting from 0.
+    pos.gamePly = std::max(2 * (counters[1] - 1), 0) + (pos.sideToMove == BLACK);
+    pos.chess960 = false;
+    pos.set_state();
+    
+    return FEN_OK;
+}
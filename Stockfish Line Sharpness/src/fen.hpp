@@ -8,11 +8,14 @@
 #ifndef fen_hpp
 #define fen_hpp
 
-# define QUEEN 0
-# define ROOK 1
-# define KNIGHT 2
-# define LBISHOP 3
-# define DBISHOP 4
+#include <string_view>
+
+#include "mini_stock/position.h"
+
+// The indices of the piece counters of checkFEN and parseFEN. Scoped: Stockfish has pieces of the same names.
+namespace Fen {
+    enum Counter : int { QUEEN, ROOK, KNIGHT, LBISHOP, DBISHOP };
+}
 
 # define COLERR -2    // column consistency error
 # define PIECERR -3   // pieces consistency error
@@ -31,4 +34,22 @@ inline int to_col(const char c) { return c - 'A'; }
 inline char to_file(const int f) { return (char)((int)'A' + f); }
 
 int checkFEN(const char * FEN);
+
+// Typed version of the error codes above.
+enum FenError : int {
+    FEN_OK = 0,
+    FEN_COLUMN = COLERR,
+    FEN_PIECE = PIECERR,
+    FEN_ILLEGAL_POSITION = ILLPOSERR,
+    FEN_FORMAT = FORMERR,
+    FEN_CASTLING = CASTERR,
+    FEN_EP_SQUARE = EPSQERR,
+};
+
+const char* fen_error_string(FenError err);
+
+// Validates the FEN with the same rules (and error codes) of checkFEN and sets up pos in the same pass,
+// without going through Position::set(). It additionally requires exactly one king per side,
+// which checkFEN does not check but any position needs. On error pos is left in an unspecified state.
+FenError parseFEN(std::string_view fen, Stockfish::Position& pos, Stockfish::StateInfo* si);
 #endif /* fen_hpp */
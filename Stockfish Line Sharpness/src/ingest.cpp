@@ -0,0 +1,134 @@
+//
+//  ingest.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <cctype>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "ingest.hpp"
+
+namespace Ingest {
+
+    MappedFile::MappedFile(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("could not open " + path);
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            ::close(fd);
+            throw std::runtime_error("cannot map " + path + ": not a regular file");
+        }
+
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_) {
+            void *p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("could not map " + path);
+            }
+            // we go through the file once, front to back: read ahead aggressively and drop pages behind us.
+            ::madvise(p, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(p);
+        }
+        // the mapping stays valid after the descriptor is closed.
+        ::close(fd);
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (data_) ::munmap(const_cast<char*>(data_), size_);
+    }
+
+    const char* find_byte(const char *first, const char *last, char c)
+    {
+#if defined(__SSE2__)
+        const __m128i needle = _mm_set1_epi8(c);
+        // 64 bytes per iteration, the exact position is looked for only once something was found.
+        for (; last - first >= 64; first += 64) {
+            __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first)), needle);
+            __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 16)), needle);
+            __m128i d = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 32)), needle);
+            __m128i e = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 48)), needle);
+            if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(d, e)))) break;
+        }
+        for (; last - first >= 16; first += 16) {
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first)), needle));
+            if (mask) return first + __builtin_ctz(mask);
+        }
+#elif defined(__ARM_NEON)
+        const uint8x16_t needle = vdupq_n_u8(static_cast<uint8_t>(c));
+        for (; last - first >= 16; first += 16) {
+            uint8x16_t eq = vceqq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(first)), needle);
+            // narrow every byte of the comparison to 4 bits, to get a 64 bit mask.
+            uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+            if (mask) return first + (__builtin_ctzll(mask) >> 2);
+        }
+#endif
+        for (; first < last; ++first)
+            if (*first == c) return first;
+        return last;
+    }
+
+    // A game starts at the beginning of the text, or with a tag ([Name "...) at the beginning of a line
+    // after an empty line. Checking the shape of the tag keeps comments like "{...\n\n[...]}" in their game.
+    static bool s_game_starts_at(std::string_view text, size_t i)
+    {
+        if (i == 0) return true;
+        if (i >= text.size() || text[i] != '[' || text[i-1] != '\n') return false;
+        if (!((i >= 2 && text[i-2] == '\n') || (i >= 3 && text[i-2] == '\r' && text[i-3] == '\n'))) return false;
+
+        size_t j = i + 1;
+        while (j < text.size() && (std::isalnum((unsigned char)text[j]) || text[j] == '_')) j++;
+        if (j == i + 1) return false;
+        while (j < text.size() && (text[j] == ' ' || text[j] == '\t')) j++;
+        return j < text.size() && text[j] == '"';
+    }
+
+    size_t next_record(std::string_view text, size_t pos, Format fmt)
+    {
+        if (pos == 0) return 0;
+        if (pos >= text.size()) return text.size();
+
+        const char *begin = text.data(), *end = begin + text.size();
+        // a record starts right after a newline, look for one from the character before pos.
+        for (const char *p = begin + pos - 1; (p = find_byte(p, end, '\n')) != end; ++p) {
+            size_t start = p - begin + 1;
+            if (fmt == Format::Lines || s_game_starts_at(text, start)) return start;
+        }
+        return text.size();
+    }
+
+    bool RecordCursor::Next(std::string_view &record)
+    {
+        const char *begin = text_.data(), *end = begin + text_.size();
+
+        while (pos_ < text_.size()) {
+            size_t start = pos_, stop;
+            if (fmt_ == Format::Lines) {
+                stop = find_byte(begin + start, end, '\n') - begin;
+                pos_ = std::min(stop + 1, text_.size());
+            } else {
+                stop = pos_ = next_record(text_, start + 1, fmt_);
+            }
+
+            record = text_.substr(start, stop - start);
+            while (!record.empty() && (record.back() == '\n' || record.back() == '\r'
+                                       || record.back() == ' ' || record.back() == '\t'))
+                record.remove_suffix(1);
+            if (!record.empty()) return true;
+        }
+        return false;
+    }
+}
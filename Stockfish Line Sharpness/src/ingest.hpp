@@ -0,0 +1,98 @@
+//
+//  ingest.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef ingest_hpp
+#define ingest_hpp
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Zero copy ingestion of big EPD/FEN and PGN files: the file is memory mapped, records are
+// string_view slices of the mapping found with a vectorised byte scanner, and the file can be
+// cut into chunks (aligned to record boundaries) that are parsed by several threads.
+namespace Ingest {
+
+    // Read only, sequential access mapping of a whole file. Throws std::runtime_error if the file
+    // cannot be opened or mapped (pipes and stdin cannot be mapped, use a stream for those).
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string &path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        std::string_view data() const { return {data_, size_}; }
+        size_t size() const { return size_; }
+
+    private:
+        const char *data_ {nullptr};
+        size_t size_ {};
+    };
+
+    // Lines: one record per non empty line (EPD, FEN, ...), without the line terminator.
+    // Pgn: one record per game, a game starts with a tag line ([Name "value"]) right after an empty line.
+    enum class Format { Lines, Pgn };
+
+    // First occurrence of c in [first, last), or last. 16 bytes at a time with SSE2 or NEON.
+    const char* find_byte(const char *first, const char *last, char c);
+
+    // Start of the first record that begins at or after pos (text.size() if there is none).
+    size_t next_record(std::string_view text, size_t pos, Format fmt);
+
+    // Walks the records of text in order.
+    class RecordCursor {
+    public:
+        RecordCursor(std::string_view text, Format fmt) : text_(text), fmt_(fmt) {}
+        bool Next(std::string_view &record);
+
+    private:
+        std::string_view text_;
+        Format fmt_;
+        size_t pos_ {};
+    };
+
+    template<typename F>
+    void for_each_record(std::string_view text, Format fmt, F && f)
+    {
+        RecordCursor cursor(text, fmt);
+        for (std::string_view record; cursor.Next(record); ) f(record);
+    }
+
+    // Cuts text in chunks of about chunk_bytes, each one holding the records that start inside it,
+    // and calls f(chunk_index, records) from `threads` threads. Chunks are handed out in order, but
+    // completed in any order: use the index to put the results back in the input order.
+    template<typename F>
+    void parallel_for_each_chunk(std::string_view text, Format fmt, int threads, size_t chunk_bytes, F && f)
+    {
+        chunk_bytes = std::max<size_t>(chunk_bytes, 1);
+        const size_t n_chunks = (text.size() + chunk_bytes - 1) / chunk_bytes;
+        std::atomic<size_t> next {0};
+
+        auto work = [&] {
+            std::vector<std::string_view> records;
+            for (size_t idx = next++; idx < n_chunks; idx = next++) {
+                size_t begin = next_record(text, idx * chunk_bytes, fmt);
+                size_t end = next_record(text, std::min(text.size(), (idx + 1) * chunk_bytes), fmt);
+                records.clear();
+                if (begin < end)
+                    for_each_record(text.substr(begin, end - begin), fmt, [&](std::string_view r) { records.push_back(r); });
+                f(idx, records);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++) workers.emplace_back(work);
+        work();
+        for (auto &w : workers) w.join();
+    }
+}
+
+#endif /* ingest_hpp */
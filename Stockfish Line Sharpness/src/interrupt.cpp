@@ -0,0 +1,45 @@
+//
+//  interrupt.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <csignal>
+#include <signal.h>
+
+#include "interrupt.hpp"
+
+namespace Interrupt {
+
+    static volatile std::sig_atomic_t s_requested = 0;
+
+    static void s_handler(int sig)
+    {
+        if (s_requested) {
+            // second signal: give up on the graceful shutdown.
+            std::signal(sig, SIG_DFL);
+            std::raise(sig);
+            return;
+        }
+        s_requested = 1;
+    }
+
+    void Shield()
+    {
+        std::signal(SIGINT, SIG_IGN);
+    }
+
+    void Catch()
+    {
+        struct sigaction sa {};
+        sa.sa_handler = s_handler;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = 0;    // no SA_RESTART
+        sigaction(SIGINT, &sa, nullptr);
+        sigaction(SIGTERM, &sa, nullptr);
+    }
+
+    bool Requested()
+    {
+        return s_requested != 0;
+    }
+}
@@ -0,0 +1,27 @@
+//
+//  interrupt.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef interrupt_hpp
+#define interrupt_hpp
+
+#include <stdio.h>
+
+// Graceful shutdown on Ctrl-C (SIGINT) and SIGTERM: the long running loops stop after the position they are
+// analysing, so that the results already computed are written and journaled, and the engines are shut down.
+// A second signal terminates the program right away.
+namespace Interrupt {
+
+    // Ctrl-C is sent to the whole process group, engines included. Engines started between Shield() and
+    // Catch() ignore SIGINT (an ignored signal stays ignored across exec), so that they survive it and
+    // are shut down by us.
+    void Shield();
+    // Installs the handlers. Blocking reads are not restarted: reading from stdin stops too.
+    void Catch();
+
+    // True once a signal was caught.
+    bool Requested();
+}
+
+#endif /* interrupt_hpp */
@@ -0,0 +1,244 @@
+//
+//  journal.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "journal.hpp"
+
+namespace Journal {
+
+    // The file starts with the magic and the run, then come the frames: length, CRC-32 of the payload, payload.
+    static constexpr char MAGIC[8] = {'L', 'S', 'J', 'R', 'N', 'L', '1', '\n'};
+    static constexpr size_t FRAME_HEADER = 2 * sizeof(uint32_t);
+    // Anything longer is a torn or garbage length, records are a few KB at most.
+    static constexpr uint32_t MAX_FRAME = 1 << 24;
+
+    static constexpr std::string_view VERDICTS[] = {"", "good", "inaccuracy", "bad"};
+
+    uint32_t crc32(std::string_view data)
+    {
+        static const auto table = []{
+            std::array<uint32_t, 256> t {};
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+            return t;
+        }();
+        uint32_t crc = 0xffffffff;
+        for (const char c : data) crc = table[(crc ^ static_cast<unsigned char>(c)) & 0xff] ^ (crc >> 8);
+        return crc ^ 0xffffffff;
+    }
+
+    template<typename T>
+    static void s_put(std::string &out, T v)
+    {
+        char buf[sizeof(T)];
+        std::memcpy(buf, &v, sizeof(T));
+        out.append(buf, sizeof(T));
+    }
+
+    static void s_put_string(std::string &out, std::string_view s)
+    {
+        s_put(out, uint32_t(s.size()));
+        out += s;
+    }
+
+    template<typename T>
+    static bool s_get(std::string_view &in, T &v)
+    {
+        if (in.size() < sizeof(T)) return false;
+        std::memcpy(&v, in.data(), sizeof(T));
+        in.remove_prefix(sizeof(T));
+        return true;
+    }
+
+    static bool s_get_string(std::string_view &in, std::string &s)
+    {
+        uint32_t n;
+        if (!s_get(in, n) || in.size() < n) return false;
+        s.assign(in.data(), n);
+        in.remove_prefix(n);
+        return true;
+    }
+
+    void Encode(std::string &out, uint64_t seq, const Output::Record &r)
+    {
+        s_put(out, seq);
+        s_put_string(out, r.id);
+        s_put_string(out, r.fen);
+        s_put(out, int32_t(r.depth));
+        s_put(out, int32_t(r.legal_moves));
+        s_put(out, r.eval);
+        s_put(out, r.sharpness);
+        s_put(out, uint8_t(r.complexity.has_value()));
+        s_put(out, r.complexity.value_or(0));
+        s_put(out, r.seconds);
+        s_put_string(out, r.error);
+        s_put(out, uint32_t(r.moves.size()));
+        for (const auto& m : r.moves) {
+            s_put_string(out, m.san);
+            s_put_string(out, m.lan);
+            s_put(out, m.eval);
+            s_put(out, m.loss);
+            uint8_t verdict = 0;
+            for (uint8_t v = 1; v < std::size(VERDICTS); v++)
+                if (m.verdict == VERDICTS[v]) verdict = v;
+            s_put(out, verdict);
+        }
+    }
+
+    bool Decode(std::string_view in, uint64_t &seq, Output::Record &r)
+    {
+        r = {};
+        int32_t depth, legal_moves;
+        uint8_t has_complexity;
+        double complexity;
+        uint32_t moves;
+        if (!(s_get(in, seq) && s_get_string(in, r.id) && s_get_string(in, r.fen)
+              && s_get(in, depth) && s_get(in, legal_moves) && s_get(in, r.eval) && s_get(in, r.sharpness)
+              && s_get(in, has_complexity) && s_get(in, complexity) && s_get(in, r.seconds)
+              && s_get_string(in, r.error) && s_get(in, moves)))
+            return false;
+
+        r.depth = depth;
+        r.legal_moves = legal_moves;
+        if (has_complexity) r.complexity = complexity;
+        for (uint32_t i = 0; i < moves; i++) {
+            Output::MoveRecord m;
+            uint8_t verdict;
+            if (!(s_get_string(in, m.san) && s_get_string(in, m.lan) && s_get(in, m.eval) && s_get(in, m.loss)
+                  && s_get(in, verdict) && verdict < std::size(VERDICTS)))
+                return false;
+            m.verdict = VERDICTS[verdict];
+            r.moves.push_back(std::move(m));
+        }
+        return in.empty();
+    }
+
+    static std::string s_read_all(int fd)
+    {
+        std::string data;
+        char buf[1 << 16];
+        for (ssize_t n; (n = ::read(fd, buf, sizeof(buf))) != 0; ) {
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) throw std::runtime_error(std::string("could not read the journal: ") + std::strerror(errno));
+            data.append(buf, size_t(n));
+        }
+        return data;
+    }
+
+    static void s_write_all(int fd, std::string_view data)
+    {
+        while (!data.empty()) {
+            ssize_t n = ::write(fd, data.data(), data.size());
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) throw std::runtime_error(std::string("could not write the journal: ") + std::strerror(errno));
+            data.remove_prefix(size_t(n));
+        }
+    }
+
+    Log::Log(const std::string &path, std::string_view run, bool resume, const Options &opts)
+        : path_(path), opts_(opts), last_sync_(std::chrono::steady_clock::now())
+    {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | (resume ? 0 : O_TRUNC), 0644);
+        if (fd_ < 0) throw std::runtime_error("could not open " + path + ": " + std::strerror(errno));
+
+        std::string header(MAGIC, sizeof(MAGIC));
+        s_put_string(header, run);
+
+        try {
+            std::string data = resume ? s_read_all(fd_) : std::string();
+            size_t valid = 0;
+            // a header cut short by a crash is the same as no file at all.
+            if (data.size() < header.size() && header.compare(0, data.size(), data) == 0) data.clear();
+            if (!data.empty()) {
+                if (data.compare(0, header.size(), header) != 0)
+                    throw std::runtime_error(path + " is not the journal of this run");
+                valid = header.size();
+
+                // frames up to the first one that is incomplete or does not match its CRC.
+                while (data.size() - valid >= FRAME_HEADER) {
+                    uint32_t length, crc;
+                    std::memcpy(&length, data.data() + valid, sizeof(length));
+                    std::memcpy(&crc, data.data() + valid + sizeof(length), sizeof(crc));
+                    if (length > MAX_FRAME || data.size() - valid - FRAME_HEADER < length) break;
+
+                    std::string_view payload(data.data() + valid + FRAME_HEADER, length);
+                    uint64_t seq;
+                    Output::Record r;
+                    if (crc32(payload) != crc || !Decode(payload, seq, r)) break;
+                    resumed_[seq] = std::move(r);
+                    valid += FRAME_HEADER + length;
+                }
+            }
+
+            // drops the torn tail, or starts the file over.
+            if (::ftruncate(fd_, off_t(valid)) != 0 || ::lseek(fd_, off_t(valid), SEEK_SET) < 0)
+                throw std::runtime_error("could not truncate " + path + ": " + std::strerror(errno));
+            if (!valid) {
+                s_write_all(fd_, header);
+                ::fdatasync(fd_);
+            }
+        } catch (...) {
+            ::close(fd_);
+            throw;
+        }
+    }
+
+    Log::~Log()
+    {
+        try { Sync(); } catch (const std::runtime_error &) {}
+        ::close(fd_);
+    }
+
+    const Output::Record* Log::Find(uint64_t seq, std::string_view fen) const
+    {
+        auto it = resumed_.find(seq);
+        return it != resumed_.end() && it->second.fen == fen ? &it->second : nullptr;
+    }
+
+    void Log::Append(uint64_t seq, const Output::Record &r)
+    {
+        if (!r.error.empty()) return;
+
+        std::string payload;
+        Encode(payload, seq, r);
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        s_put(pending_, uint32_t(payload.size()));
+        s_put(pending_, crc32(payload));
+        pending_ += payload;
+        pending_records_++;
+
+        if (pending_records_ >= opts_.sync_every || std::chrono::steady_clock::now() - last_sync_ >= opts_.sync_interval)
+            SyncLocked();
+    }
+
+    void Log::Sync()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        SyncLocked();
+    }
+
+    void Log::SyncLocked()
+    {
+        last_sync_ = std::chrono::steady_clock::now();
+        if (pending_.empty()) return;
+        s_write_all(fd_, pending_);
+        if (::fdatasync(fd_) != 0)
+            throw std::runtime_error("could not sync " + path_ + ": " + std::strerror(errno));
+        pending_.clear();
+        pending_records_ = 0;
+    }
+}
@@ -0,0 +1,72 @@
+//
+//  journal.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef journal_hpp
+#define journal_hpp
+
+#include <stdio.h>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "output.hpp"
+
+// Append-only journal of the positions already analysed by a long run (a batch, a line), so that a run
+// killed halfway can be resumed without analysing them again.
+// Every record is a frame: length, CRC-32 and the serialised Output::Record, with the number of the
+// position in the run. Frames are written and synced (fdatasync) in batches: a crash loses at most the
+// last batch, and a frame torn by the crash is detected and dropped on resume.
+namespace Journal {
+
+    struct Options {
+        size_t sync_every {64};                             // records
+        std::chrono::milliseconds sync_interval {1000};     // since the last sync
+    };
+
+    class Log {
+    public:
+        // Opens the journal of the run identified by `run` (the mode, the depth, ...). With resume, the
+        // records of the previous run are read back and new ones are appended, otherwise the file starts over.
+        // Throws std::runtime_error if the file cannot be opened, or was written by another kind of run.
+        Log(const std::string &path, std::string_view run, bool resume, const Options &opts = {});
+        ~Log();
+
+        Log(const Log&) = delete;
+        Log& operator=(const Log&) = delete;
+
+        // The record of the seq-th position of the run, if it was analysed before with the same FEN.
+        const Output::Record* Find(uint64_t seq, std::string_view fen) const;
+
+        // Records with an error are not journaled, they are tried again on resume. Thread safe.
+        void Append(uint64_t seq, const Output::Record &r);
+        // Writes and syncs whatever is pending.
+        void Sync();
+
+        size_t resumed() const { return resumed_.size(); }
+
+    private:
+        void SyncLocked();
+
+        std::mutex mtx_;
+        int fd_ {-1};
+        std::string path_;
+        Options opts_;
+        std::string pending_;
+        size_t pending_records_ {};
+        std::chrono::steady_clock::time_point last_sync_;
+        std::unordered_map<uint64_t, Output::Record> resumed_;
+    };
+
+    // Serialisation of a record, exposed for the tests. Decode returns false on malformed input.
+    void Encode(std::string &out, uint64_t seq, const Output::Record &r);
+    bool Decode(std::string_view in, uint64_t &seq, Output::Record &r);
+
+    uint32_t crc32(std::string_view data);
+}
+
+#endif /* journal_hpp */
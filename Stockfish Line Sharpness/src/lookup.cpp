@@ -0,0 +1,153 @@
+//
+//  lookup.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "lookup.hpp"
+#include "canonical.hpp"
+#include "notation.hpp"
+
+namespace Lookup {
+    using namespace Stockfish;
+
+    // magic, number of keys, rows and id of the store, then the keys and the slots.
+    static constexpr char MAGIC[8] = {'L', 'S', 'I', 'N', 'D', 'E', 'X', '2'};
+    static constexpr size_t HEADER = sizeof(MAGIC) + 3 * sizeof(uint64_t);
+
+    // Interpolation steps before falling back to a binary search, in case the keys are not uniform after all.
+    static constexpr int MAX_INTERPOLATION_STEPS = 16;
+
+    void Build(const Store::Reader &store, const std::string &path)
+    {
+        struct Entry { Key key; Slot slot; };
+        std::vector<Entry> entries;
+        entries.reserve(store.rows());
+        for (size_t b = 0; b < store.blocks(); b++) {
+            auto keys = store.keys(b);
+            auto depths = store.depths(b);
+            auto counts = store.move_counts(b);
+            uint32_t first_move = 0;
+            for (size_t k = 0; k < keys.size(); k++) {
+                Slot slot {store.block(b).first_row + k, first_move, uint16_t(counts[k]), int16_t(depths[k])};
+                entries.push_back({keys[k], slot});
+                first_move += counts[k];
+            }
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+            if (a.key != b.key) return a.key < b.key;
+            if (a.slot.depth != b.slot.depth) return a.slot.depth > b.slot.depth;
+            return a.slot.row > b.slot.row;
+        });
+        entries.erase(std::unique(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+            return a.key == b.key;
+        }), entries.end());
+
+        std::vector<uint64_t> keys(entries.size());
+        std::vector<Slot> slots(entries.size());
+        for (size_t i = 0; i < entries.size(); i++) {
+            keys[i] = entries[i].key;
+            slots[i] = entries[i].slot;
+        }
+
+        // readers of the old index keep their mapping, the new one appears all at once.
+        std::string tmp = path + ".tmp";
+        FILE *f = std::fopen(tmp.c_str(), "wb");
+        if (!f) throw std::runtime_error("could not create " + tmp);
+        uint64_t n = keys.size(), store_rows = store.rows(), store_id = store.id();
+        std::fwrite(MAGIC, 1, sizeof(MAGIC), f);
+        std::fwrite(&n, sizeof(n), 1, f);
+        std::fwrite(&store_rows, sizeof(store_rows), 1, f);
+        std::fwrite(&store_id, sizeof(store_id), 1, f);
+        std::fwrite(keys.data(), sizeof(uint64_t), keys.size(), f);
+        std::fwrite(slots.data(), sizeof(Slot), slots.size(), f);
+        bool failed = std::ferror(f) != 0;
+        failed |= std::fclose(f) != 0;
+        if (failed || std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("could not write " + path);
+        }
+    }
+
+    Index::Index(const std::string &path) : file_(path)
+    {
+        auto data = file_.data();
+        if (data.size() < HEADER || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0)
+            throw std::runtime_error(path + " is not a sharpness index");
+
+        uint64_t n;
+        std::memcpy(&n, data.data() + sizeof(MAGIC), sizeof(n));
+        std::memcpy(&store_rows_, data.data() + sizeof(MAGIC) + sizeof(n), sizeof(store_rows_));
+        std::memcpy(&store_id_, data.data() + sizeof(MAGIC) + sizeof(n) + sizeof(store_rows_), sizeof(store_id_));
+        if (data.size() != HEADER + n * (sizeof(uint64_t) + sizeof(Slot)))
+            throw std::runtime_error(path + ": corrupted index");
+
+        // the mapping is page aligned and the header is 32 bytes: the arrays are 8 byte aligned.
+        auto base = reinterpret_cast<const uint64_t*>(data.data() + HEADER);
+        keys_ = {base, n};
+        slots_ = {reinterpret_cast<const Slot*>(base + n), n};
+    }
+
+    const Slot* Index::Find(Key key) const
+    {
+        if (keys_.empty()) return nullptr;
+
+        size_t lo = 0, hi = keys_.size() - 1;
+        for (int step = 0; step < MAX_INTERPOLATION_STEPS && hi - lo > 8; step++) {
+            if (key < keys_[lo] || key > keys_[hi]) return nullptr;
+            // keys_[lo] <= key <= keys_[hi], so mid is in [lo, hi].
+            double f = double(key - keys_[lo]) / double(keys_[hi] - keys_[lo]);
+            size_t mid = lo + size_t(f * double(hi - lo));
+            if (keys_[mid] < key) lo = mid + 1;
+            else if (keys_[mid] > key) hi = mid - 1;
+            else return &slots_[mid];
+        }
+
+        auto first = keys_.begin() + lo, last = keys_.begin() + hi + 1;
+        auto it = std::lower_bound(first, last, key);
+        if (it == last || *it != key) return nullptr;
+        return &slots_[size_t(it - keys_.begin())];
+    }
+
+    std::optional<Output::Record> Find(const Store::Reader &store, const Index &index, const Position &pos)
+    {
+        const Key key = Canonical::key(pos);
+        const Slot *slot = index.Find(key);
+        if (!slot || slot->row >= store.rows()) return std::nullopt;
+
+        // the slot is only trusted if it points at this position, and inside its block.
+        size_t b = store.block_of(slot->row);
+        size_t k = size_t(slot->row - store.block(b).first_row);
+        if (store.keys(b)[k] != key || size_t(slot->first_move) + slot->moves > store.moves(b).size()
+            || store.move_evals(b).size() != store.moves(b).size()) return std::nullopt;
+        auto moves = store.moves(b).subspan(slot->first_move, slot->moves);
+        auto evals = store.move_evals(b).subspan(slot->first_move, slot->moves);
+
+        // the canonical position has the same board and side to move: the stored moves are legal in pos,
+        // unless the index is stale after all. Like the moves of the transposition table, they are checked.
+        for (const auto m : moves)
+            if (!pos.pseudo_legal(Move(m)) || !pos.legal(Move(m))) return std::nullopt;
+        Output::Record r {};
+        r.fen = pos.fen();
+        r.depth = slot->depth;
+        r.legal_moves = int(moves.size());
+        r.eval = store.evals(b)[k];
+        r.sharpness = store.sharpness(b)[k];
+        r.moves.reserve(moves.size());
+        for (size_t j = 0; j < moves.size(); j++) {
+            Notation::MoveBuffer san, lan;
+            Notation::to_san(pos, Move(moves[j]), san);
+            Notation::to_lan(Move(moves[j]), lan);
+            double eval = evals[j];
+            double loss = pos.side_to_move() == WHITE ? r.eval - eval : eval - r.eval;
+            r.moves.push_back({san, lan, eval, loss});
+        }
+        return r;
+    }
+}
@@ -0,0 +1,68 @@
+//
+//  lookup.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef lookup_hpp
+#define lookup_hpp
+
+#include <stdio.h>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+
+#include "mini_stock/position.h"
+#include "ingest.hpp"
+#include "output.hpp"
+#include "store.hpp"
+
+// Immutable index from the key of a position to its result in a result store (see Store), to answer
+// "how sharp is this position?" without an engine. The file is the sorted array of keys followed by
+// the matching slots; it is memory mapped and searched in place.
+namespace Lookup {
+
+    // Where the result is: with the varint columns already decoded, a lookup only reads fixed width columns.
+    struct Slot {
+        uint64_t row;
+        uint32_t first_move;    // of the row, in the moves of its block
+        uint16_t moves;
+        int16_t depth;
+    };
+
+    // Writes the index of `store` to `path`, through a temporary file renamed at the end. When a position
+    // was analysed more than once, the deepest (then the latest) analysis wins.
+    // Throws std::runtime_error if the file cannot be written.
+    void Build(const Store::Reader &store, const std::string &path);
+
+    // Throws std::runtime_error if the file is not a valid index.
+    class Index {
+    public:
+        explicit Index(const std::string &path);
+
+        size_t size() const { return keys_.size(); }
+        // Rows and id (Store::Reader::id()) of the store when the index was built: another id means the
+        // index is stale.
+        uint64_t store_rows() const { return store_rows_; }
+        uint64_t store_id() const { return store_id_; }
+
+        // The slot of the position, nullptr if it is not there. Zobrist keys are uniform, so an
+        // interpolation search finds them in a handful of probes.
+        const Slot* Find(Stockfish::Key key) const;
+
+    private:
+        Ingest::MappedFile file_;
+        std::span<const uint64_t> keys_;
+        std::span<const Slot> slots_;
+        uint64_t store_rows_ {};
+        uint64_t store_id_ {};
+    };
+
+    // The stored analysis of pos, as Batch::Analyse would give it (FEN of pos, moves in SAN with their
+    // loss, from the best to the worst), or nothing if the position is not in the store.
+    // The verdicts are left empty, see Sharpness::Verdict. A slot that does not match the store (an index
+    // of another store) is a miss.
+    std::optional<Output::Record> Find(const Store::Reader &store, const Index &index, const Stockfish::Position &pos);
+}
+
+#endif /* lookup_hpp */
@@ -5,32 +5,92 @@
 //  Created by Camillo Schenone on 30/09/2023.
 //
 
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <getopt.h>
 #include <iostream>
+#include <fstream>
 #include <ranges>
+#include <sstream>
+#include <set>
 #include <span>
 
 #include "stock_wrapper.hpp"
 #include "utils.hpp"
 #include "sharpness.hpp"
 #include "commands.hpp"
+#include "batch.hpp"
+#include "ingest.hpp"
+#include "dedupe.hpp"
+#include "sample.hpp"
+#include "output.hpp"
+#include "store.hpp"
+#include "lookup.hpp"
+#include "metrics.hpp"
+#include "sketch.hpp"
+#include "journal.hpp"
+#include "interrupt.hpp"
+#include "reactor.hpp"
+#include "coro.hpp"
+#include "plan.hpp"
+#include "affinity.hpp"
 
 class Arguments {
 public:
     static void s_print_usage()
     {
-        std::cout << "Usage is: line_sharpness -e <engine path> [-d <depth>] [-f '<FEN string>'] [-l] [-a] [-G <length>] [<moves>...] \n";
+        std::cout << "Usage is: line_sharpness -e <engine path> [-d <depth>] [-f '<FEN string>'] [-l] [-a] [-G <length>] [-b <file>] [-p <file>] [-j <engines> [--spares <engines>]] [--cores <int>] [--threads <int>] [--hash <MB>] [--workload <name>] [--pin <placement>] [--bench <positions>] [-o <format>] [-S <file>] [-u <file> [-M <MB>] [-B <MB>]] [-s <file> [-n <size>] [--strata <strata>] [--seed <int>]] [--lookup <file>] [--rescore <file> [--metric <name>] [--mapping <name>] [--sweep <range>]] [--stats <file> [--group <fields>]] [--report <files>...] [-J <file> [--resume]] [<moves>...] \n";
         std::cout << "\t -h prints this message" << '\n';
         std::cout << "\t -e <path> the path must be absolute" << '\n';
         std::cout << "\t -d <int> default = 15" << '\n';
-        std::cout << "\t -f '<FEN string>' default = startpos (use quotes)" << '\n';
+        std::cout << "\t -f '<FEN string>' default = startpos (use quotes), analysed by one engine with every core (Threads) and 16 MB of Hash per core" << '\n';
         std::cout << "\t -l eval whole line flag" << '\n';
         std::cout << "\t -a short algebraic flag" << '\n';
         std::cout << "\t -G <int> generate sharp line flag" << '\n';
+        std::cout << "\t -b <path> batch mode: analyse every FEN/EPD line of the file ('-' for stdin)" << '\n';
+        std::cout << "\t -p <path> annotate every ply of the games of a PGN file ('-' for stdin)" << '\n';
+        std::cout << "\t -j <int> engines analysing PGN games, or the moves of the -b, -l and -G positions, in parallel, default = planned (see --workload)" << '\n';
+        std::cout << "\t --cores <int> the cores the engines share, default = every core of the machine" << '\n';
+        std::cout << "\t --threads <int> Threads of every engine, default = the cores split between the engines" << '\n';
+        std::cout << "\t --hash <MB> Hash shared by the engines, default = 16 MB per core" << '\n';
+        std::cout << "\t --workload <shallow|deep> one engine per core, or one engine with every core, default = shallow with -b, -p and -l or -G (text output), deep otherwise" << '\n';
+        std::cout << "\t --pin <none|core|node> run every engine on cores of its own, or on the cores of a NUMA node, with its hash on the node, default = none" << '\n';
+        std::cout << "\t --bench <int> with -b, analyse the first positions of the file with every split of the cores (pinned and not with --pin), the throughput of each as CSV" << '\n';
+        std::cout << "\t --spares <int> with -j, for -b, -l and -G, engines kept ready to replace one that exits, default = 0" << '\n';
+        std::cout << "\t -o <text|jsonl|csv> output format, jsonl and csv give one record per position, default = text" << '\n';
+        std::cout << "\t -S <path> with -b or -p, also write every analysed position to a columnar result store" << '\n';
+        std::cout << "\t -u <path> write the unique positions of the games of a PGN file as EPD, with their count ('-' for stdin)" << '\n';
+        std::cout << "\t -M <int> memory used by -u before spilling to disk, in MB, default = 256" << '\n';
+        std::cout << "\t -B <int> Bloom filter in front of -u, in MB: positions seen once are dropped, default = 0 (disabled)" << '\n';
+        std::cout << "\t -s <path> write a sample of the positions of a PGN or FEN/EPD file as EPD, with their stratum and weight ('-' for stdin)" << '\n';
+        std::cout << "\t -n <int> positions kept by -s, per stratum, default = 1000" << '\n';
+        std::cout << "\t --strata <none|phase|material|ply[/<plies>]> stratify the sample of -s, default = none (ply/10 with ply)" << '\n';
+        std::cout << "\t --seed <int> seed of -s, the same seed gives the same sample, default = 1" << '\n';
+        std::cout << "\t --lookup <path> answer the FEN/EPD lines of stdin from a result store written with -S, -e analyses the misses" << '\n';
+        std::cout << "\t --rescore <path> score every position of a result store again, without an engine, as CSV" << '\n';
+        std::cout << "\t --metric <totalvar|ratio|wdl> the metric of --rescore, default = totalvar" << '\n';
+        std::cout << "\t --mapping <lc0|lichess> centipawns to expected score mapping of --rescore, default = lc0" << '\n';
+        std::cout << "\t --inaccuracy, --mistake, --blunder <pawns> thresholds of --rescore, default = 0.5, 1.1, 3" << '\n';
+        std::cout << "\t --sweep <threshold>:<from>:<to>:<step> with --rescore, summarise the metric for every value of a threshold" << '\n';
+        std::cout << "\t --stats <path> with -b, -p or --rescore, write the distribution of the sharpness (or metric) to the file" << '\n';
+        std::cout << "\t --group <fields> group --stats by EPD operations, PGN tags, stm, pieces, moves or depth, e.g. ECO,WhiteElo/200" << '\n';
+        std::cout << "\t --report merge the --stats files given as arguments into a single CSV report" << '\n';
+        std::cout << "\t -J <path> with -b or -l, journal every analysed position to the file, as soon as it is done" << '\n';
+        std::cout << "\t --resume with -J, take the positions already in the journal from it instead of analysing them again" << '\n';
         std::cout << "\t <moves>... set of moves relative to the position (use long algebraic notation)" << '\n';
         
         std::cout << "- Compute the sharpness of the position given by <FEN> and after making the specified <moves>." << '\n';
         std::cout << "- Pass the -l flag to evaluate the sharpness at every step when applying the <moves>. (I suggest you evaluate lines on a low depth, lest you like to watch paint dry)" << '\n';
         std::cout << "- Pass the -G <length> to generate the sharpest line of the specified length, starting from the given position (plus eventual <moves>)." << '\n';
+        std::cout << "- Pass the -b <file> flag to analyse many positions on one engine per core (see --workload), one result per line on stdout." << '\n';
+        std::cout << "- Pass the -p <file> flag to write the games back to stdout with a [%sharp <sharpness> <eval>] comment after every move." << '\n';
+        std::cout << "- Pass the -u <file> flag to count the positions of a game database (no engine needed), the output can be analysed with -b." << '\n';
+        std::cout << "- Pass the -s <file> flag to sample the positions of a big database in one pass (no engine needed), weighted means over the sample estimate those over the whole." << '\n';
+        std::cout << "- Pass the --lookup <file> flag to look positions up in a store, without an engine (the index is built on the first use)." << '\n';
+        std::cout << "- Pass the --rescore <file> flag to try other metrics and thresholds on positions analysed before, e.g. --sweep inaccuracy:0.2:1:0.1." << '\n';
+        std::cout << "- Pass the --stats <file> flag to collect sharpness statistics of a run, the files of separate runs are merged with --report." << '\n';
+        std::cout << "- Ctrl-C stops -b, -l and -p after the position being analysed, writing what was done (press it twice to stop right away)." << '\n';
         std::cout << "- Pass the -I flag to enable interactive mode with the specified engine in UCI mode." << '\n';
         std::cout << "" << '\n';
         std::exit(0);
@@ -39,8 +99,33 @@ public:
     Arguments(int argc, char * const argv[])
         :args_{argv, static_cast<size_t>(argc)}
     {
+        static const option long_options[] = {
+            {"lookup", required_argument, nullptr, 'L'},
+            {"journal", required_argument, nullptr, 'J'},
+            {"resume", no_argument, nullptr, 'R'},
+            {"rescore", required_argument, nullptr, 'K'},
+            {"metric", required_argument, nullptr, 'T'},
+            {"mapping", required_argument, nullptr, 'P'},
+            {"inaccuracy", required_argument, nullptr, 'N'},
+            {"mistake", required_argument, nullptr, 'Q'},
+            {"blunder", required_argument, nullptr, 'U'},
+            {"sweep", required_argument, nullptr, 'W'},
+            {"stats", required_argument, nullptr, 'Z'},
+            {"group", required_argument, nullptr, 'Y'},
+            {"report", no_argument, nullptr, 'V'},
+            {"strata", required_argument, nullptr, 'X'},
+            {"seed", required_argument, nullptr, 'D'},
+            {"spares", required_argument, nullptr, 'E'},
+            {"cores", required_argument, nullptr, 'C'},
+            {"threads", required_argument, nullptr, 'H'},
+            {"hash", required_argument, nullptr, 'A'},
+            {"workload", required_argument, nullptr, 'O'},
+            {"bench", required_argument, nullptr, 'F'},
+            {"pin", required_argument, nullptr, 'i'},
+            {nullptr, 0, nullptr, 0}
+        };
         int ch;
-        while ((ch = getopt(argc, argv, "hlaIG:d:e:f:")) != -1) {
+        while ((ch = getopt_long(argc, argv, "hlaIG:d:e:f:b:p:j:o:S:J:u:M:B:s:n:", long_options, nullptr)) != -1) {
             switch (ch) {
                 case 'd': depth_            = std::stoi(optarg); break;
                 case 'e': engine_path_      = optarg; break;
@@ -48,6 +133,75 @@ public:
                 case 'a': short_alg_        = true; break;
                 case 'l': whole_line_       = true; break;
                 case 'I': interactive_      = true; break;
+                case 'b': batch_path_       = optarg; break;
+                case 'p': pgn_path_         = optarg; break;
+                case 'j': budget_.engines   = std::max(1, std::stoi(optarg)); break;
+                case 'C': budget_.cores     = std::max(1, std::stoi(optarg)); break;
+                case 'H': budget_.threads   = std::max(1, std::stoi(optarg)); break;
+                case 'A': budget_.hash_mb   = std::max(1, std::stoi(optarg)); break;
+                case 'O': {
+                    if (!Plan::ParseWorkload(optarg, workload_)) {
+                        std::cout << "Unknown workload: " << optarg << '\n';
+                        s_print_usage();
+                    }
+                    workload_set_ = true;
+                    break;
+                }
+                case 'F': bench_            = std::max(1, std::stoi(optarg)); break;
+                case 'i': {
+                    if (!Affinity::ParsePin(optarg, pin_)) {
+                        std::cout << "Unknown placement: " << optarg << '\n';
+                        s_print_usage();
+                    }
+                    break;
+                }
+                case 'E': spares_           = std::max(0, std::stoi(optarg)); break;
+                case 'o': {
+                    if (!Output::ParseFormat(optarg, format_)) {
+                        std::cout << "Unknown output format: " << optarg << '\n';
+                        s_print_usage();
+                    }
+                    break;
+                }
+                case 'S': store_path_       = optarg; break;
+                case 'L': lookup_path_      = optarg; break;
+                case 'J': journal_path_     = optarg; break;
+                case 'R': resume_           = true; break;
+                case 'K': rescore_path_     = optarg; break;
+                case 'T': metric_           = optarg; break;
+                case 'P': {
+                    if (!Metrics::ParseMapping(optarg, mapping_)) {
+                        std::cout << "Unknown mapping: " << optarg << '\n';
+                        s_print_usage();
+                    }
+                    break;
+                }
+                case 'N': metric_params_.inaccuracy = std::stod(optarg); break;
+                case 'Q': metric_params_.mistake    = std::stod(optarg); break;
+                case 'U': metric_params_.blunder    = std::stod(optarg); break;
+                case 'W': {
+                    if (!s_parse_sweep(optarg, sweep_)) {
+                        std::cout << "Invalid sweep: " << optarg << '\n';
+                        s_print_usage();
+                    }
+                    break;
+                }
+                case 'Z': stats_path_       = optarg; break;
+                case 'Y': group_            = optarg; break;
+                case 'V': report_           = true; break;
+                case 'u': dedupe_path_      = optarg; break;
+                case 'M': dedupe_opts_.memory_mb = std::stoul(optarg); break;
+                case 'B': dedupe_opts_.bloom_mb  = std::stoul(optarg); break;
+                case 's': sample_path_      = optarg; break;
+                case 'n': sample_opts_.size = std::stoul(optarg); break;
+                case 'X': {
+                    if (!Sample::ParseStrata(optarg, sample_opts_)) {
+                        std::cout << "Unknown strata: " << optarg << '\n';
+                        s_print_usage();
+                    }
+                    break;
+                }
+                case 'D': sample_opts_.seed = std::stoull(optarg); break;
                 case 'G': {
                     generate_line_          = true;
                     generate_line_length_   = std::stoi(optarg);
@@ -59,6 +213,39 @@ public:
             }
         }
 
+        if (!group_.empty() && stats_path_.empty()) {
+            std::cout << "The --group flag needs --stats." << '\n';
+            s_print_usage();
+        }
+        
+        if (!stats_path_.empty() && batch_path_.empty() && pgn_path_.empty() && (rescore_path_.empty() || sweep_.threshold)) {
+            std::cout << "The --stats flag needs -b, -p or --rescore (without --sweep)." << '\n';
+            s_print_usage();
+        }
+        
+        // merging statistics does not need an engine.
+        if (report_) {
+            for (int i {optind}; i < argc; i++) report_paths_.push_back(args_[i]);
+            return;
+        }
+        // counting positions does not either.
+        if (!dedupe_path_.empty()) return;
+        // nor does sampling them.
+        if (!sample_path_.empty()) {
+            if (sample_opts_.size == 0) {
+                std::cout << "The -n flag needs at least one position." << '\n';
+                s_print_usage();
+            }
+            return;
+        }
+        // looking up does not either, the engine is only started on a miss.
+        if (!lookup_path_.empty()) return;
+        // rescoring reads the evaluations from the store.
+        if (!rescore_path_.empty()) return;
+        if (sweep_.threshold) {
+            std::cout << "The --sweep flag needs --rescore." << '\n';
+            s_print_usage();
+        }
         if (engine_path_.empty()) s_print_usage();
         
         if (whole_line_ && generate_line_) {
@@ -66,12 +253,76 @@ public:
             s_print_usage();
         }
         
+        if ((!batch_path_.empty() || !pgn_path_.empty()) && (whole_line_ || generate_line_)) {
+            std::cout << "The -b and -p flags cannot be used with -l or -G." << '\n';
+            s_print_usage();
+        }
+        
+        if (format_ != Output::Format::Text && (generate_line_ || !pgn_path_.empty())) {
+            std::cout << "The -o flag cannot be used with -G or -p." << '\n';
+            s_print_usage();
+        }
+        
+        if (!store_path_.empty() && batch_path_.empty() && pgn_path_.empty()) {
+            std::cout << "The -S flag needs -b or -p." << '\n';
+            s_print_usage();
+        }
+        
+        if (!journal_path_.empty() && batch_path_.empty() && !whole_line_) {
+            std::cout << "The -J flag needs -b or -l." << '\n';
+            s_print_usage();
+        }
+        
+        if (resume_ && journal_path_.empty()) {
+            std::cout << "The --resume flag needs -J." << '\n';
+            s_print_usage();
+        }
+        
+        if (!batch_path_.empty() && !pgn_path_.empty()) {
+            std::cout << "The -b and -p flags are mutually exclusive, choose one." << '\n';
+            s_print_usage();
+        }
+        
+        if (bench_ && batch_path_.empty()) {
+            std::cout << "The --bench flag needs -b." << '\n';
+            s_print_usage();
+        }
+        
+        // several engines only help the modes that have many searches to run at once.
+        const bool many = !batch_path_.empty() || !pgn_path_.empty()
+                       || (format_ == Output::Format::Text && (whole_line_ || generate_line_));
+        if (!workload_set_) workload_ = many ? Plan::Workload::Shallow : Plan::Workload::Deep;
+        if (!many && budget_.engines > 1) {
+            std::cerr << "[plan] -j is ignored: a single position is searched by a single engine, --threads sets its threads" << std::endl;
+        }
+        if (!many) budget_.engines = 1;
+        
         if (optind == argc) whole_line_ = false;
         
         for (int i {optind}; i < argc; i++) {
             moves_.push_back(args_[i]);
         }
     }
+    // --sweep <threshold>:<from>:<to>:<step>, a threshold of Metrics::Params.
+    struct Sweep {
+        std::string name;
+        double Metrics::Params::* threshold {};
+        double from {}, to {}, step {};
+    };
+    
+    static bool s_parse_sweep(const std::string &arg, Sweep &sweep)
+    {
+        std::istringstream is(arg);
+        char sep1 {}, sep2 {};
+        std::getline(is, sweep.name, ':');
+        if (sweep.name == "inaccuracy") sweep.threshold = &Metrics::Params::inaccuracy;
+        else if (sweep.name == "mistake") sweep.threshold = &Metrics::Params::mistake;
+        else if (sweep.name == "blunder") sweep.threshold = &Metrics::Params::blunder;
+        else return false;
+        return (is >> sweep.from >> sep1 >> sweep.to >> sep2 >> sweep.step) && is.peek() == EOF
+            && sep1 == ':' && sep2 == ':' && sweep.step > 0 && sweep.from <= sweep.to;
+    }
+    
     Arguments(const Arguments &other) = delete;
     Arguments& operator=(const Arguments &other) = delete;
     
@@ -82,6 +333,37 @@ public:
     bool interactive() {return interactive_;}
     bool whole_line() {return whole_line_;}
     bool generate_line() {return generate_line_;}
+    bool batch() {return !batch_path_.empty();}
+    std::string batch_path() {return batch_path_;}
+    bool pgn() {return !pgn_path_.empty();}
+    std::string pgn_path() {return pgn_path_;}
+    const Plan::Budget& budget() {return budget_;}
+    Plan::Workload workload() {return workload_;}
+    int bench() {return bench_;}
+    Affinity::Pin pin() {return pin_;}
+    int spares() {return spares_;}
+    Output::Format format() {return format_;}
+    std::string store_path() {return store_path_;}
+    bool lookup() {return !lookup_path_.empty();}
+    std::string journal_path() {return journal_path_;}
+    bool resume() {return resume_;}
+    std::string lookup_path() {return lookup_path_;}
+    bool rescore() {return !rescore_path_.empty();}
+    std::string rescore_path() {return rescore_path_;}
+    std::string metric() {return metric_;}
+    Metrics::Mapping mapping() {return mapping_;}
+    const Metrics::Params& metric_params() {return metric_params_;}
+    const Sweep& sweep() {return sweep_;}
+    std::string stats_path() {return stats_path_;}
+    std::string group() {return group_;}
+    bool report() {return report_;}
+    const std::vector<std::string>& report_paths() {return report_paths_;}
+    bool dedupe() {return !dedupe_path_.empty();}
+    std::string dedupe_path() {return dedupe_path_;}
+    const Dedupe::Options& dedupe_options() {return dedupe_opts_;}
+    bool sample() {return !sample_path_.empty();}
+    std::string sample_path() {return sample_path_;}
+    const Sample::Options& sample_options() {return sample_opts_;}
     size_t gen_line_length() {return generate_line_length_;}
     
     int depth() {return depth_;}
@@ -96,6 +378,32 @@ private:
     bool interactive_ {false};
     bool generate_line_ {false};
     size_t generate_line_length_ {};
+    std::string batch_path_ {};
+    std::string pgn_path_ {};
+    Plan::Budget budget_ {};
+    Plan::Workload workload_ {Plan::Workload::Shallow};
+    bool workload_set_ {false};
+    int bench_ {0};
+    Affinity::Pin pin_ {Affinity::Pin::None};
+    int spares_ {0};
+    Output::Format format_ {Output::Format::Text};
+    std::string store_path_ {};
+    std::string lookup_path_ {};
+    std::string rescore_path_ {};
+    std::string metric_ {"totalvar"};
+    Metrics::Mapping mapping_ {Metrics::Mapping::Lc0};
+    Metrics::Params metric_params_ {};
+    Sweep sweep_ {};
+    std::string stats_path_ {};
+    std::string group_ {};
+    bool report_ {false};
+    std::vector<std::string> report_paths_ {};
+    std::string journal_path_ {};
+    bool resume_ {false};
+    std::string dedupe_path_ {};
+    Dedupe::Options dedupe_opts_ {};
+    std::string sample_path_ {};
+    Sample::Options sample_opts_ {};
     bool short_alg_ {false};
     int depth_ {15};
     
@@ -147,14 +455,522 @@ Stockfish::Color starting_color(int n_ply, Stockfish::Color ending_color)
     else { return ending_color; }
 }
 
+void print_line(const std::vector<double> &sharpness, const std::vector<Stockfish::Move> &moves, Position &pos)
+{
+    std::cout << "Sharpness by Move:" << std::endl;
+    // sharpness also has the sharpness for the starting position. while moves do not.
+    //TODO: make this sturdier
+    for (int i {1}; i < sharpness.size(); i++) {
+        std::cout << "( " << Utils::to_alg(pos, moves[i-1]) << " )\t" << sharpness[i] << std::endl;
+        pos.DoMove(moves[i-1]);
+    }
+    
+    auto start_col = starting_color((int)sharpness.size(), pos.side_to_move());
+    auto white_sharp_avg = average_sharpness(sharpness, Stockfish::WHITE, start_col);
+    auto black_sharp_avg = average_sharpness(sharpness, Stockfish::BLACK, start_col);
+     
+    std::cout << "White has an average line sharpness of: " << white_sharp_avg << std::endl;
+    std::cout << "Black has an average line sharpness of: " << black_sharp_avg << std::endl;
+}
+
+// -o jsonl/csv: one record per position instead of the report, every position of the line with -l.
+// The complexity costs a search per depth, it is only computed for a single position.
+// With a journal, the positions of the line already in it are not analysed again.
+void write_records(Engine &engine, const std::string &fen, const std::vector<Stockfish::Move> &line, Output::Format fmt,
+                   Journal::Log *journal = nullptr)
+{
+    Output::Writer writer(std::cout, fmt);
+    Position pos(fen);
+    for (size_t i = 0; !Interrupt::Requested(); i++) {
+        Output::Record r {};
+        if (auto journaled = journal ? journal->Find(i, pos.fen()) : nullptr) {
+            r = *journaled;
+        } else {
+            try {
+                r = Batch::Analyse(engine, pos);
+                if (line.empty()) r.complexity = Sharpness::Complexity(engine, pos, engine.Depth());
+            } catch (const std::runtime_error &) {
+                // the signal cut the engine short, the position is analysed again on resume.
+                if (Interrupt::Requested()) break;
+                throw;
+            }
+            if (journal) journal->Append(i, r);
+        }
+        r.id = std::to_string(i);
+        writer.Push(std::move(r));
+        if (i == line.size()) break;
+        pos.DoMove(line[i]);
+    }
+}
+
+// The options of the engines of a plan: the defaults of Engine, with the threads and hash of the layout.
+EngineOptions engine_options(const Engine &engine, const Plan::Layout &layout)
+{
+    auto options = engine.GetOptions();
+    options.threads = layout.threads;
+    options.hash = layout.hash_mb;
+    return options;
+}
+
+// --pin: where every engine of the layout runs, then the spares.
+std::vector<Affinity::Placement> placements(Arguments &args, const Plan::Layout &layout, Affinity::Pin pin)
+{
+    return Affinity::Place(pin, Affinity::Topology(), layout.engines + args.spares(), layout.threads);
+}
+
+// -j with -b, -l and -G: the engines of a Reactor::Loop, set up as Engine::Start() does.
+Reactor::Options reactor_options(Arguments &args, const EngineOptions &options, const Plan::Layout &layout, Affinity::Pin pin)
+{
+    return {
+        .argv = {args.engine_path()},
+        .engines = static_cast<size_t>(layout.engines),
+        .spares = static_cast<size_t>(args.spares()),
+        .options = {{"UCI_showWDL", options.showWDL ? "true" : "false"},
+                    {"Threads", std::to_string(options.threads)},
+                    {"MultiPV", std::to_string(options.multiPV)},
+                    {"Hash", std::to_string(options.hash)}},
+        .placements = placements(args, layout, pin),
+    };
+}
+
+// --bench: the first positions of the -b file analysed with every layout of the budget, one CSV row per
+// layout on stdout, and one more pinned with --pin. The engines are ready before the clock starts, every
+// layout starts with a cold hash. The nps is the mean of the speeds the engines report.
+int bench_plans(Arguments &args, const Engine &engine)
+{
+    std::string text;
+    {
+        std::ifstream file;
+        if (args.batch_path() != "-") file.open(args.batch_path());
+        std::istream &is = args.batch_path() == "-" ? std::cin : file;
+        if (!is) {
+            std::cerr << "Could not open " << args.batch_path() << std::endl;
+            return 1;
+        }
+        std::string fen, id;
+        int n = 0;
+        for (std::string line; n < args.bench() && std::getline(is, line); ) {
+            if (!Batch::ParseLine(line, fen, id)) continue;
+            text += line + '\n';
+            n++;
+        }
+    }
+    
+    std::vector<Affinity::Pin> pins {Affinity::Pin::None};
+    if (args.pin() != Affinity::Pin::None) pins.push_back(args.pin());
+    
+    std::printf("engines,threads,hash,pin,positions,seconds,positions/min,knodes/s,nps\n");
+    for (const auto& layout : Plan::Candidates(args.budget())) {
+        for (const auto pin : pins) {
+            Reactor::Loop loop(reactor_options(args, engine_options(engine, layout), layout, pin));
+            while (loop.ready() < loop.alive()) loop.Poll(10);
+            
+            std::ostringstream out, log;
+            auto start = std::chrono::steady_clock::now();
+            const auto done = Batch::Run(loop, args.depth(), std::string_view(text), out, log, {.report_every = 0});
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::printf("%d,%d,%d,%s,%zu,%.3f,%.1f,%.1f,%llu\n", layout.engines, layout.threads, layout.hash_mb,
+                        Affinity::Name(pin), done, elapsed.count(), done * 60 / elapsed.count(),
+                        loop.nodes() / 1000.0 / elapsed.count(), (unsigned long long)loop.nps());
+            std::fflush(stdout);
+            std::cerr << "[plan] " << Plan::Describe(layout) << ", pinned to " << Affinity::Name(pin) << ": "
+            << done * 60 / elapsed.count() << " positions/min" << std::endl;
+        }
+    }
+    return 0;
+}
+
+// -l and -G on several engines: the coroutine versions of the algorithms, all driven by this thread.
+int line_on_engines(Arguments &args, Reactor::Loop &loop, Position &starting_pos, const std::vector<Stockfish::Move> &moves,
+                    Journal::Log *journal)
+{
+    // the analyses share their searches: the eval of a position is the one of the move leading to it.
+    Coro::Searches searches;
+    Coro::Scheduler scheduler(loop);
+    Coro::Engine async(loop, args.depth(), &searches);
+    
+    try {
+        if (args.whole_line()) {
+            std::cout << "Line analysis:" << std::endl;
+            std::cout << "Loaded Starting Position: \n" << starting_pos << std::endl;
+            
+            scheduler.Run(PositionSharpness(async, starting_pos));
+            auto sharpness = scheduler.Run(LineSharpness(async, moves, starting_pos, journal));
+            print_line(sharpness, moves, starting_pos);
+            if (Interrupt::Requested()) {
+                std::cout << "Interrupted after " << sharpness.size() << " positions." << std::endl;
+                return 130;
+            }
+        } else {
+            std::cout << "Sharp Line Generation" << std::endl;
+            std::cout << "stepping through moves..." << std::endl;
+            starting_pos.Advance(moves);
+            std::cout << starting_pos << std::endl;
+            
+            Utils::print_output(scheduler.Run(Sharpness::GenerateLine(args.gen_line_length(), starting_pos, async)));
+        }
+    } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    std::cerr << "[searches] " << searches.searched() << " run for " << searches.asked() << " asked, "
+    << (loop.completed() ? loop.nodes() / loop.completed() : 0) << " nodes per search, "
+    << loop.stolen() << " off their engine" << std::endl;
+    if (loop.nps()) std::cerr << "[searches] " << loop.nps() << " nodes per second per engine" << std::endl;
+    return 0;
+}
+
+// Regular files are memory mapped and handed over as a string_view, stdin ("-") and
+// anything that cannot be mapped (pipes, ...) as a stream.
+template<typename F>
+int with_input(const std::string &path, F && f)
+{
+    if (path == "-") { f(std::cin); return 0; }
+    
+    std::unique_ptr<Ingest::MappedFile> mapped;
+    try {
+        mapped = std::make_unique<Ingest::MappedFile>(path);
+    } catch (const std::runtime_error &) {}
+    
+    if (mapped) {
+        f(mapped->data());
+        return 0;
+    }
+    std::ifstream is(path);
+    if (!is) {
+        std::cerr << "Could not open " << path << std::endl;
+        return 1;
+    }
+    f(is);
+    return 0;
+}
+
+// --lookup: one record per query read from stdin, from the store or, on a miss, from the engine if there is one.
+// The index next to the store (<store>.idx) is rebuilt when it is missing or was built on another store
+// (or on the same file, before it was written again).
+int lookup(Arguments &args)
+{
+    std::unique_ptr<Store::Reader> store;
+    std::unique_ptr<Lookup::Index> index;
+    const auto index_path = args.lookup_path() + ".idx";
+    try {
+        store = std::make_unique<Store::Reader>(args.lookup_path());
+        try {
+            index = std::make_unique<Lookup::Index>(index_path);
+            if (index->store_id() != store->id()) index.reset();
+        } catch (const std::runtime_error &) {}
+        if (!index) {
+            Lookup::Build(*store, index_path);
+            index = std::make_unique<Lookup::Index>(index_path);
+            std::cerr << "[lookup] indexed " << index->size() << " positions in " << index_path << std::endl;
+        }
+    } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<Engine> engine;
+    size_t queries {}, hits {};
+    std::string fen, id;
+    Position pos;
+    Output::Writer writer(std::cout, args.format());
+    for (std::string line; std::getline(std::cin, line); ) {
+        if (!Batch::ParseLine(line, fen, id)) continue;
+        if (id.empty()) id = std::to_string(queries + 1);
+        queries++;
+
+        Output::Record r {};
+        auto start = std::chrono::steady_clock::now();
+        try {
+            pos.Set(fen);
+            if (auto found = Lookup::Find(*store, *index, pos)) {
+                r = std::move(*found);
+                for (auto& m : r.moves) m.verdict = Sharpness::Verdict(m.loss);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                r.seconds = elapsed.count();
+                hits++;
+            } else if (!args.engine_path().empty()) {
+                if (!engine) {
+                    engine = std::make_unique<Engine>(args.engine_path());
+                    engine->Depth(args.depth());
+                    engine->Start();
+                }
+                r = Batch::Analyse(*engine, pos);
+            } else {
+                r.fen = fen;
+                r.error = "not in the store";
+            }
+        } catch (const std::runtime_error &e) {
+            r.fen = fen;
+            r.error = e.what();
+        }
+        r.id = id;
+        writer.Push(std::move(r));
+    }
+    std::cerr << "[lookup] " << queries << " queries, " << hits << " found in the store" << std::endl;
+    return 0;
+}
+
+// The statistics of a run, written at its end (also when interrupted). Returns 1 if the file cannot be written.
+int save_report(const Sketch::Report &report, const std::string &path)
+{
+    try {
+        report.Save(path);
+    } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    std::cerr << "[stats] " << report.count() << " positions in " << report.groups() << " groups written to " << path << std::endl;
+    return 0;
+}
+
+// The rows of block b of a store, with their scores. Only the fields of the positions are known.
+void add_rows(Sketch::Report &report, const Store::Reader &store, size_t b, std::span<const double> scores)
+{
+    auto stm = store.stm(b);
+    auto positions = store.positions(b);
+    auto depths = store.depths(b);
+    auto counts = store.move_counts(b);
+    for (size_t k = 0; k < scores.size(); k++) {
+        // the occupancy comes first. Not Stockfish::popcount(), its table is not initialised without an engine.
+        uint64_t occupied;
+        std::memcpy(&occupied, &positions[k * Store::PACKED_POSITION_SIZE], sizeof(occupied));
+        Sketch::Fields fields {(stm[k / 64] >> (k % 64)) & 1 ? Stockfish::BLACK : Stockfish::WHITE,
+                               std::popcount(occupied), int(counts[k]), depths[k]};
+        report.Add(fields, scores[k]);
+    }
+}
+
+// --report: the statistics files given as arguments, merged into one CSV report on stdout.
+int merge_reports(Arguments &args)
+{
+    if (args.report_paths().empty()) {
+        std::cerr << "--report needs the files written by --stats" << std::endl;
+        return 1;
+    }
+    try {
+        auto report = Sketch::Report::Load(args.report_paths()[0]);
+        for (size_t i = 1; i < args.report_paths().size(); i++) report->Merge(*Sketch::Report::Load(args.report_paths()[i]));
+        report->Write(std::cout);
+        std::cerr << "[stats] " << report->metric() << ": " << report->count() << " positions in " << report->groups() << " groups" << std::endl;
+    } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// --rescore: the metric of every position of a result store or, with --sweep, a summary of it for every
+// value of the threshold. CSV on stdout.
+int rescore(Arguments &args)
+{
+    try {
+        Store::Reader store(args.rescore_path());
+        auto start = std::chrono::steady_clock::now();
+        const auto& sweep = args.sweep();
+        if (!sweep.threshold) {
+            auto metric = Metrics::Make(args.metric(), args.metric_params());
+            std::unique_ptr<Sketch::Report> report;
+            if (!args.stats_path().empty())
+                report = std::make_unique<Sketch::Report>(Metrics::Label(args.metric(), args.mapping(), args.metric_params()),
+                                                          Sketch::Grouping(args.group()));
+            Metrics::Batch batch {.mapping = args.mapping()};
+            std::vector<double> scores;
+            std::printf("row,key,%s\n", args.metric().c_str());
+            for (size_t b = 0; b < store.blocks(); b++) {
+                Metrics::Load(store, b, batch);
+                scores.resize(batch.size());
+                metric->Score(batch, scores);
+                auto keys = store.keys(b);
+                for (size_t k = 0; k < scores.size(); k++)
+                    std::printf("%llu,%016llx,%.6g\n", (unsigned long long)(store.block(b).first_row + k),
+                                (unsigned long long)keys[k], scores[k]);
+                if (report) add_rows(*report, store, b, scores);
+            }
+            if (report && save_report(*report, args.stats_path())) return 1;
+        } else {
+            std::vector<double> steps;
+            for (double t = sweep.from; t <= sweep.to + sweep.step / 2; t += sweep.step) steps.push_back(t);
+            std::vector<std::unique_ptr<Metrics::Metric>> owned;
+            std::vector<const Metrics::Metric*> metrics;
+            for (const double t : steps) {
+                auto params = args.metric_params();
+                params.*sweep.threshold = t;
+                owned.push_back(Metrics::Make(args.metric(), params));
+                metrics.push_back(owned.back().get());
+            }
+            auto summaries = Metrics::Sweep(store, args.mapping(), metrics);
+            std::printf("%s,mean,p50,p90,p99,nonzero\n", sweep.name.c_str());
+            for (size_t i = 0; i < steps.size(); i++) {
+                const auto& s = summaries[i];
+                std::printf("%g,%.6g,%.6g,%.6g,%.6g,%.6g\n", steps[i], s.mean, s.p50, s.p90, s.p99, s.nonzero);
+            }
+        }
+        std::fflush(stdout);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cerr << "[rescore] " << store.rows() << " positions in " << elapsed.count() << "s" << std::endl;
+    } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
 int main(int argc, char * const argv[])
 {
     auto args = Arguments(argc, argv);
+    
+    if (args.dedupe())
+    {
+        return with_input(args.dedupe_path(), [&](auto &&input) {
+            Dedupe::Run(input, std::cout, std::cerr, args.dedupe_options());
+        });
+    }
+    
+    if (args.sample())
+    {
+        return with_input(args.sample_path(), [&](auto &&input) {
+            Sample::Run(input, std::cout, std::cerr, args.sample_options());
+        });
+    }
+    
+    if (args.report()) return merge_reports(args);
+    if (args.lookup()) return lookup(args);
+    if (args.rescore()) return rescore(args);
+    
+    // the engines are started first: they load (their net, their hash) while we read the journal, the
+    // positions and the moves, and are only waited for before the first search.
     auto engine = Engine(args.engine_path());
+    if (args.bench()) return bench_plans(args, engine);
+    
+    // the cores and hash split between the engines: many single threaded ones for many shallow searches.
+    const auto layout = Plan::Make(args.workload(), args.budget());
+    const auto options = engine_options(engine, layout);
+    std::cerr << "[plan] " << Plan::Name(args.workload()) << " searches: " << Plan::Describe(layout) << std::endl;
+    const auto placed = placements(args, layout, args.pin());
+    if (args.pin() != Affinity::Pin::None) {
+        std::set<int> nodes;
+        for (const auto& p : placed) nodes.insert(p.node);
+        std::cerr << "[pin] " << Affinity::Name(args.pin()) << ": " << placed.size() << " engines on "
+        << nodes.size() << (nodes.count(-1) ? " nodes (or none)" : " nodes") << std::endl;
+    }
+    
+    std::vector<std::unique_ptr<Engine>> engines;
+    std::unique_ptr<Reactor::Loop> loop;
+    const bool on_loop = layout.engines > 1 && (args.batch()
+                         || (args.format() == Output::Format::Text && (args.whole_line() || args.generate_line())));
+    // the long runs stop on Ctrl-C once the results are written: their engines must survive it (see Interrupt).
+    const bool shielded = args.batch() || args.pgn() || args.whole_line();
+    if (shielded) Interrupt::Shield();
+    if (on_loop) {
+        loop = std::make_unique<Reactor::Loop>(reactor_options(args, options, layout, args.pin()));
+    } else if (args.pgn()) {
+        for (int i = 0; i < layout.engines; i++) {
+            auto pinned = options;
+            pinned.placement = placed[size_t(i)];
+            engines.push_back(std::make_unique<Engine>(args.engine_path()));
+            engines.back()->Depth(args.depth());
+            engines.back()->Launch(pinned);
+        }
+    } else {
+        auto pinned = options;
+        pinned.placement = placed[0];
+        engine.Depth(args.depth());
+        engine.Launch(pinned);
+    }
+    if (shielded) Interrupt::Catch();
+    
+    std::unique_ptr<Store::Writer> store;
+    if (!args.store_path().empty()) store = std::make_unique<Store::Writer>(args.store_path());
+    
+    // a journal only resumes a run of the same kind: same mode, depth and output.
+    std::unique_ptr<Journal::Log> journal;
+    if (!args.journal_path().empty()) {
+        std::string run = std::string(args.batch() ? "batch" : "line") + " depth " + std::to_string(args.depth())
+                        + " format " + std::to_string(static_cast<int>(args.format()));
+        try {
+            journal = std::make_unique<Journal::Log>(args.journal_path(), run, args.resume());
+        } catch (const std::runtime_error &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        if (journal->resumed()) std::cerr << "[journal] " << journal->resumed() << " positions to resume from" << std::endl;
+    }
+    
+    // the sharpness of -b and -p is the totalvar metric of --rescore, with the default thresholds.
+    std::unique_ptr<Sketch::Report> report;
+    if (!args.stats_path().empty()) {
+        try {
+            report = std::make_unique<Sketch::Report>(Metrics::Label("totalvar", Metrics::Mapping::Lc0, {}),
+                                                      Sketch::Grouping(args.group()));
+        } catch (const std::runtime_error &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+    
+    if (args.batch() && on_loop)
+    {
+        // a single thread drives all the engines, every legal move is a search of its own.
+        int status {};
+        {
+            Batch::Options opts {.format = args.format(), .store = store.get(), .journal = journal.get(), .report = report.get()};
+            status = with_input(args.batch_path(), [&](auto &&input) {
+                Batch::Run(*loop, args.depth(), input, std::cout, std::cerr, opts);
+            });
+            loop.reset();
+        }
+        if (report) status |= save_report(*report, args.stats_path());
+        return Interrupt::Requested() ? 130 : status;
+    }
+    
+    if (args.batch())
+    {
+        // the engine is started once and stays warm for the whole batch.
+        engine.Ready();
+        Batch::Options opts {.format = args.format(), .store = store.get(), .journal = journal.get(), .report = report.get()};
+        auto status = with_input(args.batch_path(), [&](auto &&input) { Batch::Run(engine, input, std::cout, std::cerr, opts); });
+        if (engine.Nps()) std::cerr << "[batch] " << engine.Nps() << " nodes per second" << std::endl;
+        if (report) status |= save_report(*report, args.stats_path());
+        if (!Interrupt::Requested()) return status;
+        engine.Quit();
+        return 130;
+    }
+    
+    if (args.pgn())
+    {
+        for (auto& e : engines) e->Ready();
+        auto status = with_input(args.pgn_path(), [&](auto &&input) {
+            Batch::AnnotatePgn(engines, input, std::cout, std::cerr, store.get(), report.get());
+        });
+        uint64_t nps {};
+        for (const auto& e : engines) nps += e->Nps();
+        if (nps) std::cerr << "[pgn] " << nps / engines.size() << " nodes per second per engine" << std::endl;
+        if (report) status |= save_report(*report, args.stats_path());
+        if (!Interrupt::Requested()) return status;
+        for (auto& e : engines) e->Quit();
+        return 130;
+    }
+    
     auto starting_pos = Position(args.init_fen());
     
     auto moves = Utils::translate_moves(starting_pos, args.moves(), args.short_alg_notation());
-    engine.Start();
+    if (on_loop) return line_on_engines(args, *loop, starting_pos, moves, journal.get());
+    
+    engine.Ready();
+    
+    if (args.format() != Output::Format::Text)
+    {
+        if (args.whole_line()) {
+            write_records(engine, starting_pos.fen(), moves, args.format(), journal.get());
+        } else {
+            starting_pos.Advance(moves);
+            write_records(engine, starting_pos.fen(), {}, args.format());
+        }
+        if (!Interrupt::Requested()) return 0;
+        engine.Quit();
+        return 130;
+    }
     
     if (args.whole_line()) 
     {
@@ -163,22 +979,14 @@ int main(int argc, char * const argv[])
 
         PositionSharpness(engine, starting_pos);
         // just compute the lines, then analyse.
-        auto sharpness = LineSharpness(engine, moves, starting_pos);
-        
-        std::cout << "Sharpness by Move:" << std::endl;
-        // sharpness also has the sharpness for the starting position. while moves do not.
-        //TODO: make this sturdier
-        for (int i {1}; i < sharpness.size(); i++) {
-            std::cout << "( " << Utils::to_alg(starting_pos, moves[i-1]) << " )\t" << sharpness[i] << std::endl;
-            starting_pos.DoMove(moves[i-1]);
-        }
-        
-        auto start_col = starting_color((int)sharpness.size(), starting_pos.side_to_move());
-        auto white_sharp_avg = average_sharpness(sharpness, Stockfish::WHITE, start_col);
-        auto black_sharp_avg = average_sharpness(sharpness, Stockfish::BLACK, start_col);
-         
-        std::cout << "White has an average line sharpness of: " << white_sharp_avg << std::endl;
-        std::cout << "Black has an average line sharpness of: " << black_sharp_avg << std::endl;
+        auto sharpness = LineSharpness(engine, moves, starting_pos, journal.get());
+        
+        print_line(sharpness, moves, starting_pos);
+        if (Interrupt::Requested()) {
+            std::cout << "Interrupted after " << sharpness.size() << " positions." << std::endl;
+            engine.Quit();
+            return 130;
+        }
     }
     else if (args.generate_line())
     {
@@ -0,0 +1,210 @@
+//
+//  metrics.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+
+#include "metrics.hpp"
+#include "utils.hpp"
+
+namespace Metrics {
+
+    // Utils::lc0_cp_to_win is atan(cp / C) / D.
+    static constexpr double LC0_C = 111.714640912;
+    static constexpr double LC0_D = 1.5620688421;
+
+    bool ParseMapping(std::string_view name, Mapping &mapping)
+    {
+        if (name == "lc0") mapping = Mapping::Lc0;
+        else if (name == "lichess") mapping = Mapping::Lichess;
+        else return false;
+        return true;
+    }
+
+    double Win(Mapping mapping, double cp)
+    {
+        if (mapping == Mapping::Lc0) return Utils::lc0_cp_to_win(cp);
+        // lichess_cp_to_win is shifted by one, only the differences matter.
+        return Utils::lichess_cp_to_win(cp) - Utils::lichess_cp_to_win(0);
+    }
+
+    // The stored lc0 expected score q under the mapping.
+    static double s_remap(Mapping mapping, double q)
+    {
+        if (mapping == Mapping::Lc0) return q;
+        // floats round the mate scores a little past +-1.
+        constexpr double limit = std::numbers::pi / 2 - 1e-9;
+        return Win(mapping, LC0_C * std::tan(std::clamp(LC0_D * q, -limit, limit)));
+    }
+
+    void Batch::Add(float eval, bool black, std::span<const float> move_evals)
+    {
+        const float sign = black ? -1 : 1;
+        const size_t first = losses.size();
+        losses.resize(first + move_evals.size());
+        float *loss = losses.data() + first;
+
+        if (mapping == Mapping::Lc0) {
+            values.push_back(sign * eval);
+            for (size_t j = 0; j < move_evals.size(); j++) loss[j] = sign * (eval - move_evals[j]);
+        } else {
+            const float base = float(s_remap(mapping, eval));
+            values.push_back(sign * base);
+            for (size_t j = 0; j < move_evals.size(); j++) loss[j] = sign * (base - float(s_remap(mapping, move_evals[j])));
+        }
+
+        // the store keeps the moves in their generation order.
+        if (!std::is_sorted(loss, loss + move_evals.size())) std::sort(loss, loss + move_evals.size());
+        offsets.push_back(uint32_t(losses.size()));
+    }
+
+    void Load(const Store::Reader &store, size_t b, Batch &batch)
+    {
+        auto evals = store.evals(b);
+        auto stm = store.stm(b);
+        auto counts = store.move_counts(b);
+        auto move_evals = store.move_evals(b);
+
+        batch.clear();
+        batch.values.reserve(evals.size());
+        batch.offsets.reserve(evals.size() + 1);
+        batch.losses.reserve(move_evals.size());
+        size_t first = 0;
+        for (size_t k = 0; k < evals.size(); k++) {
+            bool black = (stm[k / 64] >> (k % 64)) & 1;
+            batch.Add(evals[k], black, move_evals.subspan(first, counts[k]));
+            first += counts[k];
+        }
+    }
+
+    // The kernels below loop over the plain columns of the batch, with the thresholds converted once.
+
+    class TotalVar : public Metric {
+    public:
+        using Metric::Metric;
+
+        void Score(const Batch &batch, std::span<double> out) const override
+        {
+            const float threshold = float(std::abs(Win(batch.mapping, params_.inaccuracy * 100)));
+            const uint32_t *offsets = batch.offsets.data();
+            const float *losses = batch.losses.data();
+            for (size_t i = 0; i < batch.size(); i++) {
+                const float *loss = losses + offsets[i];
+                const uint32_t n = offsets[i + 1] - offsets[i];
+                // moves close to the position, up to the first one that is not (at most all but the last).
+                uint32_t count = 0;
+                while (count + 1 < n && std::abs(loss[count]) < threshold) count++;
+                // the sorted losses telescope: the sum of the gaps is the gap between the ends.
+                out[i] = count ? double(loss[count] - loss[0]) / count : 0;
+            }
+        }
+    };
+
+    class Ratio : public Metric {
+    public:
+        using Metric::Metric;
+
+        void Score(const Batch &batch, std::span<double> out) const override
+        {
+            const float threshold = float(std::abs(Win(batch.mapping, params_.mistake * 100)));
+            const uint32_t *offsets = batch.offsets.data();
+            const float *losses = batch.losses.data();
+            for (size_t i = 0; i < batch.size(); i++) {
+                const uint32_t n = offsets[i + 1] - offsets[i];
+                uint32_t bad = 0;
+                for (uint32_t j = offsets[i]; j < offsets[i + 1]; j++) bad += losses[j] >= threshold;
+                out[i] = n ? double(bad) / n : 0;
+            }
+        }
+    };
+
+    class Wdl : public Metric {
+    public:
+        using Metric::Metric;
+
+        void Score(const Batch &batch, std::span<double> out) const override
+        {
+            const float decisive = float(std::abs(Win(batch.mapping, params_.blunder * 100)));
+            const uint32_t *offsets = batch.offsets.data();
+            const float *losses = batch.losses.data();
+            for (size_t i = 0; i < batch.size(); i++) {
+                const float value = batch.values[i];
+                const int outcome = (value > decisive) - (value < -decisive);
+                const uint32_t n = offsets[i + 1] - offsets[i];
+                uint32_t worse = 0;
+                for (uint32_t j = offsets[i]; j < offsets[i + 1]; j++) {
+                    const float after = value - losses[j];
+                    worse += (after > decisive) - (after < -decisive) < outcome;
+                }
+                out[i] = n ? double(worse) / n : 0;
+            }
+        }
+    };
+
+    std::unique_ptr<Metric> Make(std::string_view name, const Params &params)
+    {
+        if (name == "totalvar") return std::make_unique<TotalVar>(params);
+        if (name == "ratio") return std::make_unique<Ratio>(params);
+        if (name == "wdl") return std::make_unique<Wdl>(params);
+        throw std::runtime_error("unknown metric: " + std::string(name));
+    }
+
+    std::string Label(std::string_view name, Mapping mapping, const Params &params)
+    {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), " %s %g %g %g", mapping == Mapping::Lc0 ? "lc0" : "lichess",
+                      params.inaccuracy, params.mistake, params.blunder);
+        return std::string(name) + buf;
+    }
+
+    static Summary s_summarise(std::vector<float> &scores)
+    {
+        Summary s {};
+        if (scores.empty()) return s;
+        double sum = 0;
+        size_t nonzero = 0;
+        for (const float x : scores) {
+            sum += x;
+            nonzero += x != 0;
+        }
+        s.mean = sum / scores.size();
+        s.nonzero = double(nonzero) / scores.size();
+        auto quantile = [&](double q) {
+            auto nth = scores.begin() + std::ptrdiff_t(q * double(scores.size() - 1));
+            std::nth_element(scores.begin(), nth, scores.end());
+            return double(*nth);
+        };
+        s.p50 = quantile(0.5);
+        s.p90 = quantile(0.9);
+        s.p99 = quantile(0.99);
+        return s;
+    }
+
+    std::vector<Summary> Sweep(const Store::Reader &store, Mapping mapping, std::span<const Metric* const> metrics)
+    {
+        // floats: a sweep keeps the scores of every position for every metric, for the quantiles.
+        std::vector<std::vector<float>> scores(metrics.size());
+        for (auto& s : scores) s.reserve(store.rows());
+
+        Batch batch {.mapping = mapping};
+        std::vector<double> out;
+        for (size_t b = 0; b < store.blocks(); b++) {
+            Load(store, b, batch);
+            out.resize(batch.size());
+            for (size_t m = 0; m < metrics.size(); m++) {
+                metrics[m]->Score(batch, out);
+                scores[m].insert(scores[m].end(), out.begin(), out.end());
+            }
+        }
+
+        std::vector<Summary> summaries;
+        for (auto& s : scores) summaries.push_back(s_summarise(s));
+        return summaries;
+    }
+}
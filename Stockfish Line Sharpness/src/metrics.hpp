@@ -0,0 +1,101 @@
+//
+//  metrics.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef metrics_hpp
+#define metrics_hpp
+
+#include <stdio.h>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "store.hpp"
+
+
+// We want to know what percentage of moves ends up in a overall worse position.
+// we consider a blunder losing 300+ cp, a mistake losing 120-300 cp and inaccuracies 50-120 cp.
+// depending on the ELO, you might consider changing these values.
+// for now lets just put everything under one "bad move umbrella", all the blunders and all the mistakes.
+// inaccuracies are considered neutral, the rest is good moves.
+static constexpr double BLUNDER_THRESHOLD = 3; // blunders
+static constexpr double MISTAKE_THRESHOLD = 1.1; // mistakes (sono scarso dio caro).
+static constexpr double INACCURACY_THRESHOLD = 0.5; // inaccuracy
+
+// Sharpness metrics recomputed from the evaluations of a result store, without an engine: the store keeps
+// the evaluation of the position and of every legal move, so any metric or threshold can be tried on
+// millions of positions analysed once.
+// Evaluations are stored as lc0 expected scores (Utils::lc0_cp_to_win), which maps centipawns one to one:
+// they are converted back to centipawns to score them under another mapping.
+namespace Metrics {
+
+    // The centipawns to expected score mapping the metrics work with.
+    enum class Mapping { Lc0, Lichess };
+    bool ParseMapping(std::string_view name, Mapping &mapping);
+
+    // Expected score of cp centipawns, in [-1, 1] and 0 for an equal position, for either mapping.
+    double Win(Mapping mapping, double cp);
+
+    struct Params {
+        double inaccuracy {INACCURACY_THRESHOLD};   // pawns
+        double mistake {MISTAKE_THRESHOLD};
+        double blunder {BLUNDER_THRESHOLD};
+    };
+
+    // Positions in the form the kernels work on, one column per field: the value of the position for the
+    // side to move and the loss of each of its moves, both as expected scores of the mapping, the losses
+    // of a position sorted from the best move to the worst.
+    struct Batch {
+        Mapping mapping {Mapping::Lc0};
+        std::vector<uint32_t> offsets {0};      // the moves of position i are [offsets[i], offsets[i + 1])
+        std::vector<float> values {};
+        std::vector<float> losses {};
+
+        size_t size() const { return values.size(); }
+        void clear() { offsets.assign(1, 0); values.clear(); losses.clear(); }
+
+        // eval and move_evals are lc0 expected scores from white's point of view, as stored.
+        void Add(float eval, bool black, std::span<const float> move_evals);
+    };
+
+    // The rows of block b of a store.
+    void Load(const Store::Reader &store, size_t b, Batch &batch);
+
+    class Metric {
+    public:
+        explicit Metric(const Params &params) : params_(params) {}
+        virtual ~Metric() = default;
+
+        // out[i] is the score of position i, out.size() == batch.size().
+        virtual void Score(const Batch &batch, std::span<double> out) const = 0;
+
+    protected:
+        Params params_;
+    };
+
+    // "totalvar": Sharpness::TotalVar, the mean gap between successive moves up to the first inaccuracy.
+    // "ratio": the share of the moves that are mistakes or worse.
+    // "wdl": the share of the moves that change the outcome (win, draw, loss: a blunder away from equality).
+    // Throws std::runtime_error for any other name.
+    std::unique_ptr<Metric> Make(std::string_view name, const Params &params);
+    // "totalvar lc0 0.5 1.1 3": what a score means, statistics of different metrics do not mix (see Sketch).
+    std::string Label(std::string_view name, Mapping mapping, const Params &params);
+
+    struct Summary {
+        double mean {};
+        double p50 {};
+        double p90 {};
+        double p99 {};
+        double nonzero {};      // share of the positions
+    };
+
+    // Scores every position of the store with each of the metrics (a threshold sweep), loading every block
+    // once. One summary per metric.
+    std::vector<Summary> Sweep(const Store::Reader &store, Mapping mapping, std::span<const Metric* const> metrics);
+}
+
+#endif /* metrics_hpp */
@@ -20,8 +20,13 @@
 
 #include <algorithm>
 #include <bitset>
+#include <cstring>
 #include <initializer_list>
 
+#if defined(USE_CPU_DISPATCH)
+#  include <cpuid.h>
+#endif
+
 //#include "misc.h"
 
 namespace Stockfish {
@@ -37,8 +42,13 @@ Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
 Magic RookMagics[SQUARE_NB];
 Magic BishopMagics[SQUARE_NB];
 
+bool UsePopCnt;
+bool UsePext;
+
 namespace {
 
+  CpuVariant Variant = CPU_GENERIC;
+
   Bitboard RookTable[0x19000];  // To store rook attacks
   Bitboard BishopTable[0x1480]; // To store bishop attacks
 
@@ -75,10 +85,76 @@ std::string Bitboards::pretty(Bitboard b) {
 }
 
 
+/// Bitboards::detect_cpu() returns the fastest kernels supported by the host.
+/// Zen 1 and Zen 2 (and their Hygon derivatives) implement pext in microcode
+/// with a latency depending on the mask, there the magics are much faster.
+
+CpuVariant Bitboards::detect_cpu() {
+
+#if defined(USE_CPU_DISPATCH)
+  unsigned eax, ebx, ecx, edx;
+  char vendor[13] = {};
+
+  if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx))
+      return CPU_GENERIC;
+
+  std::memcpy(vendor + 0, &ebx, 4);
+  std::memcpy(vendor + 4, &edx, 4);
+  std::memcpy(vendor + 8, &ecx, 4);
+
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_POPCNT))
+      return CPU_GENERIC;
+
+  unsigned family = (eax >> 8) & 0xF;
+  if (family == 0xF)
+      family += (eax >> 20) & 0xFF;
+
+  bool slowPext =   (!std::strcmp(vendor, "AuthenticAMD") || !std::strcmp(vendor, "HygonGenuine"))
+                 && family < 0x19;
+
+  if (   !slowPext
+      && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)
+      && (ebx & bit_BMI2))
+      return CPU_PEXT;
+
+  return CPU_POPCNT;
+#else
+  return HasPext ? CPU_PEXT : HasPopCnt ? CPU_POPCNT : CPU_GENERIC;
+#endif
+}
+
+
+/// Bitboards::variant_name() returns a printable name for the given kernels
+
+const char* Bitboards::variant_name(CpuVariant v) {
+  return v == CPU_PEXT ? "pext" : v == CPU_POPCNT ? "popcnt" : "generic";
+}
+
+CpuVariant Bitboards::cpu_variant() {
+  return Variant;
+}
+
+
 /// Bitboards::init() initializes various bitboard tables. It is called at
 /// startup and relies on global objects to be already zero-initialized.
+/// The kernels are the ones detected for the host, unless a variant is given,
+/// in which case the slider tables are laid out again for it. Forcing a
+/// variant not supported by the CPU is undefined behaviour.
 
 void Bitboards::init() {
+  init(detect_cpu());
+}
+
+void Bitboards::init(CpuVariant v) {
+
+#if defined(USE_CPU_DISPATCH)
+  Variant   = v;
+  UsePopCnt = v >= CPU_POPCNT;
+  UsePext   = v >= CPU_PEXT;
+#else
+  Variant   = detect_cpu();
+  (void)v;
+#endif
 
   for (unsigned i = 0; i < (1 << 16); ++i)
       PopCnt16[i] = uint8_t(std::bitset<16>(i).count());
@@ -177,12 +253,16 @@ namespace {
 
             if (HasPext)
                 m.attacks[pext(b, m.mask)] = reference[size];
+#if defined(USE_CPU_DISPATCH)
+            else if (UsePext)
+                m.attacks[pext_dispatch(b, m.mask)] = reference[size];
+#endif
 
             size++;
             b = (b - m.mask) & m.mask;
         } while (b);
 
-        if (HasPext)
+        if (HasPext || UsePext)
             continue;
 
         PRNG rng(seeds[Is64Bit][rank_of(s)]);
@@ -33,6 +33,10 @@ namespace Stockfish {
 namespace Bitboards {
 
 void init();
+void init(CpuVariant v);
+CpuVariant detect_cpu();
+CpuVariant cpu_variant();
+const char* variant_name(CpuVariant v);
 std::string pretty(Bitboard b);
 
 } // namespace Stockfish::Bitboards
@@ -63,6 +67,30 @@ extern Bitboard LineBB[SQUARE_NB][SQUARE_NB];
 extern Bitboard PseudoAttacks[PIECE_TYPE_NB][SQUARE_NB];
 extern Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
 
+// Kernels selected at startup by Bitboards::init(), see types.h
+extern bool UsePopCnt;
+extern bool UsePext;
+
+#if defined(USE_CPU_DISPATCH)
+
+/// The instructions are emitted through inline assembly so that they don't
+/// require the whole translation unit to be compiled for the target, and they
+/// can still be inlined. They must only be reached when the CPU supports them.
+
+inline unsigned pext_dispatch(Bitboard b, Bitboard mask) {
+  Bitboard r;
+  asm ("pextq %2, %1, %0" : "=r" (r) : "r" (b), "rm" (mask));
+  return unsigned(r);
+}
+
+inline int popcnt_dispatch(Bitboard b) {
+  Bitboard r;
+  asm ("popcntq %1, %0" : "=r" (r) : "rm" (b));
+  return int(r);
+}
+
+#endif
+
 
 /// Magic holds all magic bitboards relevant data for a single square
 struct Magic {
@@ -77,6 +105,11 @@ struct Magic {
     if (HasPext)
         return unsigned(pext(occupied, mask));
 
+#if defined(USE_CPU_DISPATCH)
+    if (UsePext)
+        return pext_dispatch(occupied, mask);
+#endif
+
     if (Is64Bit)
         return unsigned(((occupied & mask) * magic) >> shift);
 
@@ -259,6 +292,13 @@ inline int popcount(Bitboard b) {
 
 #ifndef USE_POPCNT
 
+#if defined(USE_CPU_DISPATCH)
+  if (UsePopCnt)
+      return popcnt_dispatch(b);
+#elif defined(__GNUC__) && defined(__aarch64__)
+  return __builtin_popcountll(b); // Always a native instruction on arm64
+#endif
+
   union { Bitboard bb; uint16_t u[4]; } v = { b };
   return PopCnt16[v.u[0]] + PopCnt16[v.u[1]] + PopCnt16[v.u[2]] + PopCnt16[v.u[3]];
 
@@ -284,4 +284,181 @@ ExtMove* generate<LEGAL>(const Position& pos, ExtMove* moveList) {
   return moveList;
 }
 
+
+namespace {
+
+  // Counts the moves of a set of pawns, target already restricts them to the
+  // legal destinations (pin ray, check evasion). En passant is left to the caller.
+  template<Color Us>
+  void count_pawn_moves(const Position& pos, Bitboard pawns, Bitboard target, MoveCounts& mc) {
+
+    constexpr Color     Them     = ~Us;
+    constexpr Bitboard  TRank7BB = (Us == WHITE ? Rank7BB    : Rank2BB);
+    constexpr Bitboard  TRank3BB = (Us == WHITE ? Rank3BB    : Rank6BB);
+    constexpr Direction Up       = pawn_push(Us);
+    constexpr Direction UpRight  = (Us == WHITE ? NORTH_EAST : SOUTH_WEST);
+    constexpr Direction UpLeft   = (Us == WHITE ? NORTH_WEST : SOUTH_EAST);
+
+    const Bitboard emptySquares = ~pos.pieces();
+    const Bitboard enemies      = pos.pieces(Them) & target;
+
+    Bitboard pawnsOn7    = pawns &  TRank7BB;
+    Bitboard pawnsNotOn7 = pawns & ~TRank7BB;
+
+    Bitboard b1 = shift<Up>(pawnsNotOn7)   & emptySquares;
+    Bitboard b2 = shift<Up>(b1 & TRank3BB) & emptySquares;
+
+    // The same square can be taken from both sides, so count each side apart
+    int pushes     = popcount(b1 & target) + popcount(b2 & target);
+    int captures   = popcount(shift<UpRight>(pawnsNotOn7) & enemies)
+                   + popcount(shift<UpLeft >(pawnsNotOn7) & enemies);
+    int promoCaps  = popcount(shift<UpRight>(pawnsOn7) & enemies)
+                   + popcount(shift<UpLeft >(pawnsOn7) & enemies);
+    int promoPushes = popcount(shift<Up>(pawnsOn7) & emptySquares & target);
+
+    mc.total      += pushes + captures + 4 * (promoCaps + promoPushes);
+    mc.captures   += captures + 4 * promoCaps;
+    mc.promotions += 4 * (promoCaps + promoPushes);
+  }
+
+
+  template<PieceType Pt>
+  void count_piece_moves(const Position& pos, Bitboard target, MoveCounts& mc) {
+
+    Color us = pos.side_to_move();
+    Square ksq = pos.square<KING>(us);
+    Bitboard pinned = pos.blockers_for_king(us);
+    Bitboard bb = pos.pieces(us, Pt);
+
+    // A pinned knight can never move
+    if (Pt == KNIGHT)
+        bb &= ~pinned;
+
+    while (bb)
+    {
+        Square from = pop_lsb(bb);
+        Bitboard b = attacks_bb<Pt>(from, pos.pieces()) & target;
+
+        if (pinned & from)
+            b &= line_bb(ksq, from);
+
+        mc.total    += popcount(b);
+        mc.captures += popcount(b & pos.pieces(~us));
+    }
+  }
+
+} // namespace
+
+
+/// count_legal() mirrors generate<LEGAL>: king moves are checked one by one
+/// (at most eight), pinned pieces are restricted to the pin ray, and when in
+/// check the other pieces can only land between the king and the checker.
+/// The rare en passant and castling moves go through Position::legal().
+
+MoveCounts count_legal(const Position& pos) {
+
+  Color us = pos.side_to_move();
+  Square ksq = pos.square<KING>(us);
+  Bitboard checkers = pos.checkers();
+  MoveCounts mc {};
+
+  Bitboard b = attacks_bb<KING>(ksq) & ~pos.pieces(us);
+  while (b)
+  {
+      Square to = pop_lsb(b);
+      if (!(pos.attackers_to(to, pos.pieces() ^ ksq) & pos.pieces(~us)))
+      {
+          mc.total++;
+          mc.captures += bool(pos.pieces(~us) & to);
+      }
+  }
+
+  // Only the king can move out of a double check
+  if (more_than_one(checkers))
+      return mc;
+
+  Bitboard target = checkers ? between_bb(ksq, lsb(checkers)) : ~pos.pieces(us);
+  Bitboard pinnedPawns = pos.blockers_for_king(us) & pos.pieces(us, PAWN);
+
+  us == WHITE ? count_pawn_moves<WHITE>(pos, pos.pieces(us, PAWN) & ~pinnedPawns, target, mc)
+              : count_pawn_moves<BLACK>(pos, pos.pieces(us, PAWN) & ~pinnedPawns, target, mc);
+
+  while (pinnedPawns)
+  {
+      Square from = pop_lsb(pinnedPawns);
+      us == WHITE ? count_pawn_moves<WHITE>(pos, square_bb(from), target & line_bb(ksq, from), mc)
+                  : count_pawn_moves<BLACK>(pos, square_bb(from), target & line_bb(ksq, from), mc);
+  }
+
+  count_piece_moves<KNIGHT>(pos, target, mc);
+  count_piece_moves<BISHOP>(pos, target, mc);
+  count_piece_moves<  ROOK>(pos, target, mc);
+  count_piece_moves< QUEEN>(pos, target, mc);
+
+  if (pos.ep_square() != SQ_NONE)
+  {
+      b = pos.pieces(us, PAWN) & pawn_attacks_bb(~us, pos.ep_square());
+      while (b)
+          if (pos.legal(make<EN_PASSANT>(pop_lsb(b), pos.ep_square())))
+          {
+              mc.total++;
+              mc.captures++;
+              mc.enPassant++;
+          }
+  }
+
+  if (!checkers && pos.can_castle(us & ANY_CASTLING))
+      for (CastlingRights cr : { us & KING_SIDE, us & QUEEN_SIDE } )
+          if (   pos.can_castle(cr) && !pos.castling_impeded(cr)
+              && pos.legal(make<CASTLING>(ksq, pos.castling_rook_square(cr))))
+          {
+              mc.total++;
+              mc.castling++;
+          }
+
+  return mc;
+}
+
+
+void BranchingStats::add(const MoveCounts& mc) {
+
+  histogram[std::min(mc.total, MAX_MOVES - 1)]++;
+  positions++;
+  moves      += mc.total;
+  captures   += mc.captures;
+  promotions += mc.promotions;
+  castling   += mc.castling;
+  enPassant  += mc.enPassant;
+}
+
+void BranchingStats::merge(const BranchingStats& other) {
+
+  for (int i = 0; i < MAX_MOVES; ++i)
+      histogram[i] += other.histogram[i];
+
+  positions  += other.positions;
+  moves      += other.moves;
+  captures   += other.captures;
+  promotions += other.promotions;
+  castling   += other.castling;
+  enPassant  += other.enPassant;
+}
+
+double BranchingStats::mean() const {
+  return positions ? double(moves) / double(positions) : 0.0;
+}
+
+/// BranchingStats::percentile() returns the smallest branching factor such
+/// that at least a fraction p of the positions have at most that many moves.
+
+int BranchingStats::percentile(double p) const {
+
+  uint64_t seen = 0;
+  for (int i = 0; i < MAX_MOVES; ++i)
+      if ((seen += histogram[i]) >= p * double(positions) && seen)
+          return i;
+
+  return 0;
+}
+
 } // namespace Stockfish
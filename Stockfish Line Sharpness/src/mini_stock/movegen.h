@@ -21,6 +21,7 @@
 
 #include <algorithm> // IWYU pragma: keep
 #include <cstddef>
+#include <cstdint>
 
 #include "types.h"
 
@@ -82,6 +83,40 @@ private:
   ExtMove moveList[MAX_MOVES], *last;
 };
 
+/// MoveCounts holds the number of legal moves in a position, with a breakdown
+/// by kind. Captures include en passant and capture promotions, promotions
+/// count all the four promotion pieces.
+struct MoveCounts {
+  int total;
+  int captures;
+  int promotions;
+  int castling;
+  int enPassant;
+};
+
+/// count_legal() counts the legal moves using the check and pin masks of the
+/// position, with popcounts over the destination bitboards. No move is
+/// generated, it returns the same numbers as a MoveList<LEGAL>.
+MoveCounts count_legal(const Position& pos);
+
+/// BranchingStats accumulates count_legal() over many positions: a histogram
+/// of the branching factor plus the totals by kind of move.
+struct BranchingStats {
+
+  void add(const MoveCounts& mc);
+  void merge(const BranchingStats& other);
+  double mean() const;
+  int percentile(double p) const;
+
+  uint64_t histogram[MAX_MOVES] = {};
+  uint64_t positions = 0;
+  uint64_t moves = 0;
+  uint64_t captures = 0;
+  uint64_t promotions = 0;
+  uint64_t castling = 0;
+  uint64_t enPassant = 0;
+};
+
 } // namespace Stockfish
 
 #endif // #ifndef MOVEGEN_H_INCLUDED
@@ -24,11 +24,22 @@
 #include <iosfwd>
 #include <memory>
 #include <string>
+#include <string_view>
 
 #include "bitboard.h"
 //#include "nnue/nnue_accumulator.h"
 #include "types.h"
 
+namespace Stockfish {
+class Position;
+struct StateInfo;
+}
+
+/// Single pass FEN parser and validator, defined in fen.cpp. It needs to set
+/// up the position state directly.
+enum FenError : int;
+FenError parseFEN(std::string_view fen, Stockfish::Position& pos, Stockfish::StateInfo* si);
+
 namespace Stockfish {
 
 /// StateInfo struct stores information needed to restore a Position object to
@@ -67,6 +78,15 @@ struct StateInfo {
 /// elements are not invalidated upon list resizing.
 using StateListPtr = std::unique_ptr<std::deque<StateInfo>>;
 
+/// Zobrist keys, exposed so that the key of a position with some of its state
+/// stripped (see canonical.hpp) can be derived without setting it up again.
+namespace Zobrist {
+  extern Key psq[PIECE_NB][SQUARE_NB];
+  extern Key enpassant[FILE_NB];
+  extern Key castling[CASTLING_RIGHT_NB];
+  extern Key side;
+}
+
 
 /// Position class stores information regarding the board representation as
 /// pieces, side to move, hash keys, castling info,, etc. Important methods are
@@ -163,6 +183,8 @@ public:
   void remove_piece(Square s);
 
 private:
+  friend FenError (::parseFEN)(std::string_view fen, Stockfish::Position& pos, Stockfish::StateInfo* si);
+
   // Initialization helpers (used while setting up a position)
   void set_castling_right(Color c, Square rfrom);
   void set_state() const;
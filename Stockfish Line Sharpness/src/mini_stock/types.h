@@ -35,6 +35,10 @@
 ///
 /// -DUSE_PEXT    | Add runtime support for use of pext asm-instruction. Works
 ///               | only in 64-bit mode and requires hardware with pext support.
+///
+/// -DNO_CPU_DISPATCH | Disable the runtime selection of the popcnt and pext
+///               | kernels on x86-64 (see Bitboards::init()). Without the two
+///               | flags above, the generic kernels are then always used.
 
 #include <cassert>
 #include <cstdint>
@@ -66,6 +70,16 @@
 #  define IS_64BIT
 #endif
 
+#if !defined(IS_64BIT) && (defined(__x86_64__) || defined(__aarch64__))
+#  define IS_64BIT
+#endif
+
+/// On x86-64 the single binary carries both the generic and the popcnt/pext
+/// kernels, the fastest ones for the host are selected by CPUID at startup.
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(NO_CPU_DISPATCH)
+#  define USE_CPU_DISPATCH
+#endif
+
 #if defined(USE_POPCNT) && defined(_MSC_VER)
 #  include <nmmintrin.h> // Microsoft header for _mm_popcnt_u64()
 #endif
@@ -104,6 +118,12 @@ constexpr bool Is64Bit = false;
 using Key = uint64_t;
 using Bitboard = uint64_t;
 
+/// Kernels for popcount() and Magic::index() that can be selected at runtime.
+/// Every variant implies the ones before it.
+enum CpuVariant {
+  CPU_GENERIC, CPU_POPCNT, CPU_PEXT, CPU_VARIANT_NB
+};
+
 constexpr int MAX_MOVES = 256;
 constexpr int MAX_PLY   = 246;
 
@@ -0,0 +1,370 @@
+//
+//  notation.cpp
+//  Stockfish Line Sharpness
+//
+
+#include "notation.hpp"
+#include "mini_stock/movegen.h"
+
+namespace Notation {
+    using namespace Stockfish;
+
+    namespace {
+
+        constexpr char PieceChar[] = "  NBRQK";
+        constexpr char PromotionChar[] = " pnbrqk";
+
+        inline PieceType piece_from_char(char c)
+        {
+            switch (c) {
+                case 'N': return KNIGHT;
+                case 'B': return BISHOP;
+                case 'R': return ROOK;
+                case 'Q': return QUEEN;
+                case 'K': return KING;
+                default: return NO_PIECE_TYPE;
+            }
+        }
+
+        inline bool is_file(char c) { return c >= 'a' && c <= 'h'; }
+        inline bool is_rank(char c) { return c >= '1' && c <= '8'; }
+        inline Square to_square(char f, char r) { return make_square(File(f - 'a'), Rank(r - '1')); }
+
+        inline char* write_square(char* p, Square s)
+        {
+            *p++ = char('a' + file_of(s));
+            *p++ = char('1' + rank_of(s));
+            return p;
+        }
+
+        // Can a pawn of color us standing on from reach to? (pushes, double pushes and normal captures)
+        inline bool pawn_reaches(const Position &pos, Color us, Square from, Square to)
+        {
+            return  (pawn_attacks_bb(us, from) & pos.pieces(~us) & to)
+                || ((from + pawn_push(us) == to) && pos.empty(to))
+                || (   (from + 2 * pawn_push(us) == to)
+                    && (relative_rank(us, from) == RANK_2)
+                    && pos.empty(to)
+                    && pos.empty(to - pawn_push(us)));
+        }
+
+        // The candidates are built from the attack bitboards, so they are already pseudo-legal
+        // except for check evasions. Filter those out here and let Position::legal() do the rest.
+        // En passant is rare and tricky enough to be left to the slow path of pseudo_legal().
+        bool is_legal(const Position &pos, Move m)
+        {
+            if (type_of(m) == EN_PASSANT)
+                return pos.pseudo_legal(m) && pos.legal(m);
+
+            if (type_of(m) == CASTLING)
+                return !pos.checkers() && pos.legal(m);
+
+            Color us = pos.side_to_move();
+            if (pos.checkers() && type_of(pos.moved_piece(m)) != KING) {
+                if (more_than_one(pos.checkers())) return false;
+                if (!(between_bb(pos.square<KING>(us), lsb(pos.checkers())) & to_sq(m))) return false;
+            }
+            return pos.legal(m);
+        }
+
+        Move castling_move(const Position &pos, CastlingRights side)
+        {
+            Color us = pos.side_to_move();
+            CastlingRights cr = us & side;
+            if (!pos.can_castle(cr) || pos.castling_impeded(cr)) return MOVE_NONE;
+
+            Move m = make<CASTLING>(pos.square<KING>(us), pos.castling_rook_square(cr));
+            return is_legal(pos, m) ? m : MOVE_NONE;
+        }
+
+        std::string_view strip_annotations(std::string_view s)
+        {
+            while (!s.empty() && (s.back() == '+' || s.back() == '#' || s.back() == '!' || s.back() == '?'))
+                s.remove_suffix(1);
+            return s;
+        }
+    }
+
+    size_t to_lan(Move m, MoveBuffer &out)
+    {
+        char* p = out;
+        if (!is_ok(m)) {
+            // matches the strings used by the engine for the special moves.
+            const char* special = m == MOVE_NONE ? "(none)" : "0000";
+            while (*special) *p++ = *special++;
+            *p = '\0';
+            return p - out;
+        }
+
+        Square from = from_sq(m);
+        Square to = to_sq(m);
+
+        // castling is encoded internally as "king captures rook".
+        if (type_of(m) == CASTLING)
+            to = make_square(to > from ? FILE_G : FILE_C, rank_of(from));
+
+        p = write_square(p, from);
+        p = write_square(p, to);
+        if (type_of(m) == PROMOTION)
+            *p++ = PromotionChar[promotion_type(m)];
+
+        *p = '\0';
+        return p - out;
+    }
+
+    // The move gives mate: it gives check and leaves no legal reply. pos is left as it was.
+    static bool s_mates(const Position &pos, Move m)
+    {
+        auto &board = const_cast<Position&>(pos);
+        StateInfo st;
+        board.do_move(m, st);
+        const bool mate = MoveList<LEGAL>(board).size() == 0;
+        board.undo_move(m);
+        return mate;
+    }
+
+    size_t to_san(const Position &pos, Move m, MoveBuffer &out, Checks checks)
+    {
+        char* p = out;
+        if (!is_ok(m)) return to_lan(m, out);
+
+        Color us = pos.side_to_move();
+        Square from = from_sq(m);
+        Square to = to_sq(m);
+
+        if (type_of(m) == CASTLING) {
+            const char* castle = to > from ? "O-O" : "O-O-O";
+            while (*castle) *p++ = *castle++;
+            if (checks == Checks::Pgn && pos.gives_check(m)) *p++ = s_mates(pos, m) ? '#' : '+';
+            *p = '\0';
+            return p - out;
+        }
+
+        PieceType pt = type_of(pos.moved_piece(m));
+        bool capture = pos.capture(m);
+
+        if (pt == PAWN) {
+            if (capture) *p++ = char('a' + file_of(from));
+        } else {
+            *p++ = PieceChar[pt];
+            // Only the other pieces that can legally reach the same square need to be disambiguated.
+            Bitboard others = (pos.pieces(us, pt) & attacks_bb(pt, to, pos.pieces())) ^ from;
+            Bitboard ambiguous = 0;
+            while (others) {
+                Square s = pop_lsb(others);
+                if (pos.legal(make_move(s, to))) ambiguous |= s;
+            }
+            if (ambiguous) {
+                if (!(ambiguous & file_bb(from)))
+                    *p++ = char('a' + file_of(from));
+                else if (!(ambiguous & rank_bb(from)))
+                    *p++ = char('1' + rank_of(from));
+                else
+                    p = write_square(p, from);
+            }
+        }
+
+        if (capture) *p++ = 'x';
+        p = write_square(p, to);
+
+        if (type_of(m) == PROMOTION) {
+            *p++ = '=';
+            *p++ = PieceChar[promotion_type(m)];
+        }
+
+        // Plain captures are not marked with a check, consistently with the notation we always printed.
+        if (checks == Checks::Pgn) {
+            if (pos.gives_check(m)) *p++ = s_mates(pos, m) ? '#' : '+';
+        } else if ((!capture || type_of(m) == PROMOTION) && pos.gives_check(m)) {
+            *p++ = '+';
+        }
+
+        *p = '\0';
+        return p - out;
+    }
+
+    Move from_lan(const Position &pos, std::string_view lan)
+    {
+        if (lan.size() != 4 && lan.size() != 5) return MOVE_NONE;
+        if (!is_file(lan[0]) || !is_rank(lan[1]) || !is_file(lan[2]) || !is_rank(lan[3])) return MOVE_NONE;
+
+        Color us = pos.side_to_move();
+        Square from = to_square(lan[0], lan[1]);
+        Square to = to_square(lan[2], lan[3]);
+        Piece pc = pos.piece_on(from);
+
+        if (pc == NO_PIECE || color_of(pc) != us || from == to) return MOVE_NONE;
+
+        PieceType pt = type_of(pc);
+        if (pt == KING && rank_of(from) == rank_of(to) && distance<File>(from, to) == 2)
+            return castling_move(pos, to > from ? KING_SIDE : QUEEN_SIDE);
+
+        if (pos.pieces(us) & to) return MOVE_NONE;
+
+        if (pt != PAWN) {
+            if (lan.size() == 5 || !(attacks_bb(pt, from, pos.pieces()) & to)) return MOVE_NONE;
+            Move m = make_move(from, to);
+            return is_legal(pos, m) ? m : MOVE_NONE;
+        }
+
+        Move m;
+        if (to == pos.ep_square() && file_of(from) != file_of(to)) {
+            if (!(pawn_attacks_bb(us, from) & to)) return MOVE_NONE;
+            m = make<EN_PASSANT>(from, to);
+        } else {
+            if (!pawn_reaches(pos, us, from, to)) return MOVE_NONE;
+
+            bool last_rank = relative_rank(us, to) == RANK_8;
+            if (last_rank != (lan.size() == 5)) return MOVE_NONE;
+
+            if (last_rank) {
+                // The promotion piece character could be uppercased.
+                PieceType promo = piece_from_char(char(toupper(lan[4])));
+                if (promo == NO_PIECE_TYPE || promo == KING) return MOVE_NONE;
+                m = make<PROMOTION>(from, to, promo);
+            } else {
+                m = make_move(from, to);
+            }
+        }
+
+        return is_legal(pos, m) ? m : MOVE_NONE;
+    }
+
+    Move from_san(const Position &pos, std::string_view san)
+    {
+        san = strip_annotations(san);
+
+        if (san == "O-O" || san == "0-0") return castling_move(pos, KING_SIDE);
+        if (san == "O-O-O" || san == "0-0-0") return castling_move(pos, QUEEN_SIDE);
+
+        // promotion suffix, both "e8=Q" and "e8Q" are accepted.
+        PieceType promo = NO_PIECE_TYPE;
+        if (san.size() > 2 && piece_from_char(san.back()) != NO_PIECE_TYPE) {
+            promo = piece_from_char(san.back());
+            san.remove_suffix(1);
+            if (san.back() == '=') san.remove_suffix(1);
+            if (promo == KING) return MOVE_NONE;
+        }
+
+        if (san.size() < 2) return MOVE_NONE;
+
+        // piece prefix, pawns have none.
+        PieceType pt = PAWN;
+        if (piece_from_char(san.front()) != NO_PIECE_TYPE) {
+            pt = piece_from_char(san.front());
+            san.remove_prefix(1);
+        }
+
+        if (san.size() < 2 || !is_file(san[san.size()-2]) || !is_rank(san.back())) return MOVE_NONE;
+        Square to = to_square(san[san.size()-2], san.back());
+        san.remove_suffix(2);
+
+        // whatever is left is disambiguation and the capture marker.
+        Bitboard from_mask = ~Bitboard(0);
+        for (const char c : san) {
+            if (is_file(c)) from_mask &= file_bb(File(c - 'a'));
+            else if (is_rank(c)) from_mask &= rank_bb(Rank(c - '1'));
+            else if (c != 'x' && c != ':') return MOVE_NONE;
+        }
+
+        Color us = pos.side_to_move();
+        if (pos.pieces(us) & to) return MOVE_NONE;
+
+        if (pt != PAWN) {
+            if (promo != NO_PIECE_TYPE) return MOVE_NONE;
+            Bitboard candidates = pos.pieces(us, pt) & attacks_bb(pt, to, pos.pieces()) & from_mask;
+            while (candidates) {
+                Move m = make_move(pop_lsb(candidates), to);
+                if (is_legal(pos, m)) return m;
+            }
+            return MOVE_NONE;
+        }
+
+        if ((relative_rank(us, to) == RANK_8) != (promo != NO_PIECE_TYPE)) return MOVE_NONE;
+
+        Bitboard candidates;
+        if (from_mask != ~Bitboard(0)) // pawn captures always carry the starting file.
+            candidates = pos.pieces(us, PAWN) & pawn_attacks_bb(~us, to) & from_mask;
+        else {
+            Square push = to - pawn_push(us);
+            candidates = pos.pieces(us, PAWN) & push;
+            if (!candidates && pos.empty(push) && relative_rank(us, to) == RANK_4)
+                candidates = pos.pieces(us, PAWN) & (push - pawn_push(us));
+        }
+
+        while (candidates) {
+            Square from = pop_lsb(candidates);
+            Move m;
+            if (to == pos.ep_square() && file_of(from) != file_of(to))
+                m = make<EN_PASSANT>(from, to);
+            else if (!pawn_reaches(pos, us, from, to))
+                continue;
+            else
+                m = promo != NO_PIECE_TYPE ? make<PROMOTION>(from, to, promo) : make_move(from, to);
+
+            if (is_legal(pos, m)) return m;
+        }
+        return MOVE_NONE;
+    }
+
+    Move from_trusted_san(const Position &pos, std::string_view san)
+    {
+        san = strip_annotations(san);
+        Color us = pos.side_to_move();
+
+        if (san.size() >= 3 && (san[0] == 'O' || san[0] == '0')) {
+            CastlingRights cr = us & (san.size() >= 5 ? QUEEN_SIDE : KING_SIDE);
+            return pos.can_castle(cr) ? make<CASTLING>(pos.square<KING>(us), pos.castling_rook_square(cr)) : MOVE_NONE;
+        }
+
+        PieceType promo = NO_PIECE_TYPE;
+        if (san.size() > 2 && piece_from_char(san.back()) != NO_PIECE_TYPE) {
+            promo = piece_from_char(san.back());
+            san.remove_suffix(1);
+            if (san.back() == '=') san.remove_suffix(1);
+        }
+
+        PieceType pt = PAWN;
+        if (!san.empty() && piece_from_char(san.front()) != NO_PIECE_TYPE) {
+            pt = piece_from_char(san.front());
+            san.remove_prefix(1);
+        }
+
+        if (san.size() < 2 || !is_file(san[san.size()-2]) || !is_rank(san.back())) return MOVE_NONE;
+        Square to = to_square(san[san.size()-2], san.back());
+        san.remove_suffix(2);
+
+        Bitboard from_mask = ~Bitboard(0);
+        for (const char c : san) {
+            if (is_file(c)) from_mask &= file_bb(File(c - 'a'));
+            else if (is_rank(c)) from_mask &= rank_bb(Rank(c - '1'));
+        }
+
+        if (pt != PAWN) {
+            Bitboard candidates = pos.pieces(us, pt) & attacks_bb(pt, to, pos.pieces()) & from_mask;
+            if (!more_than_one(candidates))
+                return candidates ? make_move(lsb(candidates), to) : MOVE_NONE;
+            // SAN only disambiguates between legal moves, so all the other candidates are pinned.
+            while (candidates) {
+                Move m = make_move(pop_lsb(candidates), to);
+                if (pos.legal(m)) return m;
+            }
+            return MOVE_NONE;
+        }
+
+        Square from;
+        if (from_mask != ~Bitboard(0)) {
+            // at most one pawn of a file attacks a square. A capture on an empty square is en passant.
+            Bitboard candidates = pos.pieces(us, PAWN) & pawn_attacks_bb(~us, to) & from_mask;
+            if (!candidates) return MOVE_NONE;
+            from = lsb(candidates);
+            if (pos.empty(to)) return make<EN_PASSANT>(from, to);
+        } else {
+            if (relative_rank(us, to) < RANK_3) return MOVE_NONE;
+            from = to - pawn_push(us);
+            if (!(pos.pieces(us, PAWN) & from)) from -= pawn_push(us);
+            if (!(pos.pieces(us, PAWN) & from)) return MOVE_NONE;
+        }
+        return promo != NO_PIECE_TYPE ? make<PROMOTION>(from, to, promo) : make_move(from, to);
+    }
+}
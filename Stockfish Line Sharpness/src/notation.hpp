@@ -0,0 +1,44 @@
+//
+//  notation.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef notation_hpp
+#define notation_hpp
+
+#include <stdio.h>
+#include <string_view>
+
+#include "mini_stock/bitboard.h"
+#include "mini_stock/position.h"
+
+// Move codec between Stockfish::Move and the short (SAN) and long (LAN) algebraic notations.
+// Decoding resolves the move directly from the attack bitboards of the destination square,
+// without generating the legal move list. Encoding writes into a fixed buffer, no heap is touched.
+namespace Notation {
+
+    // The longest SAN we can produce is a double disambiguated capture with check ("Qa1xb2+")
+    // and the longest LAN is a promotion ("e7e8q"). Both fit, null terminator included.
+    static constexpr size_t MAX_MOVE_LEN = 8;
+    using MoveBuffer = char[MAX_MOVE_LEN];
+
+    // How to_san() marks the moves that give check. Legacy: a plain capture or a castling is never marked,
+    // as the notation we always printed. Pgn: every check is marked '+', a mate '#', as the PGN standard.
+    enum class Checks { Legacy, Pgn };
+
+    // Both return the length of the written string (terminator excluded).
+    size_t to_san(const Stockfish::Position &pos, Stockfish::Move m, MoveBuffer &out, Checks checks = Checks::Legacy);
+    size_t to_lan(Stockfish::Move m, MoveBuffer &out);
+
+    // Both return MOVE_NONE if the string is malformed or the move is not legal in pos.
+    Stockfish::Move from_san(const Stockfish::Position &pos, std::string_view san);
+    Stockfish::Move from_lan(const Stockfish::Position &pos, std::string_view lan);
+
+    // For games that are known to be legal (already validated databases): the piece is found with the
+    // attack bitboards and legality is only checked to tell apart two pieces that can reach the same
+    // square. Returns MOVE_NONE if nothing matches, but a wrong move on a trusted input is undefined.
+    Stockfish::Move from_trusted_san(const Stockfish::Position &pos, std::string_view san);
+
+}
+
+#endif /* notation_hpp */
@@ -0,0 +1,235 @@
+//
+//  output.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <charconv>
+#include <cmath>
+
+#include "output.hpp"
+
+namespace Output {
+
+    // Records are written out in blocks of about this size.
+    static constexpr size_t WRITE_BLOCK = 1 << 16;
+
+    bool ParseFormat(std::string_view name, Format &fmt)
+    {
+        if (name == "text") fmt = Format::Text;
+        else if (name == "jsonl" || name == "json") fmt = Format::Jsonl;
+        else if (name == "csv") fmt = Format::Csv;
+        else return false;
+        return true;
+    }
+
+    // Shortest representation that reads back to the same double, null for NaN and infinities.
+    static void s_append_number(std::string &out, double v)
+    {
+        if (!std::isfinite(v)) { out += "null"; return; }
+        char buf[32];
+        auto res = std::to_chars(buf, buf + sizeof(buf), v);
+        out.append(buf, res.ptr);
+    }
+
+    static void s_append_number(std::string &out, long long v)
+    {
+        char buf[24];
+        auto res = std::to_chars(buf, buf + sizeof(buf), v);
+        out.append(buf, res.ptr);
+    }
+
+    static void s_append_json_string(std::string &out, std::string_view s)
+    {
+        out += '"';
+        for (const char c : s) {
+            switch (c) {
+                case '"':  out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char buf[8];
+                        std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                        out += buf;
+                    } else out += c;
+            }
+        }
+        out += '"';
+    }
+
+    void AppendCsvField(std::string &out, std::string_view s)
+    {
+        if (s.find_first_of(",\"\r\n") == std::string_view::npos) { out += s; return; }
+        out += '"';
+        for (const char c : s) {
+            if (c == '"') out += '"';
+            out += c;
+        }
+        out += '"';
+    }
+
+    static void s_count_verdicts(const Record &r, long long &good, long long &inaccuracies, long long &bad)
+    {
+        good = inaccuracies = bad = 0;
+        for (const auto& m : r.moves) {
+            if (m.verdict == "good") good++;
+            else if (m.verdict == "inaccuracy") inaccuracies++;
+            else if (m.verdict == "bad") bad++;
+        }
+    }
+
+    void AppendJson(std::string &out, const Record &r)
+    {
+        long long good, inaccuracies, bad;
+        s_count_verdicts(r, good, inaccuracies, bad);
+
+        out += "{\"id\":"; s_append_json_string(out, r.id);
+        out += ",\"fen\":"; s_append_json_string(out, r.fen);
+        out += ",\"depth\":"; s_append_number(out, (long long)r.depth);
+        if (!r.error.empty()) {
+            out += ",\"error\":"; s_append_json_string(out, r.error);
+            out += "}\n";
+            return;
+        }
+        out += ",\"legal_moves\":"; s_append_number(out, (long long)r.legal_moves);
+        out += ",\"eval\":"; s_append_number(out, r.eval);
+        out += ",\"sharpness\":"; s_append_number(out, r.sharpness);
+        out += ",\"complexity\":";
+        if (r.complexity) s_append_number(out, *r.complexity); else out += "null";
+        out += ",\"good\":"; s_append_number(out, good);
+        out += ",\"inaccuracies\":"; s_append_number(out, inaccuracies);
+        out += ",\"bad\":"; s_append_number(out, bad);
+        out += ",\"seconds\":"; s_append_number(out, r.seconds);
+        out += ",\"moves\":[";
+        for (size_t i = 0; i < r.moves.size(); i++) {
+            const auto& m = r.moves[i];
+            if (i) out += ',';
+            out += "{\"san\":"; s_append_json_string(out, m.san);
+            out += ",\"lan\":"; s_append_json_string(out, m.lan);
+            out += ",\"eval\":"; s_append_number(out, m.eval);
+            out += ",\"loss\":"; s_append_number(out, m.loss);
+            out += ",\"verdict\":"; s_append_json_string(out, m.verdict);
+            out += '}';
+        }
+        out += "]}\n";
+    }
+
+    void AppendCsvHeader(std::string &out)
+    {
+        out += "id,fen,depth,legal_moves,eval,sharpness,complexity,good,inaccuracies,bad,seconds,moves,error\n";
+    }
+
+    void AppendCsv(std::string &out, const Record &r)
+    {
+        long long good, inaccuracies, bad;
+        s_count_verdicts(r, good, inaccuracies, bad);
+
+        AppendCsvField(out, r.id); out += ',';
+        AppendCsvField(out, r.fen); out += ',';
+        s_append_number(out, (long long)r.depth); out += ',';
+        if (r.error.empty()) {
+            s_append_number(out, (long long)r.legal_moves); out += ',';
+            s_append_number(out, r.eval); out += ',';
+            s_append_number(out, r.sharpness); out += ',';
+            if (r.complexity) s_append_number(out, *r.complexity);
+            out += ',';
+            s_append_number(out, good); out += ',';
+            s_append_number(out, inaccuracies); out += ',';
+            s_append_number(out, bad); out += ',';
+            s_append_number(out, r.seconds); out += ',';
+        } else out += ",,,,,,,,";
+
+        // the moves in a single field: "san:eval:verdict", space separated.
+        std::string moves;
+        for (const auto& m : r.moves) {
+            if (!moves.empty()) moves += ' ';
+            moves += m.san; moves += ':';
+            s_append_number(moves, m.eval);
+            moves += ':'; moves += m.verdict;
+        }
+        AppendCsvField(out, moves); out += ',';
+        AppendCsvField(out, r.error);
+        out += '\n';
+    }
+
+    void AppendTextHeader(std::string &out)
+    {
+        out += "# id\tfen\tmoves\teval\tsharpness\n";
+    }
+
+    void AppendText(std::string &out, const Record &r)
+    {
+        out += r.id; out += '\t'; out += r.fen; out += '\t';
+        if (!r.error.empty()) {
+            out += "error: "; out += r.error;
+        } else {
+            char buf[64];
+            std::snprintf(buf, sizeof(buf), "%d\t%g\t%g", r.legal_moves, r.eval, r.sharpness);
+            out += buf;
+        }
+        out += '\n';
+    }
+
+    Writer::Writer(std::ostream &os, Format fmt, size_t capacity)
+        : os_(os), fmt_(fmt), capacity_(std::max<size_t>(capacity, 1)), thread_(&Writer::Loop, this) {}
+
+    Writer::~Writer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            closing_ = true;
+        }
+        not_empty_.notify_one();
+        thread_.join();
+    }
+
+    void Writer::Push(Record r)
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        not_full_.wait(lock, [&]{ return queue_.size() < capacity_; });
+        queue_.push_back(std::move(r));
+        lock.unlock();
+        not_empty_.notify_one();
+    }
+
+    void Writer::Loop()
+    {
+        std::string buffer;
+        buffer.reserve(2 * WRITE_BLOCK);
+        if (fmt_ == Format::Csv) AppendCsvHeader(buffer);
+        else if (fmt_ == Format::Text) AppendTextHeader(buffer);
+        os_.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        os_.flush();
+        buffer.clear();
+
+        std::deque<Record> batch;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                not_empty_.wait(lock, [&]{ return closing_ || !queue_.empty(); });
+                if (queue_.empty()) break;
+                batch.swap(queue_);
+            }
+            not_full_.notify_all();
+
+            // whatever piled up while we were writing goes out in a few big writes.
+            for (const auto& r : batch) {
+                switch (fmt_) {
+                    case Format::Jsonl: AppendJson(buffer, r); break;
+                    case Format::Csv:   AppendCsv(buffer, r); break;
+                    case Format::Text:  AppendText(buffer, r); break;
+                }
+                if (buffer.size() >= WRITE_BLOCK) {
+                    os_.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                    buffer.clear();
+                }
+            }
+            batch.clear();
+            os_.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            os_.flush();
+            buffer.clear();
+        }
+    }
+}
@@ -0,0 +1,89 @@
+//
+//  output.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef output_hpp
+#define output_hpp
+
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Machine readable results: one record per analysed position, as JSON Lines or CSV.
+// Records are formatted and written by a background thread, so a slow consumer on the other
+// end of the pipe never stalls the analysis.
+namespace Output {
+
+    // Text is the tab separated line of the batch mode: id, FEN, legal moves, eval and sharpness.
+    enum class Format { Text, Jsonl, Csv };
+
+    // "text", "jsonl" (or "json") and "csv". Returns false for anything else.
+    bool ParseFormat(std::string_view name, Format &fmt);
+
+    struct MoveRecord {
+        std::string san;
+        std::string lan;
+        double eval {};                 // expected score after the move, from white's point of view
+        double loss {};                 // expected score lost by the side to move, compared to the position
+        std::string_view verdict {};    // "good", "inaccuracy" or "bad" (see Sharpness::Verdict)
+    };
+
+    struct Record {
+        std::string id {};              // the EPD "id" operation, or the position number in the input
+        std::string fen {};
+        int depth {};
+        int legal_moves {};
+        double eval {};                 // expected score in [-1, 1], from white's point of view
+        double sharpness {};
+        std::optional<double> complexity {};
+        std::vector<MoveRecord> moves {};   // sorted from the best to the worst
+        double seconds {};              // time spent analysing the position
+        std::string error {};           // non empty if the position could not be analysed
+    };
+
+    // Append the record, newline included, to out.
+    void AppendTextHeader(std::string &out);
+    void AppendText(std::string &out, const Record &r);
+    void AppendJson(std::string &out, const Record &r);
+    void AppendCsvHeader(std::string &out);
+    void AppendCsv(std::string &out, const Record &r);
+    // A single CSV field, quoted if it has to be.
+    void AppendCsvField(std::string &out, std::string_view s);
+
+    // Formats and writes the records pushed from any thread, in the order they were pushed.
+    // Push() blocks only when `capacity` records are already waiting. Pending records are
+    // written before the destructor returns.
+    class Writer {
+    public:
+        Writer(std::ostream &os, Format fmt, size_t capacity = 1024);
+        ~Writer();
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        void Push(Record r);
+
+    private:
+        void Loop();
+
+        std::ostream &os_;
+        Format fmt_;
+        size_t capacity_;
+
+        std::mutex mtx_;
+        std::condition_variable not_empty_, not_full_;
+        std::deque<Record> queue_;
+        bool closing_ {false};
+        std::thread thread_;
+    };
+}
+
+#endif /* output_hpp */
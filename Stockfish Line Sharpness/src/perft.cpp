@@ -0,0 +1,248 @@
+//
+//  perft.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "perft.hpp"
+#include "fen.hpp"
+#include "ingest.hpp"
+
+namespace Perft {
+    using namespace Stockfish;
+
+    const char* StandardSuite = R"(rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 ;D1 20 ;D2 400 ;D3 8902 ;D4 197281 ;D5 4865609 ;D6 119060324
+r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1 ;D1 48 ;D2 2039 ;D3 97862 ;D4 4085603 ;D5 193690690
+8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1 ;D1 14 ;D2 191 ;D3 2812 ;D4 43238 ;D5 674624 ;D6 11030083
+r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1 ;D1 6 ;D2 264 ;D3 9467 ;D4 422333 ;D5 15833292
+r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1 ;D1 6 ;D2 264 ;D3 9467 ;D4 422333 ;D5 15833292
+rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8 ;D1 44 ;D2 1486 ;D3 62379 ;D4 2103487 ;D5 89941194
+r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10 ;D1 46 ;D2 2079 ;D3 89890 ;D4 3894594 ;D5 164075551
+4k3/8/8/8/8/8/8/4K2R w K - 0 1 ;D1 15 ;D2 66 ;D3 1197 ;D4 7059 ;D5 133987 ;D6 764643
+4k3/8/8/8/8/8/8/R3K3 w Q - 0 1 ;D1 16 ;D2 71 ;D3 1287 ;D4 7626 ;D5 145232 ;D6 846648
+4k2r/8/8/8/8/8/8/4K3 w k - 0 1 ;D1 5 ;D2 75 ;D3 459 ;D4 8290 ;D5 47635 ;D6 899442
+r3k3/8/8/8/8/8/8/4K3 w q - 0 1 ;D1 5 ;D2 80 ;D3 493 ;D4 8897 ;D5 52710 ;D6 1001523
+4k3/8/8/8/8/8/8/R3K2R w KQ - 0 1 ;D1 26 ;D2 112 ;D3 3189 ;D4 17945 ;D5 532933 ;D6 2788982
+r3k2r/8/8/8/8/8/8/4K3 w kq - 0 1 ;D1 5 ;D2 130 ;D3 782 ;D4 22180 ;D5 118882 ;D6 3517770
+8/8/8/8/8/8/6k1/4K2R w K - 0 1 ;D1 12 ;D2 38 ;D3 564 ;D4 2219 ;D5 37735 ;D6 185867
+r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1 ;D1 26 ;D2 568 ;D3 13744 ;D4 314346 ;D5 7594526 ;D6 179862938
+8/1n4N1/2k5/8/8/5K2/1N4n1/8 w - - 0 1 ;D1 14 ;D2 195 ;D3 2760 ;D4 38675 ;D5 570726 ;D6 8107539
+K7/8/2n5/1n6/8/8/8/k6N w - - 0 1 ;D1 3 ;D2 51 ;D3 345 ;D4 5301 ;D5 38348 ;D6 588695
+8/P1k5/K7/8/8/8/8/8 w - - 0 1 ;D1 6 ;D2 27 ;D3 273 ;D4 1329 ;D5 18135 ;D6 92683
+n1n5/PPPk4/8/8/8/8/4Kppp/5N1N w - - 0 1 ;D1 24 ;D2 496 ;D3 9483 ;D4 182838 ;D5 3605103 ;D6 71179139
+n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1 ;D1 24 ;D2 496 ;D3 9483 ;D4 182838 ;D5 3605103 ;D6 71179139
+3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1 ;D6 1134888
+8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1 ;D6 1015133
+8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1 ;D6 1440467
+5k2/8/8/8/8/8/8/4K2R w K - 0 1 ;D6 661072
+3k4/8/8/8/8/8/8/R3K3 w Q - 0 1 ;D6 803711
+r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1 ;D4 1274206
+r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1 ;D4 1720476
+2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1 ;D6 3821001
+8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1 ;D5 1004658
+4k3/1P6/8/8/8/8/K7/8 w - - 0 1 ;D6 217342
+K1k5/8/P7/8/8/8/8/8 w - - 0 1 ;D6 2217
+8/k1P5/8/1K6/8/8/8/8 w - - 0 1 ;D7 567584
+8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1 ;D4 23527
+)";
+
+    HashTable::HashTable(size_t mb)
+    {
+        // round down to a power of two number of entries.
+        size_t entries = 1;
+        while (entries * 2 * sizeof(Entry) <= mb * 1024 * 1024) entries *= 2;
+
+        table_ = std::make_unique<Entry[]>(entries);
+        mask_ = entries - 1;
+        for (size_t i = 0; i < entries; i++) {
+            table_[i].check.store(0, std::memory_order_relaxed);
+            table_[i].data.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    bool HashTable::probe(Key key, int depth, uint64_t &nodes) const
+    {
+        const Entry &e = table_[key & mask_];
+        uint64_t data = e.data.load(std::memory_order_relaxed);
+        uint64_t check = e.check.load(std::memory_order_relaxed);
+
+        if ((check ^ data) != key || int(data & 0xFF) != depth) return false;
+        nodes = data >> 8;
+        return true;
+    }
+
+    void HashTable::store(Key key, int depth, uint64_t nodes)
+    {
+        Entry &e = table_[key & mask_];
+        uint64_t data = (nodes << 8) | uint64_t(depth);
+        e.data.store(data, std::memory_order_relaxed);
+        e.check.store(key ^ data, std::memory_order_relaxed);
+    }
+
+    std::vector<EpdEntry> parse_epd(std::istream &is)
+    {
+        std::vector<EpdEntry> suite;
+        std::string line;
+        while (std::getline(is, line)) {
+            auto fields = line.find(';');
+            if (fields == std::string::npos) continue;
+
+            EpdEntry entry {line.substr(0, fields), {}};
+            while (!entry.fen.empty() && entry.fen.back() == ' ') entry.fen.pop_back();
+
+            // the operations are in the form ";D<depth> <nodes>"
+            std::istringstream ops(line.substr(fields));
+            std::string token;
+            while (std::getline(ops, token, ';')) {
+                std::istringstream op(token);
+                std::string depth;
+                uint64_t nodes;
+                if ((op >> depth >> nodes) && depth.size() > 1 && depth[0] == 'D')
+                    entry.depths.emplace_back(std::stoi(depth.substr(1)), nodes);
+            }
+            if (!entry.depths.empty()) suite.push_back(std::move(entry));
+        }
+        return suite;
+    }
+
+    uint64_t perft(Position &pos, int depth, HashTable *tt)
+    {
+        if (depth <= 1) return count_legal(pos).total;
+
+        uint64_t nodes {};
+        // the raw key, the one returned by key() also depends on the rule50 counter.
+        Key key = pos.state()->key;
+        if (tt && tt->probe(key, depth, nodes)) return nodes;
+
+        StateInfo st;
+        for (const auto m : MoveList<LEGAL>(pos)) {
+            pos.do_move(m, st);
+            nodes += perft(pos, depth - 1, tt);
+            pos.undo_move(m);
+        }
+
+        if (tt) tt->store(key, depth, nodes);
+        return nodes;
+    }
+
+    uint64_t perft(const std::string &fen, int depth, int threads, HashTable *tt)
+    {
+        StateInfo root_st;
+        Position root;
+        root.set(fen, false, &root_st);
+
+        MoveList<LEGAL> moves(root);
+        if (depth <= 1 || threads <= 1) return perft(root, depth, tt);
+
+        std::atomic<size_t> next {0};
+        std::atomic<uint64_t> nodes {0};
+        std::vector<std::thread> workers;
+
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&] {
+                StateInfo st, child_st;
+                Position pos;
+                pos.set(fen, false, &st);
+
+                uint64_t local {};
+                for (size_t idx = next++; idx < moves.size(); idx = next++) {
+                    pos.do_move(moves[idx], child_st);
+                    local += perft(pos, depth - 1, tt);
+                    pos.undo_move(moves[idx]);
+                }
+                nodes += local;
+            });
+        }
+        for (auto &w : workers) w.join();
+
+        return nodes;
+    }
+
+    bool run_suite(const std::vector<EpdEntry> &suite, const Options &opts, std::ostream &os)
+    {
+        std::unique_ptr<HashTable> tt;
+        if (opts.hash_mb) tt = std::make_unique<HashTable>(opts.hash_mb);
+
+        bool all_ok = true;
+        uint64_t total_nodes {};
+        auto start = std::chrono::steady_clock::now();
+
+        for (const auto &entry : suite) {
+            for (const auto &[depth, expected] : entry.depths) {
+                if (depth > opts.max_depth) continue;
+
+                auto nodes = perft(entry.fen, depth, opts.threads, tt.get());
+                total_nodes += nodes;
+
+                bool ok = nodes == expected;
+                all_ok &= ok;
+                os << (ok ? "[OK]   " : "[FAIL] ") << entry.fen << " D" << depth << ": " << nodes;
+                if (!ok) os << " (expected " << expected << ")";
+                os << '\n';
+            }
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        os << "Nodes: " << total_nodes << " in " << elapsed.count() << "s, "
+        << static_cast<double>(total_nodes) / elapsed.count() << " nodes/s"
+        << " (kernels: " << Bitboards::variant_name(Bitboards::cpu_variant())
+        << ", threads: " << opts.threads << ", hash: " << opts.hash_mb << "MB)" << std::endl;
+
+        return all_ok;
+    }
+
+    // Adds the position of an EPD or FEN line to stats, returns false if it is not valid.
+    static bool s_add_line(std::string_view line, Position &pos, StateInfo &st, BranchingStats &stats)
+    {
+        // drop the EPD operations, if any.
+        line = line.substr(0, line.find(';'));
+        while (!line.empty() && (line.back() == ' ' || line.back() == '\r')) line.remove_suffix(1);
+        if (line.empty()) return true;
+
+        if (parseFEN(line, pos, &st) != FEN_OK) return false;
+        stats.add(count_legal(pos));
+        return true;
+    }
+
+    BranchingStats branching_stats(std::istream &is, size_t *rejected)
+    {
+        BranchingStats stats;
+        StateInfo st;
+        Position pos;
+        std::string line;
+        size_t bad {};
+
+        while (std::getline(is, line))
+            bad += !s_add_line(line, pos, st, stats);
+
+        if (rejected) *rejected = bad;
+        return stats;
+    }
+
+    BranchingStats branching_stats(std::string_view text, int threads, size_t *rejected)
+    {
+        BranchingStats stats;
+        std::atomic<size_t> bad {0};
+        std::mutex mtx;
+
+        Ingest::parallel_for_each_chunk(text, Ingest::Format::Lines, threads, 1 << 20,
+                                        [&](size_t, const std::vector<std::string_view> &lines) {
+            BranchingStats local;
+            StateInfo st;
+            Position pos;
+            size_t local_bad {};
+            for (auto line : lines) local_bad += !s_add_line(line, pos, st, local);
+
+            bad += local_bad;
+            std::lock_guard<std::mutex> lock(mtx);
+            stats.merge(local);
+        });
+
+        if (rejected) *rejected = bad;
+        return stats;
+    }
+}
@@ -0,0 +1,76 @@
+//
+//  perft.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef perft_hpp
+#define perft_hpp
+
+#include <stdio.h>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mini_stock/bitboard.h"
+#include "mini_stock/position.h"
+#include "mini_stock/movegen.h"
+
+// Move generation validation and benchmark: counts the leaf nodes of the legal move tree
+// and compares them against known values.
+namespace Perft {
+
+    // Transposition table for subtree counts. Entries are written and read without locks,
+    // a torn entry is detected by storing the key xored with the data (Hyatt's trick).
+    class HashTable {
+    public:
+        explicit HashTable(size_t mb);
+
+        bool probe(Stockfish::Key key, int depth, uint64_t &nodes) const;
+        void store(Stockfish::Key key, int depth, uint64_t nodes);
+
+    private:
+        struct Entry {
+            std::atomic<uint64_t> check;
+            std::atomic<uint64_t> data;
+        };
+        std::unique_ptr<Entry[]> table_;
+        size_t mask_ {};
+    };
+
+    struct EpdEntry {
+        std::string fen;
+        std::vector<std::pair<int, uint64_t>> depths; // (depth, expected nodes)
+    };
+
+    struct Options {
+        int max_depth {5};
+        int threads {1};
+        size_t hash_mb {0}; // 0 disables the hash table
+    };
+
+    // The standard suite: classic positions (start, kiwipete, ...) plus the known
+    // castling, promotion, en passant and pin corner cases.
+    extern const char* StandardSuite;
+
+    std::vector<EpdEntry> parse_epd(std::istream &is);
+
+    // Leaf moves are bulk counted with Stockfish::count_legal(), without being generated nor played.
+    uint64_t perft(Stockfish::Position &pos, int depth, HashTable *tt = nullptr);
+    // Splits the root moves across threads, each one with its own copy of the position.
+    uint64_t perft(const std::string &fen, int depth, int threads, HashTable *tt = nullptr);
+
+    // Runs every entry up to opts.max_depth, printing the results and the nodes/second.
+    // Returns false if any count does not match.
+    bool run_suite(const std::vector<EpdEntry> &suite, const Options &opts, std::ostream &os = std::cout);
+
+    // Branching factor statistics over a stream of positions, one FEN (or EPD line) per line.
+    // Lines that are not a valid FEN are skipped and counted in rejected.
+    Stockfish::BranchingStats branching_stats(std::istream &is, size_t *rejected = nullptr);
+    // Same over text already in memory (see Ingest::MappedFile), parsed by `threads` threads in chunks.
+    Stockfish::BranchingStats branching_stats(std::string_view text, int threads, size_t *rejected = nullptr);
+}
+
+#endif /* perft_hpp */
@@ -0,0 +1,292 @@
+//
+//  pgn.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <string_view>
+
+#include "pgn.hpp"
+
+namespace Pgn {
+
+    static bool s_is_result(const std::string &token)
+    {
+        return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+    }
+
+    // Traditional suffix annotations and their NAG.
+    static int s_suffix_nag(const std::string &suffix)
+    {
+        if (suffix == "!")  return 1;
+        if (suffix == "?")  return 2;
+        if (suffix == "!!") return 3;
+        if (suffix == "??") return 4;
+        if (suffix == "!?") return 5;
+        if (suffix == "?!") return 6;
+        return 0;
+    }
+
+    static void s_append_comment(std::string &to, const std::string &comment)
+    {
+        if (comment.empty()) return;
+        if (!to.empty()) to += ' ';
+        to += comment;
+    }
+
+    static std::string s_trim(const std::string &s)
+    {
+        auto first = s.find_first_not_of(" \t\r\n");
+        if (first == std::string::npos) return {};
+        return s.substr(first, s.find_last_not_of(" \t\r\n") - first + 1);
+    }
+
+    std::string Game::Tag(const std::string &name) const
+    {
+        for (const auto& [tag, value] : tags)
+            if (tag == name) return value;
+        return {};
+    }
+
+    std::string Game::InitialFen() const
+    {
+        auto fen = Tag("FEN");
+        return fen.empty() ? StartFen : fen;
+    }
+
+    // The parser reads from either of these: a stream, or a slice of text already in memory.
+    struct StreamSource {
+        std::istream &is;
+
+        int peek() { return is.peek(); }
+        int get() { return is.get(); }
+        std::string read_until(char end)
+        {
+            std::string s;
+            std::getline(is, s, end);
+            return s;
+        }
+    };
+
+    struct ViewSource {
+        std::string_view text;
+        size_t pos {};
+
+        int peek() { return pos < text.size() ? (unsigned char)text[pos] : EOF; }
+        int get() { return pos < text.size() ? (unsigned char)text[pos++] : EOF; }
+        std::string read_until(char end)
+        {
+            auto found = std::min(text.find(end, pos), text.size());
+            std::string s(text.substr(pos, found - pos));
+            pos = std::min(found + 1, text.size());
+            return s;
+        }
+    };
+
+    template<typename Source>
+    static bool s_read_tag(Source &src, Game &game)
+    {
+        // [Name "value"], the value can contain escaped quotes and backslashes.
+        src.get(); // '['
+        std::string name;
+        for (int c = src.peek(); c != EOF && !std::isspace(c) && c != '"' && c != ']'; c = src.peek())
+            name += char(src.get());
+        while (src.peek() != EOF && std::isspace(src.peek())) src.get();
+
+        std::string value;
+        if (src.peek() == '"') {
+            src.get();
+            for (int c = src.get(); c != EOF && c != '"'; c = src.get()) {
+                if (c == '\\') c = src.get();
+                if (c != EOF) value += char(c);
+            }
+        }
+        src.read_until(']');
+
+        if (name.empty()) return false;
+        game.tags.emplace_back(std::move(name), std::move(value));
+        return true;
+    }
+
+    template<typename Source>
+    static void s_skip_variation(Source &src)
+    {
+        // the opening '(' was already consumed. Comments can contain parentheses.
+        int depth = 1;
+        while (depth) {
+            int c = src.get();
+            if (c == EOF) break;
+            if (c == '(') depth++;
+            else if (c == ')') depth--;
+            else if (c == '{') src.read_until('}');
+            else if (c == ';') src.read_until('\n');
+        }
+    }
+
+    template<typename Source>
+    static bool s_read_game(Source &src, Game &game)
+    {
+        game = Game {};
+        bool found = false;
+
+        for (int c = src.peek(); c != EOF; c = src.peek()) {
+            if (std::isspace(c)) { src.get(); continue; }
+
+            // a tag after the movetext started belongs to the next game (the result was missing).
+            if (c == '[') {
+                if (!game.plies.empty()) return true;
+                found |= s_read_tag(src, game);
+                continue;
+            }
+
+            // escape mechanism: lines starting with '%' are ignored.
+            if (c == '%') { src.read_until('\n'); continue; }
+
+            found = true;
+            if (c == '{' || c == ';') {
+                src.get();
+                auto comment = s_trim(src.read_until(c == '{' ? '}' : '\n'));
+                s_append_comment(game.plies.empty() ? game.comment : game.plies.back().comment, comment);
+                continue;
+            }
+            if (c == '(') { src.get(); s_skip_variation(src); continue; }
+            if (c == ')') { src.get(); continue; }
+
+            // symbols: move numbers, moves, NAGs and the result.
+            std::string token;
+            for (c = src.peek(); c != EOF && !std::isspace(c)
+                 && std::string_view("{}();[").find(char(c)) == std::string_view::npos; c = src.peek())
+                token += char(src.get());
+
+            if (token.empty()) { src.get(); continue; }
+
+            if (s_is_result(token)) {
+                game.result = token;
+                return true;
+            }
+
+            if (token[0] == '$') {
+                if (!game.plies.empty() && token.size() > 1
+                    && std::all_of(token.begin() + 1, token.end(), ::isdigit))
+                    game.plies.back().nags.push_back(std::stoi(token.substr(1)));
+                continue;
+            }
+
+            // move numbers can be glued to the move: "12.Nf3", "12...Nf6".
+            size_t start = 0;
+            while (start < token.size() && std::isdigit(token[start])) start++;
+            if (start && start < token.size() && token[start] == '.') {
+                while (start < token.size() && token[start] == '.') start++;
+                token.erase(0, start);
+            } else if (start == token.size()) continue;
+            if (token.empty()) continue;
+
+            Ply ply;
+            auto suffix = token.find_first_of("!?");
+            if (suffix != std::string::npos) {
+                if (int nag = s_suffix_nag(token.substr(suffix))) ply.nags.push_back(nag);
+                token.erase(suffix);
+            }
+            ply.san = std::move(token);
+            game.plies.push_back(std::move(ply));
+        }
+
+        return found;
+    }
+
+    bool Reader::Next(Game &game)
+    {
+        StreamSource src {is_};
+        return s_read_game(src, game);
+    }
+
+    bool Parse(std::string_view text, Game &game)
+    {
+        ViewSource src {text};
+        return s_read_game(src, game);
+    }
+
+    // Accumulates the movetext tokens and breaks the lines before 80 characters.
+    class LineWrapper {
+    public:
+        explicit LineWrapper(std::ostream &os) : os_(os) {}
+        ~LineWrapper() { if (len_) os_ << '\n'; }
+
+        void Token(const std::string &token)
+        {
+            if (len_ && len_ + 1 + token.size() >= 80) { os_ << '\n'; len_ = 0; }
+            if (len_) { os_ << ' '; len_++; }
+            os_ << token;
+            len_ += token.size();
+        }
+
+        // Comments are split into words, so that they can be wrapped as well.
+        void Comment(const std::string &comment)
+        {
+            // embedded commands ("[%sharp 0.1 0.2]") are never broken across lines.
+            std::istringstream is(comment);
+            std::vector<std::string> words;
+            bool in_command = false;
+            for (std::string word; is >> word; ) {
+                if (in_command) words.back() += ' ' + word;
+                else words.push_back(word);
+                if (word.starts_with("[%")) in_command = true;
+                if (word.ends_with(']')) in_command = false;
+            }
+            if (words.empty()) { Token("{}"); return; }
+
+            words.front().insert(0, "{");
+            words.back() += '}';
+            for (const auto& word : words) Token(word);
+        }
+
+    private:
+        std::ostream &os_;
+        size_t len_ {};
+    };
+
+    void Write(std::ostream &os, const Game &game)
+    {
+        for (const auto& [tag, value] : game.tags) {
+            os << '[' << tag << " \"";
+            for (char c : value) {
+                if (c == '"' || c == '\\') os << '\\';
+                os << c;
+            }
+            os << "\"]\n";
+        }
+        os << '\n';
+
+        // the move number is written for the first move, for every white move,
+        // and for black moves following a comment.
+        std::istringstream fen(game.InitialFen());
+        std::string field, side;
+        fen >> field >> side;
+        int number = 1;
+        for (int i = 0; i < 4 && fen >> field; i++)
+            if (i == 3) number = std::max(1, std::atoi(field.c_str()));
+        bool white = side != "b";
+
+        {
+            LineWrapper out(os);
+            if (!game.comment.empty()) out.Comment(game.comment);
+
+            bool need_number = true;
+            for (const auto& ply : game.plies) {
+                if (white) out.Token(std::to_string(number) + ".");
+                else if (need_number) out.Token(std::to_string(number) + "...");
+                out.Token(ply.san);
+                for (int nag : ply.nags) out.Token("$" + std::to_string(nag));
+                need_number = !ply.comment.empty();
+                if (need_number) out.Comment(ply.comment);
+
+                if (!white) number++;
+                white = !white;
+            }
+            out.Token(game.result);
+        }
+        os << '\n';
+    }
+}
@@ -0,0 +1,60 @@
+//
+//  pgn.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef pgn_hpp
+#define pgn_hpp
+
+#include <stdio.h>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Reading and writing of PGN games: tag pairs, SAN movetext, comments and NAGs.
+// Variations are skipped when reading, the tool only follows the main line.
+namespace Pgn {
+
+    static const auto StartFen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+    struct Ply {
+        std::string san;                // as written in the game, without the "!?" suffixes
+        std::vector<int> nags;          // "!?" suffixes are turned into their NAG ($1 - $6)
+        std::string comment;            // comment following the move
+    };
+
+    struct Game {
+        std::vector<std::pair<std::string, std::string>> tags;
+        std::string comment;            // comment before the first move
+        std::vector<Ply> plies;
+        std::string result {"*"};
+
+        // Empty string if the tag is not there.
+        std::string Tag(const std::string &name) const;
+        // The FEN tag if present, the starting position otherwise.
+        std::string InitialFen() const;
+    };
+
+    // Reads one game at a time from a stream, so that memory does not depend on the size of the file.
+    class Reader {
+    public:
+        explicit Reader(std::istream &is) : is_(is) {}
+
+        // Returns false when there are no more games.
+        bool Next(Game &game);
+
+    private:
+        std::istream &is_;
+    };
+
+    // Parses the first game found in text (for instance a record split by Ingest), without copying it first.
+    bool Parse(std::string_view text, Game &game);
+
+    // Writes the game in export format, movetext lines are kept under 80 characters.
+    void Write(std::ostream &os, const Game &game);
+
+}
+
+#endif /* pgn_hpp */
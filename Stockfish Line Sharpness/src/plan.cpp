@@ -0,0 +1,79 @@
+//
+//  plan.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <algorithm>
+#include <thread>
+
+#include "plan.hpp"
+
+namespace Plan {
+
+    bool ParseWorkload(std::string_view name, Workload &workload)
+    {
+        if (name == "shallow") workload = Workload::Shallow;
+        else if (name == "deep") workload = Workload::Deep;
+        else return false;
+        return true;
+    }
+
+    const char* Name(Workload workload)
+    {
+        return workload == Workload::Deep ? "deep" : "shallow";
+    }
+
+    int Cores()
+    {
+        return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+
+    // The largest power of two not above mb, at least 1.
+    static int s_floor_pow2(int mb)
+    {
+        int p = 1;
+        while (p <= mb / 2) p *= 2;
+        return p;
+    }
+
+    static Layout s_split(int cores, int hash_mb, int engines)
+    {
+        Layout l;
+        l.engines = std::max(1, engines);
+        l.threads = std::max(1, cores / l.engines);
+        l.hash_mb = s_floor_pow2(hash_mb / l.engines);
+        return l;
+    }
+
+    Layout Make(Workload workload, const Budget &budget)
+    {
+        const int cores = budget.cores > 0 ? budget.cores : Cores();
+        const int hash_mb = budget.hash_mb > 0 ? budget.hash_mb : 16 * cores;
+
+        int engines = workload == Workload::Shallow ? cores : 1;
+        if (budget.engines > 0) engines = budget.engines;
+        else if (budget.threads > 0) engines = std::max(1, cores / budget.threads);
+
+        auto l = s_split(cores, hash_mb, engines);
+        if (budget.threads > 0) l.threads = budget.threads;
+        return l;
+    }
+
+    std::vector<Layout> Candidates(const Budget &budget)
+    {
+        const int cores = budget.cores > 0 ? budget.cores : Cores();
+        const int hash_mb = budget.hash_mb > 0 ? budget.hash_mb : 16 * cores;
+
+        std::vector<Layout> layouts;
+        for (int engines = 1; engines < cores; engines *= 2) layouts.push_back(s_split(cores, hash_mb, engines));
+        layouts.push_back(s_split(cores, hash_mb, cores));
+        return layouts;
+    }
+
+    std::string Describe(const Layout &l)
+    {
+        return std::to_string(l.engines) + (l.engines == 1 ? " engine x " : " engines x ")
+             + std::to_string(l.threads) + (l.threads == 1 ? " thread, " : " threads, ")
+             + std::to_string(l.hash_mb) + " MB hash" + (l.engines == 1 ? "" : " each");
+    }
+}
@@ -0,0 +1,56 @@
+//
+//  plan.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef plan_hpp
+#define plan_hpp
+
+#include <stdio.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Splits a budget of cores and of hash between engine processes. Stockfish scales poorly over threads on
+// short searches, but every engine is a process of its own: many shallow searches (a batch, the games of a
+// PGN, the positions of a line) run fastest on one single threaded engine per core. A single deep search
+// is the reverse, one engine with every core. The hash follows the engines, every engine gets its share.
+namespace Plan {
+
+    enum class Workload { Shallow, Deep };
+
+    // Parses --workload: "shallow" or "deep".
+    bool ParseWorkload(std::string_view name, Workload &workload);
+    const char* Name(Workload workload);
+
+    struct Budget {
+        int cores {};       // 0: the cores of the machine
+        int hash_mb {};     // 0: 16 MB per core, the Hash of Stockfish per thread
+        // overrides, 0 when planned
+        int engines {};
+        int threads {};
+    };
+
+    struct Layout {
+        int engines {1};
+        int threads {1};    // per engine
+        int hash_mb {16};   // per engine
+    };
+
+    // The cores of the machine, at least 1.
+    int Cores();
+
+    // The engines, threads and hash for the workload. With an override the rest of the budget is split
+    // around it: -j 4 on 16 cores gives 4 threads per engine. Threads are never below 1, the hash of an
+    // engine is a power of two (as Stockfish rounds it) and at least 1 MB.
+    Layout Make(Workload workload, const Budget &budget);
+
+    // The layouts worth comparing on the budget: 1, 2, 4... engines up to one per core, the cores split
+    // evenly between them.
+    std::vector<Layout> Candidates(const Budget &budget);
+
+    // "4 engines x 2 threads, 64 MB hash each"
+    std::string Describe(const Layout &layout);
+}
+
+#endif /* plan_hpp */
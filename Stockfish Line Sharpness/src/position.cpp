@@ -9,18 +9,27 @@
 #include "utils.hpp"
 #include "fen.hpp"
 
+// The lookup tables are global, they only need to be computed once.
+static void init_tables()
+{
+    static const bool initialized = [] {
+        Stockfish::Bitboards::init();
+        Stockfish::Position::init();
+        return true;
+    }();
+    (void)initialized;
+}
+
 Position::Position() : Stockfish::Position()
 {
-    Stockfish::Bitboards::init();
-    Stockfish::Position::init();
+    init_tables();
     
     StateInfoList_ = std::make_unique<std::deque<Stockfish::StateInfo>>();
     Set("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
 }
 Position::Position(const std::string &fen) : Stockfish::Position()
 {
-    Stockfish::Bitboards::init();
-    Stockfish::Position::init();
+    init_tables();
     
     StateInfoList_ = std::make_unique<std::deque<Stockfish::StateInfo>>();
     Set(fen);
@@ -29,11 +38,12 @@ Position::Position(const std::string &fen) : Stockfish::Position()
 
 Position& Position::Set(const std::string &fen)
 {
-    if (checkFEN(fen.c_str()) < 0) throw std::runtime_error("Please enter a valid FEN string");
     // deletes all previous states
     StateInfoList_->erase(StateInfoList_->cbegin(), StateInfoList_->cend());
     StateInfoList_->push_back(Stockfish::StateInfo());
-    set(fen, false, &StateInfoList_->back());
+    // validates and sets up the position in a single pass.
+    if (auto err = parseFEN(fen, *this, &StateInfoList_->back()); err != FEN_OK)
+        throw std::runtime_error(std::string("Please enter a valid FEN string: ") + fen_error_string(err));
     
     return *this;
 }
@@ -0,0 +1,416 @@
+//
+//  reactor.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
+
+#include "reactor.hpp"
+
+namespace Reactor {
+
+    // An engine that died does not kill us with SIGPIPE.
+#ifdef MSG_NOSIGNAL
+    static constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    static constexpr int SEND_FLAGS = 0;    // SO_NOSIGPIPE is set on the socket instead
+#endif
+
+    struct Loop::Session {
+        enum class State { Handshake, Syncing, Idle, Searching, Dead };
+
+        pid_t pid {-1};
+        int fd {-1};
+        State state {State::Handshake};
+        bool spare {};              // started, but given no search until an engine exits
+        size_t searches {};
+        std::string partial;        // the start of a line not yet terminated
+        Search search {};
+        Result result {};
+    };
+
+    // Starts argv with a socket as its stdin and stdout, our end is returned in fd (non blocking).
+    static pid_t s_spawn(const std::vector<std::string> &argv, int &fd)
+    {
+        int sv[2];
+        if (argv.empty() || socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) return -1;
+
+        std::vector<char*> args;
+        for (const auto& a : argv) args.push_back(const_cast<char*>(a.c_str()));
+        args.push_back(nullptr);
+
+        const pid_t pid = fork();
+        if (pid == 0) {
+            // a program that catches Ctrl-C shuts its engines down itself (see Interrupt), also those
+            // started after Interrupt::Catch(): they ignore it.
+            struct sigaction sa {};
+            if (sigaction(SIGINT, nullptr, &sa) == 0 && sa.sa_handler != SIG_DFL) signal(SIGINT, SIG_IGN);
+            dup2(sv[1], STDIN_FILENO);
+            dup2(sv[1], STDOUT_FILENO);
+            close(sv[0]);
+            close(sv[1]);
+            execvp(args[0], args.data());
+            _exit(127);
+        }
+        close(sv[1]);
+        if (pid < 0) {
+            close(sv[0]);
+            return -1;
+        }
+        fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+        fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+        int one = 1;
+        setsockopt(sv[0], SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+        fd = sv[0];
+        return pid;
+    }
+
+    // How long an engine has to exit once it was told to, or once we stopped talking to it.
+    static constexpr auto EXIT_GRACE = std::chrono::seconds(1);
+
+    // Waits for the engine to exit, then kills it. Blocks: only for the destructor.
+    static void s_reap(pid_t pid)
+    {
+        if (pid <= 0) return;
+        for (int i = 0; i < 100; i++) {
+            if (waitpid(pid, nullptr, WNOHANG) != 0) return;
+            std::this_thread::sleep_for(EXIT_GRACE / 100);
+        }
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+
+    Loop::Loop(const Options &opts) : opts_(opts)
+    {
+#if defined(__linux__)
+        poll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (poll_fd_ < 0) throw std::runtime_error("could not create the epoll instance");
+#endif
+        for (size_t i = 0; i < opts_.engines + opts_.spares; i++) Spawn(i >= opts_.engines);
+    }
+
+    void Loop::Spawn(bool spare)
+    {
+        auto s = std::make_unique<Session>();
+        s->spare = spare;
+        {
+            // the engine inherits the placement, this thread gets its own back.
+            std::unique_ptr<Affinity::Scope> pin;
+            if (!opts_.placements.empty())
+                pin = std::make_unique<Affinity::Scope>(opts_.placements[spawned_++ % opts_.placements.size()]);
+            s->pid = s_spawn(opts_.argv, s->fd);
+        }
+        if (s->pid < 0) {
+            s->state = Session::State::Dead;
+            sessions_.push_back(std::move(s));
+            return;
+        }
+#if defined(__linux__)
+        epoll_event ev {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = s.get();
+        epoll_ctl(poll_fd_, EPOLL_CTL_ADD, s->fd, &ev);
+#endif
+        sessions_.push_back(std::move(s));
+        Send(*sessions_.back(), "uci\n");
+    }
+
+    Loop::~Loop()
+    {
+        for (auto& s : sessions_) {
+            if (s->fd < 0) continue;
+            const char quit[] = "stop\nquit\n";
+            (void)!send(s->fd, quit, sizeof(quit) - 1, SEND_FLAGS);
+            close(s->fd);
+            s->fd = -1;
+        }
+        // every engine got its quit before we wait for the first one.
+        for (auto& s : sessions_) s_reap(s->pid);
+        for (const auto& [pid, since] : exiting_) s_reap(pid);
+        if (poll_fd_ >= 0) close(poll_fd_);
+    }
+
+    size_t Loop::alive() const
+    {
+        size_t n = 0;
+        for (const auto& s : sessions_) n += !s->spare && s->state != Session::State::Dead;
+        return n;
+    }
+
+    size_t Loop::ready() const
+    {
+        size_t n = 0;
+        for (const auto& s : sessions_)
+            n += !s->spare && (s->state == Session::State::Idle || s->state == Session::State::Searching);
+        return n;
+    }
+
+    size_t Loop::spares() const
+    {
+        size_t n = 0;
+        for (const auto& s : sessions_) n += s->spare && s->state != Session::State::Dead;
+        return n;
+    }
+
+    void Loop::Submit(Search search)
+    {
+        queue_.push_back(std::move(search));
+    }
+
+    void Loop::Send(Session &s, const std::string &commands)
+    {
+        std::string_view rest = commands;
+        while (!rest.empty() && s.fd >= 0) {
+            const ssize_t n = send(s.fd, rest.data(), rest.size(), SEND_FLAGS);
+            if (n > 0) {
+                rest.remove_prefix(size_t(n));
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                // the engine is not reading: commands are short, this is rare and short.
+                pollfd p {s.fd, POLLOUT, 0};
+                ::poll(&p, 1, 100);
+            } else {
+                Close(s, "engine exited");
+            }
+        }
+    }
+
+    void Loop::Close(Session &s, const std::string &error)
+    {
+        if (s.state == Session::State::Dead) return;
+        const bool searching = s.state == Session::State::Searching;
+        s.state = Session::State::Dead;
+        if (s.fd >= 0) {
+#if defined(__linux__)
+            epoll_ctl(poll_fd_, EPOLL_CTL_DEL, s.fd, nullptr);
+#endif
+            close(s.fd);
+            s.fd = -1;
+        }
+        // never waited for here: every other engine would wait too. See Reap().
+        if (s.pid > 0 && waitpid(s.pid, nullptr, WNOHANG) == 0) exiting_.emplace_back(s.pid, std::chrono::steady_clock::now());
+        s.pid = -1;
+
+        // a spare takes its place, the one ready first if any. A new spare is started (by the next Poll(),
+        // we can be iterating over the engines) only if this one did search: an engine that exits as it
+        // starts is not started again and again.
+        Session *heir = nullptr;
+        if (!s.spare) {
+            auto live = [](const auto &o) { return o->spare && o->state != Session::State::Dead; };
+            auto spare = std::find_if(sessions_.begin(), sessions_.end(), [&](const auto &o) { return live(o) && o->state == Session::State::Idle; });
+            if (spare == sessions_.end()) spare = std::find_if(sessions_.begin(), sessions_.end(), live);
+            if (spare != sessions_.end()) {
+                heir = spare->get();
+                heir->spare = false;
+                replaced_++;
+                refill_ += s.searches > 0;
+            }
+        }
+
+        // the groups of the engine go to the spare, or to the next engine that runs their searches.
+        for (auto it = owners_.begin(); it != owners_.end(); ) {
+            if (it->second != &s) ++it;
+            else if (heir) (it++)->second = heir;
+            else it = owners_.erase(it);
+        }
+
+        // with a spare in its place the search is run again, before the others. Once only: a search that
+        // takes a second engine down fails, its position is more likely to blame than the engine.
+        if (searching) {
+            running_--;
+            auto search = std::move(s.search);
+            if (heir && !search.retried) {
+                search.retried = true;
+                queue_.push_front(std::move(search));
+                retried_++;
+            } else {
+                Result result {.error = error};
+                search.done(result);
+            }
+        }
+    }
+
+    void Loop::OnLine(Session &s, std::string_view line)
+    {
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+        using State = Session::State;
+        switch (s.state) {
+            case State::Handshake: {
+                if (line != "uciok") return;
+                // the same setup as Engine::Start().
+                std::string commands;
+                for (const auto& [name, value] : opts_.options) commands += "setoption name " + name + " value " + value + "\n";
+                s.state = State::Syncing;
+                Send(s, commands + "ucinewgame\nisready\n");
+                return;
+            }
+            case State::Syncing:
+                if (line == "readyok") s.state = State::Idle;
+                return;
+            case State::Searching:
+                if (line.starts_with("info") && line.find(" score ") != std::string_view::npos) {
+                    s.result.info = line;
+                } else if (line.starts_with("bestmove")) {
+                    auto move = line.substr(std::min<size_t>(9, line.size()));
+                    s.result.bestmove = move.substr(0, move.find(' '));
+                    if (auto at = s.result.info.find(" nodes "); at != std::string::npos)
+                        nodes_ += std::strtoull(s.result.info.c_str() + at + 7, nullptr, 10);
+                    if (auto at = s.result.info.find(" nps "); at != std::string::npos) {
+                        nps_sum_ += std::strtoull(s.result.info.c_str() + at + 5, nullptr, 10);
+                        nps_count_++;
+                    }
+                    completed_++;
+                    s.searches++;
+                    // idle before the callback, which can submit the next search.
+                    s.state = State::Idle;
+                    running_--;
+                    auto search = std::move(s.search);
+                    auto result = std::move(s.result);
+                    search.done(result);
+                }
+                return;
+            case State::Idle:
+            case State::Dead:
+                return;
+        }
+    }
+
+    void Loop::Read(Session &s)
+    {
+        char buf[4096];
+        while (s.fd >= 0) {
+            const ssize_t n = recv(s.fd, buf, sizeof(buf), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            if (n <= 0) {
+                Close(s, "engine exited");
+                return;
+            }
+
+            std::string_view data(buf, size_t(n));
+            for (size_t nl; (nl = data.find('\n')) != std::string_view::npos; data.remove_prefix(nl + 1)) {
+                if (s.partial.empty()) {
+                    OnLine(s, data.substr(0, nl));
+                } else {
+                    s.partial.append(data.substr(0, nl));
+                    auto line = std::move(s.partial);
+                    s.partial.clear();
+                    OnLine(s, line);
+                }
+                if (s.state == Session::State::Dead) return;
+            }
+            s.partial.append(data);
+        }
+    }
+
+    Loop::Session* Loop::Owner(uint64_t group) const
+    {
+        if (!group) return nullptr;
+        auto it = owners_.find(group);
+        if (it == owners_.end() || it->second->state == Session::State::Dead) return nullptr;
+        return it->second;
+    }
+
+    void Loop::Dispatch()
+    {
+        if (!alive()) {
+            while (!queue_.empty()) {
+                auto search = std::move(queue_.front());
+                queue_.pop_front();
+                search.done({.error = "no engine is running"});
+            }
+            return;
+        }
+
+        // every idle engine takes the oldest search of its own groups, then of a group no engine has,
+        // and only then the oldest search of another engine: none stays idle while something is queued.
+        enum class Pass { Own, Unowned, Steal };
+        for (const auto pass : {Pass::Own, Pass::Unowned, Pass::Steal}) {
+            for (auto& s : sessions_) {
+                if (queue_.empty()) return;
+                if (s->spare || s->state != Session::State::Idle) continue;
+
+                auto pick = std::find_if(queue_.begin(), queue_.end(), [&](const Search &search) {
+                    if (pass == Pass::Steal) return true;
+                    const auto owner = Owner(search.group);
+                    return pass == Pass::Own ? owner == s.get() : owner == nullptr;
+                });
+                if (pick == queue_.end()) continue;
+                stolen_ += pass == Pass::Steal;
+
+                s->search = std::move(*pick);
+                queue_.erase(pick);
+                // the first engine of a group keeps it, the engine of a position gets the group of its moves.
+                if (owners_.size() > (1 << 16)) owners_.clear();
+                if (s->search.group) owners_.try_emplace(s->search.group, s.get());
+                if (s->search.key) owners_.try_emplace(s->search.key, s.get());
+
+                s->result = {};
+                s->state = Session::State::Searching;
+                running_++;
+                Send(*s, "position " + s->search.position + "\ngo depth " + std::to_string(s->search.depth) + "\n");
+            }
+        }
+    }
+
+    void Loop::Reap()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        std::erase_if(exiting_, [&](const auto &e) {
+            if (waitpid(e.first, nullptr, WNOHANG) != 0) return true;
+            if (now - e.second < EXIT_GRACE) return false;
+            kill(e.first, SIGKILL);
+            // dead, or about to be: reaped on the next call.
+            return false;
+        });
+    }
+
+    bool Loop::Poll(int timeout_ms)
+    {
+        Reap();
+        for (; refill_; refill_--) Spawn(true);
+        Dispatch();
+        if (!alive()) return true;
+
+#if defined(__linux__)
+        epoll_event events[64];
+        const int n = epoll_wait(poll_fd_, events, 64, timeout_ms);
+        if (n < 0) return errno != EINTR;
+        for (int i = 0; i < n; i++) Read(*static_cast<Session*>(events[i].data.ptr));
+#else
+        std::vector<pollfd> fds;
+        std::vector<Session*> polled;
+        for (auto& s : sessions_) {
+            if (s->fd < 0) continue;
+            fds.push_back({s->fd, POLLIN, 0});
+            polled.push_back(s.get());
+        }
+        const int n = ::poll(fds.data(), nfds_t(fds.size()), timeout_ms);
+        if (n < 0) return errno != EINTR;
+        for (size_t i = 0; i < fds.size(); i++)
+            if (fds[i].revents) Read(*polled[i]);
+#endif
+
+        Dispatch();
+        return true;
+    }
+}
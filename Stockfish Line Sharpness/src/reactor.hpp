@@ -0,0 +1,130 @@
+//
+//  reactor.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef reactor_hpp
+#define reactor_hpp
+
+#include <stdio.h>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+
+#include "affinity.hpp"
+
+// Many engines driven by a single thread. Every engine talks UCI over one socket (its stdin and stdout)
+// watched by epoll (poll where there is no epoll): the lines read are fed to the state machine of
+// their engine, and a queued search is handed to an engine as soon as it is idle. No thread is spent
+// waiting on an engine, a single coordinator keeps all of them busy.
+// Searches are routed to keep the hash tables of the engines warm: a position and its moves go to the
+// same engine, and so does a position searched before as the move of its parent (the next ply of a game
+// or of a line). An idle engine only takes the work of another one when nothing else is queued.
+// "ucinewgame", which clears the hash, is only sent once, when the engine starts.
+// Spare engines are started with the others and kept ready: one takes the place of an engine that exits,
+// without waiting for a new one to load, and runs the search the engine was running again.
+namespace Reactor {
+
+    // The end of a search.
+    struct Result {
+        std::string info {};    // the last "info" line with a score, for Utils::centipawns()
+        std::string bestmove {};
+        std::string error {};   // the engine exited (or could not be started) during the search
+    };
+
+    struct Search {
+        std::string position {};    // the arguments of the position command: "fen <fen> [moves <move>...]"
+        int depth {15};
+        std::function<void(const Result&)> done {};   // called from Poll()
+        // Routing, 0 when unknown: the key of the position searched, and the one of the position it belongs
+        // to (the parent for a move, itself otherwise). See Loop::Dispatch().
+        uint64_t key {};
+        uint64_t group {};
+        bool retried {};        // set by the loop: the search is run again, its first engine exited
+    };
+
+    struct Options {
+        std::vector<std::string> argv {};                               // the engine and its arguments
+        size_t engines {1};
+        size_t spares {};                                               // standby engines, see Loop::Close()
+        std::vector<std::pair<std::string, std::string>> options {};    // setoption name/value, sent once after uciok
+        std::vector<Affinity::Placement> placements {};                 // of the engines, then the spares, in turn
+    };
+
+    class Loop {
+    public:
+        // Starts the engines and the spares. An engine that cannot be started exits right away: see alive().
+        explicit Loop(const Options &opts);
+        // Stops the searches and quits the engines.
+        ~Loop();
+
+        Loop(const Loop&) = delete;
+        Loop& operator=(const Loop&) = delete;
+
+        // Queues a search, started by Poll() on the first idle engine. If no engine is alive,
+        // the search fails at the next Poll(). A search whose engine exits fails, unless a spare takes
+        // the place of the engine: then it is run again, once.
+        void Submit(Search search);
+
+        // Waits up to timeout_ms (-1: until something happens) for the engines, handles what they wrote
+        // and starts the queued searches on the idle ones. Returns false if a signal interrupted the wait.
+        bool Poll(int timeout_ms = -1);
+
+        // Searches queued or running.
+        size_t pending() const { return queue_.size() + running_; }
+        // The engines searching (the spares are not), the ones alive, and the spares alive.
+        size_t engines() const { return opts_.engines; }
+        size_t alive() const;
+        size_t spares() const;
+        // The engines alive that are done with their handshake.
+        size_t ready() const;
+        // Engines that exited and were replaced by a spare.
+        size_t replaced() const { return replaced_; }
+        // Searches run again after their engine exited.
+        size_t retried() const { return retried_; }
+
+        // Searches completed, the nodes they searched (from their last "info ... nodes" line), and the
+        // ones not run on the engine of their group.
+        size_t completed() const { return completed_; }
+        uint64_t nodes() const { return nodes_; }
+        // The mean of the speeds the engines reported ("info ... nps"), 0 if none did.
+        uint64_t nps() const { return nps_count_ ? nps_sum_ / nps_count_ : 0; }
+        size_t stolen() const { return stolen_; }
+
+    private:
+        struct Session;
+
+        void Spawn(bool spare);
+        void Read(Session &s);
+        void OnLine(Session &s, std::string_view line);
+        void Send(Session &s, const std::string &commands);
+        void Close(Session &s, const std::string &error);
+        void Reap();
+        void Dispatch();
+
+        Session* Owner(uint64_t group) const;
+
+        Options opts_;
+        int poll_fd_ {-1};
+        std::vector<std::unique_ptr<Session>> sessions_;
+        std::deque<Search> queue_;
+        size_t running_ {};
+        std::unordered_map<uint64_t, Session*> owners_;     // the engine of a group, or of a position
+        size_t completed_ {}, stolen_ {};
+        size_t replaced_ {}, refill_ {};                    // spares to start at the next Poll()
+        size_t retried_ {};
+        uint64_t nodes_ {};
+        uint64_t nps_sum_ {}, nps_count_ {};
+        size_t spawned_ {};
+        // Engines closed that had not exited yet, and when: Poll() reaps them, or kills them after a second.
+        std::vector<std::pair<pid_t, std::chrono::steady_clock::time_point>> exiting_;
+    };
+}
+
+#endif /* reactor_hpp */
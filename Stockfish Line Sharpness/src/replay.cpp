@@ -0,0 +1,117 @@
+//
+//  replay.cpp
+//  Stockfish Line Sharpness
+//
+
+#include "replay.hpp"
+#include "notation.hpp"
+#include "position.hpp"
+#include "fen.hpp"
+
+namespace Replay {
+
+    static inline bool s_is_space(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+    static inline bool s_is_digit(char c) { return c >= '0' && c <= '9'; }
+
+    static size_t s_skip_past(std::string_view text, size_t pos, char c)
+    {
+        auto found = text.find(c, pos);
+        return found == std::string_view::npos ? text.size() : found + 1;
+    }
+
+    MovetextCursor::MovetextCursor(std::string_view game) : text_(game)
+    {
+        // the tag section: [Name "value"] pairs, the value of FEN is kept as a view.
+        while (pos_ < text_.size()) {
+            char c = text_[pos_];
+            if (s_is_space(c)) { pos_++; continue; }
+            if (c == '%') { pos_ = s_skip_past(text_, pos_, '\n'); continue; }
+            if (c != '[') break;
+
+            size_t name = ++pos_;
+            while (pos_ < text_.size() && !s_is_space(text_[pos_]) && text_[pos_] != '"' && text_[pos_] != ']') pos_++;
+            bool is_fen = text_.substr(name, pos_ - name) == "FEN";
+            while (pos_ < text_.size() && s_is_space(text_[pos_])) pos_++;
+
+            if (pos_ < text_.size() && text_[pos_] == '"') {
+                size_t value = ++pos_;
+                while (pos_ < text_.size() && text_[pos_] != '"') pos_ += text_[pos_] == '\\' ? 2 : 1;
+                pos_ = std::min(pos_, text_.size());
+                if (is_fen) fen_ = text_.substr(value, pos_ - value);
+            }
+            pos_ = s_skip_past(text_, pos_, ']');
+        }
+    }
+
+    bool MovetextCursor::Next(std::string_view &san)
+    {
+        static constexpr std::string_view delimiters = "{}();[$";
+
+        while (pos_ < text_.size()) {
+            char c = text_[pos_];
+            if (s_is_space(c) || c == ')') { pos_++; continue; }
+            if (c == '{') { pos_ = s_skip_past(text_, pos_, '}'); continue; }
+            if (c == ';' || c == '%') { pos_ = s_skip_past(text_, pos_, '\n'); continue; }
+            if (c == '(') {
+                // comments can contain parentheses.
+                for (int depth = 1; depth && ++pos_ < text_.size(); ) {
+                    c = text_[pos_];
+                    if (c == '(') depth++;
+                    else if (c == ')') depth--;
+                    else if (c == '{') pos_ = s_skip_past(text_, pos_, '}') - 1;
+                    else if (c == ';') pos_ = s_skip_past(text_, pos_, '\n') - 1;
+                }
+                pos_++;
+                continue;
+            }
+            // a tag means the result was missing and the next game started.
+            if (c == '[' || c == '*') return false;
+
+            size_t start = pos_;
+            if (c == '$') pos_++;
+            while (pos_ < text_.size() && !s_is_space(text_[pos_]) && delimiters.find(text_[pos_]) == std::string_view::npos)
+                pos_++;
+            if (c == '$') continue;
+
+            auto token = text_.substr(start, pos_ - start);
+
+            // move numbers ("12.", "12...Nf6"), the results, and castling written with zeros.
+            size_t digits = 0;
+            while (digits < token.size() && s_is_digit(token[digits])) digits++;
+            if (digits) {
+                if (digits < token.size() && token[digits] == '.') {
+                    while (digits < token.size() && token[digits] == '.') digits++;
+                    token.remove_prefix(digits);
+                } else if (token == "1-0" || token == "0-1" || token == "1/2-1/2") {
+                    return false;
+                } else if (digits == token.size()) continue;
+            }
+            if (token.empty()) continue;
+
+            san = token;
+            return true;
+        }
+        return false;
+    }
+
+    Replayer::Replayer()
+    {
+        // makes sure the lookup tables are initialized.
+        static const ::Position tables {};
+        Reset();
+    }
+
+    bool Replayer::Reset(std::string_view fen)
+    {
+        ply_ = 0;
+        return parseFEN(fen, pos_, &states_[0]) == FEN_OK;
+    }
+
+    bool Replayer::Play(std::string_view san)
+    {
+        Stockfish::Move m = Notation::from_trusted_san(pos_, san);
+        if (m == Stockfish::MOVE_NONE) return false;
+        Play(m);
+        return true;
+    }
+}
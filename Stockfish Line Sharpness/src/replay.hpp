@@ -0,0 +1,85 @@
+//
+//  replay.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef replay_hpp
+#define replay_hpp
+
+#include <stdio.h>
+#include <array>
+#include <string_view>
+
+#include "mini_stock/position.h"
+#include "pgn.hpp"
+
+// Fast replay of games that are known to be legal (dedupe, position extraction over big databases).
+// Moves are decoded with Notation::from_trusted_san() and played on a fixed ring of states, the
+// movetext is read in place: no Pgn::Game, no FEN validation beyond parseFEN(), no allocations.
+// Use Pgn::Reader and ::Position for input that still needs to be validated.
+namespace Replay {
+
+    // Walks the main line of a PGN game record (for instance as split by Ingest): tags are skipped
+    // but for the FEN, comments, NAGs, move numbers and variations are skipped too.
+    class MovetextCursor {
+    public:
+        explicit MovetextCursor(std::string_view game);
+
+        // The value of the FEN tag, empty if there is none.
+        std::string_view Fen() const { return fen_; }
+
+        // The next SAN of the main line, false at the result or at the end of the game.
+        bool Next(std::string_view &san);
+
+    private:
+        std::string_view text_;
+        std::string_view fen_;
+        size_t pos_ {};
+    };
+
+    class Replayer {
+    public:
+        Replayer();
+
+        // The states point to each other, the replayer cannot be moved.
+        Replayer(const Replayer&) = delete;
+        Replayer& operator=(const Replayer&) = delete;
+
+        // Returns false if the FEN is not valid.
+        bool Reset(std::string_view fen = Pgn::StartFen);
+
+        // Returns false if the SAN does not match any move (the position is left as it was).
+        bool Play(std::string_view san);
+        void Play(Stockfish::Move m) { pos_.do_move(m, states_[++ply_ % MAX_STATES]); }
+
+        const Stockfish::Position& position() const { return pos_; }
+        // Plies played since the last Reset().
+        int ply() const { return ply_; }
+
+    private:
+        // Only the last rule50 states are looked at (repetitions), and the 75 moves rule keeps rule50
+        // within 150 plies in a legal game: older states can be overwritten.
+        static constexpr int MAX_STATES = 256;
+
+        Stockfish::Position pos_;
+        std::array<Stockfish::StateInfo, MAX_STATES> states_;
+        int ply_ {};
+    };
+
+    // Replays a game record calling f(position) after every ply. Returns the number of plies
+    // played, or -1 if the FEN is not valid or a move could not be decoded.
+    template<typename F>
+    int replay_game(Replayer &replayer, std::string_view game, F && f)
+    {
+        MovetextCursor cursor(game);
+        if (!replayer.Reset(cursor.Fen().empty() ? std::string_view(Pgn::StartFen) : cursor.Fen())) return -1;
+
+        for (std::string_view san; cursor.Next(san); ) {
+            if (!replayer.Play(san)) return -1;
+            f(replayer.position());
+        }
+        return replayer.ply();
+    }
+}
+
+#endif /* replay_hpp */
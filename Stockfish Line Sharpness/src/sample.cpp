@@ -0,0 +1,288 @@
+//
+//  sample.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <map>
+
+#include "sample.hpp"
+#include "ingest.hpp"
+#include "pgn.hpp"
+#include "replay.hpp"
+
+namespace Sample {
+    using namespace Stockfish;
+
+    // The non pawn material of Stockfish's game phase: a full middlegame above, a full endgame below.
+    static constexpr Value MIDGAME_LIMIT = Value(15258);
+    static constexpr Value ENDGAME_LIMIT = Value(3915);
+
+    static uint64_t s_splitmix(uint64_t x)
+    {
+        x += 0x9e3779b97f4a7c15;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+        return x ^ (x >> 31);
+    }
+
+    bool ParseStrata(std::string_view spec, Options &opts)
+    {
+        if (spec == "none") opts.strata = Strata::None;
+        else if (spec == "phase") opts.strata = Strata::Phase;
+        else if (spec == "material") opts.strata = Strata::Material;
+        else if (spec.substr(0, 3) == "ply" && (spec.size() == 3 || spec[3] == '/')) {
+            opts.strata = Strata::Ply;
+            if (spec.size() == 3) return true;
+            auto width = spec.substr(4);
+            if (width.empty() || width.size() > 4 || !std::all_of(width.begin(), width.end(), ::isdigit)) return false;
+            opts.ply_width = std::stoi(std::string(width));
+            return opts.ply_width > 0;
+        }
+        else return false;
+        return true;
+    }
+
+    Reservoir::Reservoir(size_t capacity, uint64_t seed)
+        : capacity_(capacity), state_(s_splitmix(seed)) {}
+
+    // In (0, 1): the logarithms below never see 0.
+    double Reservoir::Uniform()
+    {
+        state_ = s_splitmix(state_);
+        return (double(state_ >> 11) + 0.5) / double(uint64_t(1) << 53);
+    }
+
+    // The number of items to pass over is geometric, of parameter w.
+    void Reservoir::Skip()
+    {
+        w_ *= std::exp(std::log(Uniform()) / double(capacity_));
+        const double skip = std::floor(std::log(Uniform()) / std::log1p(-w_));
+        next_ = skip < double(std::numeric_limits<uint64_t>::max() - seen_) ? seen_ + uint64_t(skip)
+                                                                              : std::numeric_limits<uint64_t>::max();
+    }
+
+    size_t Reservoir::Offer()
+    {
+        const uint64_t i = seen_++;
+        if (i < capacity_) {
+            if (seen_ == capacity_) {
+                w_ = 1;
+                Skip();
+            }
+            return size_t(i);
+        }
+        if (i < next_ || capacity_ == 0) return NONE;
+        state_ = s_splitmix(state_);
+        const size_t slot = size_t(state_ % capacity_);
+        Skip();
+        return slot;
+    }
+
+    // "KRPPvKR": the pieces of each side, strongest first.
+    static std::string s_material(const Position &pos)
+    {
+        std::string name;
+        for (const Color c : {WHITE, BLACK}) {
+            if (c == BLACK) name += 'v';
+            name += 'K';
+            for (const PieceType pt : {QUEEN, ROOK, BISHOP, KNIGHT, PAWN})
+                name.append(size_t(std::popcount(pos.pieces(c, pt))), " PNBRQ"[pt]);
+        }
+        return name;
+    }
+
+    // The stratum of pos, and its name when it is the first position of the stratum.
+    static Key s_stratum(const Position &pos, const Options &opts, std::string *name)
+    {
+        switch (opts.strata) {
+            case Strata::None:
+                return 0;
+            case Strata::Phase: {
+                const Value npm = pos.non_pawn_material();
+                const int phase = npm >= MIDGAME_LIMIT ? 0 : npm > ENDGAME_LIMIT ? 1 : 2;
+                if (name) *name = phase == 0 ? "opening" : phase == 1 ? "middlegame" : "endgame";
+                return Key(phase);
+            }
+            case Strata::Material:
+                if (name) *name = s_material(pos);
+                return pos.material_key();
+            case Strata::Ply: {
+                const int first = pos.game_ply() / opts.ply_width * opts.ply_width;
+                if (name) {
+                    // zero padded, the strata are written in name order.
+                    char buf[32];
+                    std::snprintf(buf, sizeof(buf), "%04d-%04d", first, first + opts.ply_width - 1);
+                    *name = buf;
+                }
+                return Key(first);
+            }
+        }
+        return 0;
+    }
+
+    Sampler::Sampler(const Options &opts) : opts_(opts) {}
+
+    std::string* Sampler::Add(const Position &pos)
+    {
+        const uint64_t index = seen_++;
+        const Key key = s_stratum(pos, opts_, nullptr);
+        auto it = strata_.find(key);
+        if (it == strata_.end()) {
+            // the seed of a stratum does not depend on when it is first seen.
+            std::string name;
+            s_stratum(pos, opts_, &name);
+            it = strata_.emplace(key, Stratum {std::move(name), Reservoir(opts_.size, opts_.seed ^ s_splitmix(key)), {}}).first;
+        }
+
+        Stratum &s = it->second;
+        const size_t slot = s.reservoir.Offer();
+        if (slot == Reservoir::NONE) return nullptr;
+        if (slot == s.kept.size()) s.kept.emplace_back();
+        s.kept[slot].first = index;
+        s.kept[slot].second.clear();
+        return &s.kept[slot].second;
+    }
+
+    void Sampler::Drain(const std::function<void(const Entry&)> &f) const
+    {
+        std::map<std::string_view, const Stratum*> by_name;
+        for (const auto& [key, s] : strata_) by_name.emplace(s.name, &s);
+
+        std::vector<const std::pair<uint64_t, std::string>*> kept;
+        for (const auto& [name, s] : by_name) {
+            kept.clear();
+            for (const auto& k : s->kept) kept.push_back(&k);
+            std::sort(kept.begin(), kept.end(), [](auto a, auto b) { return a->first < b->first; });
+            const double weight = double(s->reservoir.seen()) / double(s->kept.size());
+            for (const auto k : kept) f({k->second, name, weight});
+        }
+    }
+
+    // The EPD of pos, with its counters as the hmvc and fmvn operations.
+    static void s_epd(const Position &pos, std::string &line)
+    {
+        line = pos.fen();
+        auto fullmove = line.rfind(' ');
+        auto halfmove = line.rfind(' ', fullmove - 1);
+        line = line.substr(0, halfmove) + " hmvc " + line.substr(halfmove + 1, fullmove - halfmove - 1) + "; fmvn "
+             + line.substr(fullmove + 1) + ";";
+    }
+
+    static void s_add_game(Sampler &sampler, Replay::Replayer &replayer)
+    {
+        if (auto line = sampler.Add(replayer.position())) s_epd(replayer.position(), *line);
+    }
+
+    static bool s_is_digits(std::string_view s)
+    {
+        return !s.empty() && std::all_of(s.begin(), s.end(), ::isdigit);
+    }
+
+    // An EPD or FEN line: the four fields of the position are kept as they are, the counters of a FEN
+    // become operations so that the other operations can follow them.
+    static void s_add_line(Sampler &sampler, Replay::Replayer &replayer, std::string_view line, Stats &stats)
+    {
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r' || line.back() == ' ' || line.back() == '\t'))
+            line.remove_suffix(1);
+        line.remove_prefix(std::min(line.find_first_not_of(" \t"), line.size()));
+        if (line.empty() || line.front() == '#') return;
+        stats.records++;
+
+        // the next token from pos, pos is left past it.
+        auto token = [&](size_t &pos) {
+            pos = std::min(line.find_first_not_of(" \t", pos), line.size());
+            size_t end = std::min(line.find_first_of(" \t", pos), line.size());
+            auto t = line.substr(pos, end - pos);
+            pos = end;
+            return t;
+        };
+        size_t pos = 0;
+        for (int i = 0; i < 4; i++) token(pos);
+        const size_t fields = pos;
+        size_t after = pos;
+        auto halfmove = token(after), fullmove = token(after);
+        const bool counters = s_is_digits(halfmove) && s_is_digits(fullmove);
+
+        std::string fen(line.substr(0, fields));
+        fen += counters ? " " + std::string(halfmove) + " " + std::string(fullmove) : std::string(" 0 1");
+        if (!replayer.Reset(fen)) { stats.rejected++; return; }
+
+        if (auto kept = sampler.Add(replayer.position())) {
+            auto ops = line.substr(counters ? after : fields);
+            ops.remove_prefix(std::min(ops.find_first_not_of(" \t"), ops.size()));
+            kept->assign(line.substr(0, fields));
+            if (counters) *kept += " hmvc " + std::string(halfmove) + "; fmvn " + std::string(fullmove) + ";";
+            if (!ops.empty()) *kept += ' ';
+            *kept += ops;
+        }
+    }
+
+    Stats AddInput(Sampler &sampler, std::istream &is)
+    {
+        Stats stats {};
+        Replay::Replayer replayer;
+        is >> std::ws;
+        stats.pgn = is.peek() == '[';
+        if (!stats.pgn) {
+            for (std::string line; std::getline(is, line); ) s_add_line(sampler, replayer, line, stats);
+            return stats;
+        }
+
+        Pgn::Reader reader(is);
+        Pgn::Game game;
+        while (reader.Next(game)) {
+            stats.records++;
+            if (!replayer.Reset(game.InitialFen())) { stats.rejected++; continue; }
+            s_add_game(sampler, replayer);
+            for (const auto& ply : game.plies) {
+                if (!replayer.Play(ply.san)) { stats.rejected++; break; }
+                s_add_game(sampler, replayer);
+            }
+        }
+        return stats;
+    }
+
+    Stats AddInput(Sampler &sampler, std::string_view text)
+    {
+        Stats stats {};
+        Replay::Replayer replayer;
+        auto first = text.find_first_not_of(" \t\r\n");
+        stats.pgn = first != std::string_view::npos && text[first] == '[';
+        if (!stats.pgn) {
+            Ingest::for_each_record(text, Ingest::Format::Lines, [&](std::string_view line) {
+                s_add_line(sampler, replayer, line, stats);
+            });
+            return stats;
+        }
+
+        Ingest::for_each_record(text, Ingest::Format::Pgn, [&](std::string_view record) {
+            stats.records++;
+            Replay::MovetextCursor cursor(record);
+            if (!replayer.Reset(cursor.Fen().empty() ? std::string_view(Pgn::StartFen) : cursor.Fen())) {
+                stats.rejected++;
+                return;
+            }
+            s_add_game(sampler, replayer);
+            for (std::string_view san; cursor.Next(san); ) {
+                if (!replayer.Play(san)) { stats.rejected++; break; }
+                s_add_game(sampler, replayer);
+            }
+        });
+        return stats;
+    }
+
+    void WriteEntry(std::ostream &os, const Entry &e)
+    {
+        char weight[32];
+        std::snprintf(weight, sizeof(weight), "%.10g", e.weight);
+        os << e.line;
+        if (!e.stratum.empty()) os << " stratum \"" << e.stratum << "\";";
+        os << " weight \"" << weight << "\";\n";
+    }
+}
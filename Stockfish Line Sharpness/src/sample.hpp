@@ -0,0 +1,127 @@
+//
+//  sample.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef sample_hpp
+#define sample_hpp
+
+#include <stdio.h>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "mini_stock/position.h"
+
+// Draws a fixed size sample of the positions of a database in a single pass, so that the engine cost of a
+// run is bounded whatever the size of the input. Every position has the same chance to be kept (reservoir
+// sampling), within its stratum when the positions are stratified by game phase, material signature or ply.
+// Every kept position carries its weight, the number of positions of its stratum it stands for: weighted
+// means over the sample are unbiased estimates of the means over the whole database.
+namespace Sample {
+
+    enum class Strata { None, Phase, Material, Ply };
+
+    struct Options {
+        size_t size {1000};         // positions kept, per stratum when stratified
+        Strata strata {Strata::None};
+        int ply_width {10};         // plies per stratum with Strata::Ply
+        uint64_t seed {1};          // the same seed and input always give the same sample
+    };
+
+    // Parses --strata: "none", "phase", "material", "ply" or "ply/<width>".
+    bool ParseStrata(std::string_view spec, Options &opts);
+
+    // Reservoir sampling with geometric skips (Li, "Reservoir-Sampling Algorithms of Time Complexity
+    // O(n(1 + log(N/n)))", algorithm L): the random numbers drawn are about the number of items kept,
+    // not the number of items seen.
+    class Reservoir {
+    public:
+        static constexpr size_t NONE = size_t(-1);
+
+        Reservoir(size_t capacity, uint64_t seed);
+
+        // Offers the next item: the slot it replaces (or fills), NONE if it is not kept.
+        size_t Offer();
+
+        uint64_t seen() const { return seen_; }
+        size_t size() const { return seen_ < capacity_ ? size_t(seen_) : capacity_; }
+
+    private:
+        double Uniform();
+        void Skip();
+
+        size_t capacity_;
+        uint64_t state_;
+        uint64_t seen_ {};
+        uint64_t next_ {};          // index of the next item kept, past the first capacity_ ones
+        double w_ {};
+    };
+
+    struct Entry {
+        std::string_view line;      // the EPD line of the position
+        std::string_view stratum;   // empty with Strata::None
+        double weight {};           // positions of the stratum seen per position kept
+    };
+
+    class Sampler {
+    public:
+        explicit Sampler(const Options &opts = {});
+
+        // Offers pos: if it is kept, the EPD line to fill in (see WriteEntry()), nullptr otherwise.
+        // The line is only built for the positions kept.
+        std::string* Add(const Stockfish::Position &pos);
+
+        // Calls f(entry) for every position kept, stratum by stratum in name order, in the order of
+        // the input within a stratum.
+        void Drain(const std::function<void(const Entry&)> &f) const;
+
+        uint64_t seen() const { return seen_; }
+        size_t strata() const { return strata_.size(); }
+
+    private:
+        struct Stratum {
+            std::string name;
+            Reservoir reservoir;
+            std::vector<std::pair<uint64_t, std::string>> kept;     // index in the input, line
+        };
+
+        Options opts_;
+        std::unordered_map<Stockfish::Key, Stratum> strata_;
+        uint64_t seen_ {};
+    };
+
+    struct Stats {
+        size_t records {};          // games of a PGN database, lines of an EPD or FEN file
+        size_t rejected {};         // games with a FEN or a move that could not be replayed, bad lines
+        bool pgn {};
+    };
+
+    // Offers every position of the input, a PGN database (it starts with a tag) or one EPD or FEN per line.
+    // Games are replayed with the trusted path (see Replay), a game with a bad move is counted up to that move.
+    Stats AddInput(Sampler &sampler, std::istream &is);
+    Stats AddInput(Sampler &sampler, std::string_view text);
+
+    // The line of the entry, then its stratum and weight as operations: "stratum \"endgame\"; weight \"812.5\";".
+    void WriteEntry(std::ostream &os, const Entry &e);
+
+    // Samples the positions of input and writes the ones kept to out. Returns the number written.
+    template<typename Input>
+    size_t Run(Input &&input, std::ostream &out, std::ostream &log = std::cerr, const Options &opts = {})
+    {
+        Sampler sampler(opts);
+        auto stats = AddInput(sampler, input);
+        size_t kept {};
+        sampler.Drain([&](const Entry &e) { WriteEntry(out, e); kept++; });
+        out.flush();
+        log << "[sample] " << stats.records << (stats.pgn ? " games (" : " lines (") << stats.rejected << " rejected), "
+        << sampler.seen() << " positions, " << kept << " kept in " << sampler.strata() << " strata" << std::endl;
+        return kept;
+    }
+}
+
+#endif /* sample_hpp */
@@ -9,6 +9,7 @@
 #include <vector>
 #include <iostream>
 #include <numeric>
+#include <memory>
 
 #include "sharpness.hpp"
 #include "utils.hpp"
@@ -18,6 +19,7 @@
 
 static const auto WINC_THRESHOLD = std::abs(Utils::lc0_cp_to_win(INACCURACY_THRESHOLD*100));
 static const auto WINC_BLUNDER_THRESHOLD = std::abs(Utils::lc0_cp_to_win(BLUNDER_THRESHOLD*100));
+static const auto WINC_MISTAKE_THRESHOLD = std::abs(Utils::lc0_cp_to_win(MISTAKE_THRESHOLD*100));
 
 namespace Sharpness {
     
@@ -37,7 +39,15 @@ namespace Sharpness {
             i++;
             if ( i >= sorted_perm.size() - 1) break;
         }
-        return tv/(count);
+        // no move is close to the base evaluation (it can happen when the depths disagree).
+        return count ? tv/count : 0;
+    }
+    
+    const char* Verdict(double loss)
+    {
+        if (loss < WINC_THRESHOLD) return "good";
+        if (loss < WINC_MISTAKE_THRESHOLD) return "inaccuracy";
+        return "bad";
     }
     
     double
@@ -99,6 +109,29 @@ namespace Sharpness {
     }
     
     
+    // The moves of a generated line are printed as they are played.
+    static void s_play_sharpest(std::vector<std::string> &line, Position &pos, int i, Stockfish::Move sharpest_move)
+    {
+        line.push_back(Utils::to_alg(pos, sharpest_move));
+        if (pos.side_to_move() == Stockfish::BLACK)
+            std::cout << i << ". ... " << line.back() << std::endl;
+        else
+            std::cout << i << ". " << line.back() << " ";
+        pos.DoMove(sharpest_move);
+    }
+    
+    static void s_play_response(std::vector<std::string> &line, Position &pos, int i, const std::string &best_response)
+    {
+        line.push_back(Utils::long_to_alg(pos, best_response));
+        
+        if (pos.side_to_move() == Stockfish::WHITE)
+            std::cout << i+1 << ". " << line.back() << "\n";
+        else
+            std::cout << line.back() << std::endl;
+
+        pos.DoMove(Utils::long_alg_to_move(pos, best_response));
+    }
+    
     // TODO: IDEA: Sharp Line generation:
     // Starting from a position, select the move with highest sharpness for the opposing color, and the best response for the opposing color.
     // i.e. white to play, choose the move that is sharpest for black, and then pick the best black response for that move, go on until N moves are generated.
@@ -137,27 +170,99 @@ namespace Sharpness {
                 }
             }
 
-            line.push_back(Utils::to_alg(pos, sharpest_move));
-            if (pos.side_to_move() == Stockfish::BLACK)
-                std::cout << i << ". ... " << line.back() << std::endl;
-            else
-                std::cout << i << ". " << line.back() << " ";
-            pos.DoMove(sharpest_move);
+            s_play_sharpest(line, pos, i, sharpest_move);
             
             // calculate the response
-            auto best_response = engine.GetBestMove(pos);
-            line.push_back(Utils::long_to_alg(pos, best_response));
-            
-            if (pos.side_to_move() == Stockfish::WHITE)
-                std::cout << i+1 << ". " << line.back() << "\n";
-            else
-                std::cout << line.back() << std::endl;
-
-            pos.DoMove(Utils::long_alg_to_move(pos, best_response));
+            s_play_response(line, pos, i, engine.GetBestMove(pos));
         }
         std::cout << '\n';
         
         return line;
     }
-
+    
+    Coro::Task<double>
+    ComputePosition(Coro::Engine &engine, Position &pos)
+    {
+        // the position and all its moves are searched together.
+        std::vector<Coro::Task<double>> searches;
+        searches.push_back(engine.Eval(pos));
+        for (const auto m : pos.GetMoves()) searches.push_back(engine.EvalMove(m, pos));
+        auto evals = co_await Coro::All(std::move(searches));
+        
+        double base_eval = evals.front();
+        evals.erase(evals.begin());
+        co_return TotalVar(evals, base_eval, pos.side_to_move());
+    }
+    
+    Coro::Task<double> Complexity(Coro::Engine &engine, Position &pos, int max_depth)
+    {
+        assert(max_depth > 2);
+        double complexity {};
+        std::string old_best_move {};
+        
+        auto moves = pos.GetMoves();
+        std::vector<int> eval_perm(moves.size());
+        std::iota(eval_perm.begin(), eval_perm.end(), 0);
+        int change_of_mind {};
+        
+        // the depths follow each other: whether a depth evaluates the moves depends on the one before.
+        for(int d = 2; d < max_depth; d++) {
+            auto at_depth = engine.At(d);
+            auto best_move = co_await at_depth.GetBestMove(pos);
+            if (best_move != old_best_move) {
+                change_of_mind++;
+                auto evals = co_await at_depth.EvalMoves(moves, pos);
+                Utils::sort_evals_perm(eval_perm, evals, pos.side_to_move());
+                auto delta = std::abs(evals[eval_perm[0]] - evals[eval_perm[1]]);
+                complexity += delta;
+            }
+            old_best_move = best_move;
+        }
+        
+        co_return change_of_mind;
+    }
+    
+    Coro::Task<std::vector<std::string>>
+    GenerateLine(size_t line_length, Position &pos, Coro::Engine &engine)
+    {
+        std::vector<std::string> line;
+        
+        for (size_t i = 0; i < line_length; i++) {
+            auto moves = pos.GetMoves();
+            auto base_eval = co_await engine.Eval(pos);
+            auto move_evals = co_await engine.EvalMoves(moves, pos);
+            
+            // the moves that do not throw the game (see above), each one analysed in a position of its own.
+            std::vector<Stockfish::Move> candidates;
+            std::vector<double> deltas;
+            std::vector<std::unique_ptr<Position>> children;
+            std::vector<Coro::Task<double>> analyses;
+            for (size_t idx {}; const auto m : moves) {
+                auto delta = std::abs(base_eval - move_evals[idx++]);
+                if (delta >= WINC_THRESHOLD) continue;
+                candidates.push_back(m);
+                deltas.push_back(delta);
+                children.push_back(std::make_unique<Position>(pos.fen()));
+                children.back()->DoMove(m);
+                analyses.push_back(ComputePosition(engine, *children.back()));
+            }
+            auto sharpnesses = co_await Coro::All(std::move(analyses));
+            
+            Stockfish::Move sharpest_move {};
+            double sharpest_move_sharpness { -std::numeric_limits<double>::infinity() };
+            for (size_t idx {}; idx < candidates.size(); idx++) {
+                auto overall_score = sharpnesses[idx] - deltas[idx]*0.5;
+                if (sharpest_move_sharpness < overall_score) {
+                    sharpest_move = candidates[idx];
+                    sharpest_move_sharpness = overall_score;
+                }
+            }
+            
+            s_play_sharpest(line, pos, i, sharpest_move);
+            s_play_response(line, pos, i, co_await engine.GetBestMove(pos));
+        }
+        std::cout << '\n';
+        
+        co_return line;
+    }
 }
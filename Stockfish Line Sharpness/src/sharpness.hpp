@@ -10,17 +10,10 @@
 
 #include <stdio.h>
 #include "stock_wrapper.hpp"
+#include "metrics.hpp"
+#include "coro.hpp"
 
 
-// We want to know what percentage of moves ends up in a overall worse position.
-// we consider a blunder losing 300+ cp, a mistake losing 120-300 cp and inaccuracies 50-120 cp.
-// depending on the ELO, you might consider changing these values.
-// for now lets just put everything under one "bad move umbrella", all the blunders and all the mistakes.
-// inaccuracies are considered neutral, the rest is good moves.
-static constexpr double BLUNDER_THRESHOLD = 3; // blunders
-static constexpr double MISTAKE_THRESHOLD = 1.1; // mistakes (sono scarso dio caro).
-static constexpr double INACCURACY_THRESHOLD = 0.5; // inaccuracy
-
 struct MoveDist {
     double good;
     double bad;
@@ -30,6 +23,8 @@ struct MoveDist {
 namespace Sharpness {
     
     double TotalVar(const std::vector<double> &evals, double base_eval, Stockfish::Color col);
+    // "good", "inaccuracy" or "bad", from the expected score lost by a move (see the thresholds in metrics.hpp).
+    const char* Verdict(double loss);
     double ComputePosition(Engine &engine, Position &pos);
     double ComputeMove(Stockfish::Move m, Engine &engine, Position& pos);
     
@@ -37,5 +32,12 @@ namespace Sharpness {
     std::vector<std::string>
     GenerateLine(size_t line_length, Position& pos, Engine& engine);
     
+    // The same algorithms as coroutines on the engines of a Reactor::Loop (see coro.hpp): the searches of a
+    // position are in flight together, and many positions can be analysed at once. pos must outlive the task.
+    Coro::Task<double> ComputePosition(Coro::Engine &engine, Position &pos);
+    Coro::Task<double> Complexity(Coro::Engine &engine, Position &pos, int max_depth);
+    Coro::Task<std::vector<std::string>>
+    GenerateLine(size_t line_length, Position &pos, Coro::Engine &engine);
+    
 }
 #endif /* sharpness_hpp */
@@ -0,0 +1,345 @@
+//
+//  sketch.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include "sketch.hpp"
+#include "output.hpp"
+
+namespace Sketch {
+
+    static constexpr char MAGIC[8] = {'L', 'S', 'S', 'T', 'A', 'T', 'S', '1'};
+
+    // Lower levels shrink geometrically, down to 2 values.
+    static constexpr double LEVEL_DECAY = 2.0 / 3.0;
+    static constexpr uint32_t MIN_CAPACITY = 2;
+
+    template<typename T>
+    static void s_put(std::string &out, T v)
+    {
+        char buf[sizeof(T)];
+        std::memcpy(buf, &v, sizeof(T));
+        out.append(buf, sizeof(T));
+    }
+
+    static void s_put_string(std::string &out, std::string_view s)
+    {
+        s_put(out, uint32_t(s.size()));
+        out += s;
+    }
+
+    template<typename T>
+    static bool s_get(std::string_view &in, T &v)
+    {
+        if (in.size() < sizeof(T)) return false;
+        std::memcpy(&v, in.data(), sizeof(T));
+        in.remove_prefix(sizeof(T));
+        return true;
+    }
+
+    static bool s_get_string(std::string_view &in, std::string &s)
+    {
+        uint32_t n;
+        if (!s_get(in, n) || in.size() < n) return false;
+        s.assign(in.data(), n);
+        in.remove_prefix(n);
+        return true;
+    }
+
+    Kll::Kll(uint32_t k) : k_(std::max(k, MIN_CAPACITY))
+    {
+        Resize(1);
+    }
+
+    uint32_t Kll::Capacity(size_t level) const
+    {
+        // the top level holds k values, every level below 2/3 of the one above.
+        double c = k_ * std::pow(LEVEL_DECAY, double(levels_.size() - 1 - level));
+        return std::max(MIN_CAPACITY, uint32_t(std::ceil(c)));
+    }
+
+    void Kll::Resize(size_t levels)
+    {
+        levels_.resize(levels);
+        capacity_ = 0;
+        for (size_t h = 0; h < levels_.size(); h++) capacity_ += Capacity(h);
+    }
+
+    void Kll::Add(float x)
+    {
+        levels_[0].push_back(x);
+        n_++;
+        if (++retained_ >= capacity_) Compress();
+    }
+
+    void Kll::Compress()
+    {
+        // the lowest level over its capacity gives half of its values, of twice the weight, to the level above.
+        for (size_t h = 0; h < levels_.size(); h++) {
+            if (levels_[h].size() < Capacity(h)) continue;
+            if (h + 1 == levels_.size()) Resize(levels_.size() + 1);
+
+            auto& from = levels_[h];
+            auto& to = levels_[h + 1];
+            std::sort(from.begin(), from.end());
+            seed_ ^= seed_ << 13; seed_ ^= seed_ >> 7; seed_ ^= seed_ << 17;
+            // an odd value out stays, pairs keep either their smaller or their larger value.
+            const size_t first = from.size() & 1, offset = seed_ & 1;
+            for (size_t i = first + offset; i < from.size(); i += 2) to.push_back(from[i]);
+            retained_ -= (from.size() - first) / 2;
+            from.resize(first);
+            return;
+        }
+    }
+
+    void Kll::Merge(const Kll &other)
+    {
+        if (other.levels_.size() > levels_.size()) Resize(other.levels_.size());
+        for (size_t h = 0; h < other.levels_.size(); h++)
+            levels_[h].insert(levels_[h].end(), other.levels_[h].begin(), other.levels_[h].end());
+        n_ += other.n_;
+        retained_ += other.retained_;
+        while (retained_ >= capacity_) Compress();
+    }
+
+    float Kll::Quantile(double q) const
+    {
+        if (!n_) return 0;
+        std::vector<std::pair<float, uint64_t>> weighted;
+        weighted.reserve(retained_);
+        for (size_t h = 0; h < levels_.size(); h++)
+            for (const float x : levels_[h]) weighted.emplace_back(x, uint64_t(1) << h);
+        std::sort(weighted.begin(), weighted.end());
+
+        const double rank = std::clamp(q, 0.0, 1.0) * double(n_);
+        uint64_t seen = 0;
+        for (const auto& [x, w] : weighted) {
+            seen += w;
+            if (double(seen) >= rank) return x;
+        }
+        return weighted.back().first;
+    }
+
+    void Kll::Encode(std::string &out) const
+    {
+        s_put(out, k_);
+        s_put(out, n_);
+        s_put(out, seed_);
+        s_put(out, uint32_t(levels_.size()));
+        for (const auto& level : levels_) {
+            s_put(out, uint32_t(level.size()));
+            out.append(reinterpret_cast<const char*>(level.data()), level.size() * sizeof(float));
+        }
+    }
+
+    bool Kll::Decode(std::string_view &in)
+    {
+        uint32_t levels;
+        if (!(s_get(in, k_) && s_get(in, n_) && s_get(in, seed_) && s_get(in, levels)) || !levels || levels > 64)
+            return false;
+        k_ = std::max(k_, MIN_CAPACITY);
+        Resize(levels);
+        retained_ = 0;
+        for (auto& level : levels_) {
+            uint32_t size;
+            if (!s_get(in, size) || in.size() < size_t(size) * sizeof(float)) return false;
+            level.resize(size);
+            std::memcpy(level.data(), in.data(), size_t(size) * sizeof(float));
+            in.remove_prefix(size_t(size) * sizeof(float));
+            retained_ += size;
+        }
+        return true;
+    }
+
+    void Stats::Add(float x)
+    {
+        min = count ? std::min(min, x) : x;
+        max = count ? std::max(max, x) : x;
+        count++;
+        sum += x;
+        sketch.Add(x);
+    }
+
+    void Stats::Merge(const Stats &other)
+    {
+        if (!other.count) return;
+        min = count ? std::min(min, other.min) : other.min;
+        max = count ? std::max(max, other.max) : other.max;
+        count += other.count;
+        sum += other.sum;
+        sketch.Merge(other.sketch);
+    }
+
+    Grouping::Grouping(std::string_view spec) : spec_(spec)
+    {
+        for (size_t comma = 0; !spec_.empty() && comma != std::string_view::npos; ) {
+            comma = spec.find(',');
+            auto field = spec.substr(0, comma);
+            spec.remove_prefix(comma == std::string_view::npos ? spec.size() : comma + 1);
+
+            int width = 0;
+            if (auto slash = field.find('/'); slash != std::string_view::npos) {
+                auto digits = field.substr(slash + 1);
+                auto res = std::from_chars(digits.data(), digits.data() + digits.size(), width);
+                if (res.ec != std::errc() || res.ptr != digits.data() + digits.size() || width <= 0)
+                    throw std::runtime_error("invalid band width in " + spec_);
+                field = field.substr(0, slash);
+            }
+            if (field.empty()) throw std::runtime_error("empty field in " + spec_);
+            names_.emplace_back(field);
+            widths_.push_back(width);
+        }
+    }
+
+    std::vector<std::string> Grouping::Key(const Fields &f) const
+    {
+        std::vector<std::string> key;
+        key.reserve(names_.size());
+        for (size_t i = 0; i < names_.size(); i++) {
+            const auto& name = names_[i];
+            std::string value;
+            if (name == "stm") value = f.stm == Stockfish::WHITE ? "w" : "b";
+            else if (name == "pieces") value = std::to_string(f.pieces);
+            else if (name == "moves") value = std::to_string(f.moves);
+            else if (name == "depth") value = std::to_string(f.depth);
+            else if (f.source) value = f.source(name);
+
+            long long v;
+            auto res = std::from_chars(value.data(), value.data() + value.size(), v);
+            if (widths_[i] && res.ec == std::errc() && res.ptr == value.data() + value.size()) {
+                // floor, also for negative values.
+                long long lo = (v >= 0 ? v / widths_[i] : (v - widths_[i] + 1) / widths_[i]) * widths_[i];
+                value = std::to_string(lo) + '-' + std::to_string(lo + widths_[i] - 1);
+            }
+            key.push_back(std::move(value));
+        }
+        return key;
+    }
+
+    Report::Report(std::string metric, const Grouping &grouping) : metric_(std::move(metric)), grouping_(grouping) {}
+
+    void Report::Add(const Fields &f, double x)
+    {
+        auto key = grouping_.Key(f);
+        std::lock_guard<std::mutex> lock(mtx_);
+        groups_[std::move(key)].Add(float(x));
+    }
+
+    void Report::Merge(const Report &other)
+    {
+        if (other.metric_ != metric_ || other.grouping_.spec() != grouping_.spec())
+            throw std::runtime_error("cannot merge the " + other.metric_ + " by '" + other.grouping_.spec()
+                                     + "' statistics into the " + metric_ + " by '" + grouping_.spec() + "' ones");
+        std::scoped_lock lock(mtx_, other.mtx_);
+        for (const auto& [key, stats] : other.groups_) groups_[key].Merge(stats);
+    }
+
+    uint64_t Report::count() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        uint64_t n = 0;
+        for (const auto& [key, stats] : groups_) n += stats.count;
+        return n;
+    }
+
+    void Report::Save(const std::string &path) const
+    {
+        std::string data(MAGIC, sizeof(MAGIC));
+        s_put_string(data, metric_);
+        s_put_string(data, grouping_.spec());
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            s_put(data, uint64_t(groups_.size()));
+            for (const auto& [key, stats] : groups_) {
+                for (const auto& value : key) s_put_string(data, value);
+                s_put(data, stats.count);
+                s_put(data, stats.sum);
+                s_put(data, stats.min);
+                s_put(data, stats.max);
+                stats.sketch.Encode(data);
+            }
+        }
+
+        std::string tmp = path + ".tmp";
+        FILE *f = std::fopen(tmp.c_str(), "wb");
+        if (!f) throw std::runtime_error("could not create " + tmp);
+        std::fwrite(data.data(), 1, data.size(), f);
+        bool failed = std::ferror(f) != 0;
+        failed |= std::fclose(f) != 0;
+        if (failed || std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("could not write " + path);
+        }
+    }
+
+    std::unique_ptr<Report> Report::Load(const std::string &path)
+    {
+        std::ifstream is(path, std::ios::binary);
+        if (!is) throw std::runtime_error("could not open " + path);
+        std::string data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+        std::string_view in = data;
+
+        std::string metric, spec;
+        uint64_t groups;
+        if (in.size() < sizeof(MAGIC) || std::memcmp(in.data(), MAGIC, sizeof(MAGIC)) != 0)
+            throw std::runtime_error(path + " is not a statistics file");
+        in.remove_prefix(sizeof(MAGIC));
+        if (!(s_get_string(in, metric) && s_get_string(in, spec) && s_get(in, groups)))
+            throw std::runtime_error(path + ": corrupted statistics");
+
+        auto report = std::make_unique<Report>(metric, Grouping(spec));
+        const size_t fields = report->grouping_.names().size();
+        for (uint64_t g = 0; g < groups; g++) {
+            std::vector<std::string> key(fields);
+            Stats stats;
+            bool ok = true;
+            for (auto& value : key) ok = ok && s_get_string(in, value);
+            ok = ok && s_get(in, stats.count) && s_get(in, stats.sum) && s_get(in, stats.min) && s_get(in, stats.max)
+              && stats.sketch.Decode(in);
+            if (!ok) throw std::runtime_error(path + ": corrupted statistics");
+            report->groups_[std::move(key)].Merge(stats);
+        }
+        if (!in.empty()) throw std::runtime_error(path + ": corrupted statistics");
+        return report;
+    }
+
+    void Report::Write(std::ostream &os) const
+    {
+        static constexpr double QUANTILES[] = {0.1, 0.25, 0.5, 0.75, 0.9, 0.99};
+        std::string out;
+        for (const auto& name : grouping_.names()) {
+            Output::AppendCsvField(out, name);
+            out += ',';
+        }
+        out += "count,mean,min,p10,p25,p50,p75,p90,p99,max\n";
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        char buf[32];
+        auto number = [&](double v) {
+            std::snprintf(buf, sizeof(buf), ",%.6g", v);
+            out += buf;
+        };
+        for (const auto& [key, stats] : groups_) {
+            for (const auto& value : key) {
+                Output::AppendCsvField(out, value);
+                out += ',';
+            }
+            out += std::to_string(stats.count);
+            number(stats.sum / double(stats.count));
+            number(stats.min);
+            for (const double q : QUANTILES) number(stats.sketch.Quantile(q));
+            number(stats.max);
+            out += '\n';
+        }
+        os << out << std::flush;
+    }
+}
@@ -0,0 +1,124 @@
+//
+//  sketch.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef sketch_hpp
+#define sketch_hpp
+
+#include <stdio.h>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mini_stock/types.h"
+
+// Dataset wide statistics of a run (sharpness per opening, per rating band, ...) in constant memory.
+// Every group keeps counters and a KLL quantile sketch (Karnin, Lang and Liberty, "Optimal Quantile
+// Approximation in Streams"): about 1% rank error whatever the number of values, and sketches of separate
+// runs merge into the sketch of the whole, so shards analysed apart give a single report.
+namespace Sketch {
+
+    class Kll {
+    public:
+        // k is the size of the top level: the rank error is about 1.7 / k.
+        explicit Kll(uint32_t k = 200);
+
+        void Add(float x);
+        void Merge(const Kll &other);
+
+        // The value of rank q * count(), q in [0, 1]. 0 if empty.
+        float Quantile(double q) const;
+        uint64_t count() const { return n_; }
+        // Values kept, for the memory use.
+        size_t retained() const { return retained_; }
+
+        void Encode(std::string &out) const;
+        bool Decode(std::string_view &in);
+
+    private:
+        uint32_t Capacity(size_t level) const;
+        void Compress();
+        void Resize(size_t levels);
+
+        uint32_t k_;
+        uint64_t n_ {};
+        size_t retained_ {};
+        size_t capacity_ {};            // sum of the capacities of the levels
+        uint64_t seed_ {0x9e3779b97f4a7c15};
+        // level h holds values of weight 2^h.
+        std::vector<std::vector<float>> levels_;
+    };
+
+    struct Stats {
+        uint64_t count {};
+        double sum {};
+        float min {};
+        float max {};
+        Kll sketch {};
+
+        void Add(float x);
+        void Merge(const Stats &other);
+    };
+
+    // What a position can be grouped by: fields of its own ("stm", "pieces", "moves", "depth") and those
+    // of where it comes from, the tags of its game or the operations of its EPD line ("" if missing).
+    struct Fields {
+        Stockfish::Color stm {};
+        int pieces {};
+        int moves {};
+        int depth {};
+        std::function<std::string(std::string_view)> source {};
+    };
+
+    // Grouping keys, as given by --group: "ECO,WhiteElo/200,stm". A width after '/' groups numeric
+    // values in bands ("2200-2399"). Throws std::runtime_error on a malformed spec.
+    class Grouping {
+    public:
+        explicit Grouping(std::string_view spec = {});
+
+        const std::string& spec() const { return spec_; }
+        const std::vector<std::string>& names() const { return names_; }
+        std::vector<std::string> Key(const Fields &f) const;
+
+    private:
+        std::string spec_;
+        std::vector<std::string> names_;
+        std::vector<int> widths_;        // 0: the value as it is
+    };
+
+    // The statistics of a metric, per group. Add() and Merge() can be called from several threads.
+    class Report {
+    public:
+        Report(std::string metric, const Grouping &grouping);
+
+        void Add(const Fields &f, double x);
+        // Throws std::runtime_error unless both reports have the same metric and grouping.
+        void Merge(const Report &other);
+
+        // Binary, mergeable: see Load(). Throws std::runtime_error if the file cannot be written.
+        void Save(const std::string &path) const;
+        static std::unique_ptr<Report> Load(const std::string &path);
+
+        // CSV: the grouping keys, then count, mean, min, p10, p25, p50, p75, p90, p99 and max of every group.
+        void Write(std::ostream &os) const;
+
+        const std::string& metric() const { return metric_; }
+        size_t groups() const { return groups_.size(); }
+        uint64_t count() const;
+
+    private:
+        mutable std::mutex mtx_;
+        std::string metric_;
+        Grouping grouping_;
+        std::map<std::vector<std::string>, Stats> groups_;
+    };
+}
+
+#endif /* sketch_hpp */
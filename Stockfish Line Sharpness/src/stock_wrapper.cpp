@@ -8,6 +8,7 @@
 #include <iostream>
 #include <tuple>
 #include <numeric>
+#include <cstdlib>
 
 #include "stock_wrapper.hpp"
 #include "utils.hpp"
@@ -15,40 +16,79 @@
 
 void Engine::Start(const EngineOptions &opts)
 {
-    // we don't need to pass any argument, just call the executable.
+    Launch(opts);
+    Ready();
+}
+
+void Engine::Launch(const EngineOptions &opts)
+{
+    // we don't need to pass any argument, just call the executable, with the placement it inherits.
     const char * const argv[] = { command_.c_str(), NULL };
-    start(argv);
+    {
+        Affinity::Scope pin(opts.placement);
+        start(argv);
+    }
+    opts_.placement = opts.placement;
     
-    // start uci mode, check for "uciok", and the various options to parse.
+    // the engine reads its commands in order: the options are set once it is in uci mode.
     send_command("uci");
-    if (Read("uciok") == false)
-        throw std::runtime_error("could not set stockfish to uci mode");
-    
     SetOption("UCI_showWDL", opts.showWDL ? "true" : "false");
     SetOption("Threads", std::to_string(opts.threads));
     SetOption("MultiPV", std::to_string(opts.multiPV));
+    if (opts.hash) SetOption("Hash", std::to_string(opts.hash));
 
     send_command("ucinewgame");
     send_command("isready");
-    
-    // wait for the stockfish to be ready
+}
+
+void Engine::Ready()
+{
+    // check for "uciok", then wait for the stockfish to be ready
+    if (Read("uciok") == false)
+        throw std::runtime_error("could not set stockfish to uci mode");
+    Read("readyok");
+}
+
+void Engine::Quit()
+{
+    send_command("stop");
+    send_command("quit");
+}
+
+void Engine::NewGame()
+{
+    send_command("ucinewgame");
+    send_command("isready");
     Read("readyok");
 }
 
+void Engine::ReadSearch()
+{
+    Read("bestmove");
+    for (auto line = output_.rbegin(); line != output_.rend(); line++) {
+        const auto at = line->find(" nps ");
+        if (!line->starts_with("info") || at == std::string::npos) continue;
+        nps_sum_ += std::strtoull(line->c_str() + at + 5, nullptr, 10);
+        nps_count_++;
+        break;
+    }
+}
+
 void Engine::SetOption(const std::string & optname, const std::string & optvalue)
 {
     if (optname == "UCI_showWDL" ) opts_.showWDL = optvalue == "true" ? true : false;
     if (optname == "Threads" ) opts_.threads = std::stoi(optvalue);
     if (optname == "MultiPV" ) opts_.multiPV = std::stoi(optvalue);
+    if (optname == "Hash" ) opts_.hash = std::stoi(optvalue);
         
-    send_command("setoption " + optname + " value " + optvalue);
+    send_command("setoption name " + optname + " value " + optvalue);
 }
 
 std::string Engine::GetBestMove(const Position& pos)
 {
     send_command("position fen " + pos.fen());
     send_command("go depth " + std::to_string(depth_));
-    Read("bestmove");
+    ReadSearch();
     
     return Utils::parse_best_move(output_);
 }
@@ -58,7 +98,7 @@ double Engine::Eval(const Position& pos)
 {
     send_command("position fen " + pos.fen());
     send_command("go depth " +  std::to_string(depth_));
-    Read("bestmove");
+    ReadSearch();
     
     return Utils::lc0_cp_to_win(Utils::centipawns(pos.side_to_move(), output_)*100);
 }
@@ -79,7 +119,7 @@ double Engine::EvalMove(Stockfish::Move m, Position& pos)
     }
     send_command("position fen " + pos.fen() + " moves " + longm);
     send_command("go depth " + std::to_string(depth_));
-    Read("bestmove");
+    ReadSearch();
     
     // measuring the first depths takes less than a ms, so we're safe.
     return Utils::lc0_cp_to_win(Utils::centipawns(~pos.side_to_move(), output_)*100);
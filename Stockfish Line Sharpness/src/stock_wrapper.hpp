@@ -19,11 +19,14 @@
 
 #include "position.hpp"
 #include "utils.hpp"
+#include "affinity.hpp"
 
 struct EngineOptions {
     int threads;
     bool showWDL;
     int multiPV;
+    int hash {};    // MB, 0: the engine's default (see Plan)
+    Affinity::Placement placement {};   // where the engine (and its threads) run, anywhere by default
 };
 
 class Engine : public System::Process {
@@ -52,8 +55,17 @@ public:
         return (int)timeout_.count();
     }
 
+    // Start() is Launch() then Ready(). Launch() only spawns the engine and writes its setup, so that the
+    // engine loads (its net, its hash) while we do something else; Ready() waits for it.
     void Start(const EngineOptions&);
     inline void Start() { Start(opts_); };
+    void Launch(const EngineOptions&);
+    inline void Launch() { Launch(opts_); };
+    void Ready();
+    // Stops the search, if any, and asks the engine to exit.
+    void Quit();
+    // "ucinewgame": clears the hash, only between unrelated analyses (two games), and waits for the engine.
+    void NewGame();
     inline bool Read(const std::string &expected, std::chrono::milliseconds timeout) {
         return read(output_, expected, (int)timeout.count());
     };
@@ -69,6 +81,11 @@ public:
                                   const Stockfish::MoveList<Stockfish::LEGAL>&, Position&);
     std::vector<double> EvalMoves(const Stockfish::MoveList<Stockfish::LEGAL>&, Position&);
     
+    // The mean of the speeds the engine reported ("info ... nps") over its searches, 0 if it did not.
+    inline uint64_t Nps() const {
+        return nps_count_ ? nps_sum_ / nps_count_ : 0;
+    }
+    
 //    template<typename F = std::identity>
 //    double Eval(Position & pos, F && f = {}) {
 //        send_command("position fen " + pos.fen());
@@ -111,7 +128,11 @@ public:
 //    }
     
 private:
+    // Waits for the end of the search.
+    void ReadSearch();
+
     std::vector<std::string> output_;
+    uint64_t nps_sum_ {}, nps_count_ {};
     std::chrono::milliseconds timeout_ {-1};
     int depth_ {15};
     EngineOptions opts_
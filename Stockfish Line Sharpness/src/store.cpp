@@ -0,0 +1,308 @@
+//
+//  store.cpp
+//  Stockfish Line Sharpness
+//
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#include "store.hpp"
+#include "canonical.hpp"
+#include "notation.hpp"
+
+namespace Store {
+    using namespace Stockfish;
+
+    // The file starts with the magic and ends with the footer offset, the number of blocks and the magic.
+    static constexpr char MAGIC[8] = {'L', 'S', 'S', 'T', 'O', 'R', 'E', '1'};
+    static constexpr char PieceToChar[] = " PNBRQK  pnbrqk";
+
+    static void s_put_varint(std::vector<uint8_t> &out, uint64_t v)
+    {
+        while (v >= 0x80) {
+            out.push_back(uint8_t(v) | 0x80);
+            v >>= 7;
+        }
+        out.push_back(uint8_t(v));
+    }
+
+    static uint64_t s_get_varint(const uint8_t *&p)
+    {
+        uint64_t v = 0;
+        for (int shift = 0; ; shift += 7) {
+            uint8_t byte = *p++;
+            v |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return v;
+        }
+    }
+
+    static uint64_t s_zigzag(int64_t v) { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+    static int64_t s_unzigzag(uint64_t v) { return int64_t(v >> 1) ^ -int64_t(v & 1); }
+
+    void Pack(const Position &pos, uint8_t (&out)[PACKED_POSITION_SIZE])
+    {
+        // occupancy, then one nibble (the Stockfish::Piece) per occupied square, from a1 to h8.
+        std::memset(out, 0, sizeof(out));
+        Bitboard occupied = pos.pieces();
+        std::memcpy(out, &occupied, sizeof(occupied));
+        int i = 0;
+        for (Bitboard b = occupied; b; i++) {
+            Square s = pop_lsb(b);
+            out[8 + i / 2] |= uint8_t(pos.piece_on(s) << (4 * (i & 1)));
+        }
+
+        // castling rights (4 bits), en passant flag and file (rank given by the side to move).
+        Square ep = Canonical::ep_square(pos);
+        out[24] = uint8_t(Canonical::castling_rights(pos) | (ep != SQ_NONE ? 0x10 | (file_of(ep) << 5) : 0));
+    }
+
+    std::string Unpack(const uint8_t *packed, Color stm)
+    {
+        Piece board[SQUARE_NB] {};
+        Bitboard occupied;
+        std::memcpy(&occupied, packed, sizeof(occupied));
+        int i = 0;
+        for (Bitboard b = occupied; b; i++) {
+            Square s = pop_lsb(b);
+            board[s] = Piece((packed[8 + i / 2] >> (4 * (i & 1))) & 0xf);
+        }
+
+        std::string fen;
+        for (Rank r = RANK_8; r >= RANK_1; --r) {
+            int empty = 0;
+            for (File f = FILE_A; f <= FILE_H; ++f) {
+                Piece pc = board[make_square(f, r)];
+                if (pc == NO_PIECE) { empty++; continue; }
+                if (empty) fen += char('0' + empty);
+                empty = 0;
+                fen += PieceToChar[pc];
+            }
+            if (empty) fen += char('0' + empty);
+            if (r > RANK_1) fen += '/';
+        }
+
+        int state = packed[24];
+        fen += stm == WHITE ? " w " : " b ";
+        if (state & WHITE_OO)  fen += 'K';
+        if (state & WHITE_OOO) fen += 'Q';
+        if (state & BLACK_OO)  fen += 'k';
+        if (state & BLACK_OOO) fen += 'q';
+        if (!(state & ANY_CASTLING)) fen += '-';
+        if (state & 0x10) {
+            fen += ' ';
+            fen += char('a' + (state >> 5));
+            fen += stm == WHITE ? '6' : '3';
+        } else fen += " -";
+        return fen + " 0 1";
+    }
+
+    Writer::Writer(const std::string &path, size_t rows_per_block)
+        : rows_per_block_(std::max<size_t>(rows_per_block, 1))
+    {
+        file_ = std::fopen(path.c_str(), "wb");
+        if (!file_) throw std::runtime_error("could not create " + path);
+        std::fwrite(MAGIC, 1, sizeof(MAGIC), file_);
+        offset_ = sizeof(MAGIC);
+    }
+
+    Writer::~Writer()
+    {
+        try { Close(); } catch (const std::runtime_error &) {}
+    }
+
+    void Writer::Append(const Position &pos, const Output::Record &r)
+    {
+        if (!r.error.empty()) return;
+
+        uint8_t packed[PACKED_POSITION_SIZE];
+        Pack(pos, packed);
+        Key key = Canonical::key(pos);
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!file_) throw std::runtime_error("the store is closed");
+
+        auto& b = block_;
+        if (b.rows % 64 == 0) b.stm.push_back(0);
+        if (pos.side_to_move() == BLACK) b.stm.back() |= uint64_t(1) << (b.rows % 64);
+
+        b.keys.push_back(key);
+        b.positions.insert(b.positions.end(), packed, packed + PACKED_POSITION_SIZE);
+        s_put_varint(b.depths, s_zigzag(r.depth - b.last_depth));
+        b.last_depth = r.depth;
+        b.evals.push_back(float(r.eval));
+        b.sharpness.push_back(float(r.sharpness));
+
+        s_put_varint(b.move_counts, r.moves.size());
+        for (const auto& m : r.moves) {
+            b.moves.push_back(uint16_t(Notation::from_lan(pos, m.lan)));
+            b.move_evals.push_back(float(m.eval));
+        }
+
+        b.rows++;
+        rows_++;
+        if (b.rows == rows_per_block_) FlushBlock();
+    }
+
+    void Writer::WriteColumn(BlockInfo &info, Column c, const void *data, size_t bytes)
+    {
+        static const char zeros[8] {};
+        info.offset[c] = offset_;
+        info.bytes[c] = bytes;
+        std::fwrite(data, 1, bytes, file_);
+        // keeps the next column aligned for in place scans.
+        size_t pad = (8 - bytes % 8) % 8;
+        std::fwrite(zeros, 1, pad, file_);
+        offset_ += bytes + pad;
+    }
+
+    void Writer::FlushBlock()
+    {
+        auto& b = block_;
+        if (!b.rows) return;
+
+        BlockInfo info {};
+        info.first_row = rows_ - b.rows;
+        info.rows = b.rows;
+        auto [lo, hi] = std::minmax_element(b.sharpness.begin(), b.sharpness.end());
+        info.min_sharpness = *lo;
+        info.max_sharpness = *hi;
+
+        WriteColumn(info, KEY, b.keys.data(), b.keys.size() * sizeof(uint64_t));
+        WriteColumn(info, STM, b.stm.data(), b.stm.size() * sizeof(uint64_t));
+        WriteColumn(info, POSITION, b.positions.data(), b.positions.size());
+        WriteColumn(info, DEPTH, b.depths.data(), b.depths.size());
+        WriteColumn(info, EVAL, b.evals.data(), b.evals.size() * sizeof(float));
+        WriteColumn(info, SHARPNESS, b.sharpness.data(), b.sharpness.size() * sizeof(float));
+        WriteColumn(info, MOVE_COUNT, b.move_counts.data(), b.move_counts.size());
+        WriteColumn(info, MOVES, b.moves.data(), b.moves.size() * sizeof(uint16_t));
+        WriteColumn(info, MOVE_EVALS, b.move_evals.data(), b.move_evals.size() * sizeof(float));
+        if (std::ferror(file_)) throw std::runtime_error("could not write the store");
+
+        index_.push_back(info);
+        b.keys.clear(); b.stm.clear(); b.positions.clear(); b.depths.clear();
+        b.evals.clear(); b.sharpness.clear(); b.move_counts.clear(); b.moves.clear(); b.move_evals.clear();
+        b.rows = 0;
+        b.last_depth = 0;
+    }
+
+    void Writer::Close()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!file_) return;
+
+        FlushBlock();
+        uint64_t footer = offset_, n = index_.size();
+        std::fwrite(index_.data(), sizeof(BlockInfo), index_.size(), file_);
+        std::fwrite(&footer, sizeof(footer), 1, file_);
+        std::fwrite(&n, sizeof(n), 1, file_);
+        std::fwrite(MAGIC, 1, sizeof(MAGIC), file_);
+
+        bool failed = std::ferror(file_) != 0;
+        failed |= std::fclose(file_) != 0;
+        file_ = nullptr;
+        if (failed) throw std::runtime_error("could not write the store");
+    }
+
+    Reader::Reader(const std::string &path) : file_(path)
+    {
+        auto data = file_.data();
+        const size_t trailer = 2 * sizeof(uint64_t) + sizeof(MAGIC);
+        if (data.size() < sizeof(MAGIC) + trailer
+            || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0
+            || std::memcmp(data.data() + data.size() - sizeof(MAGIC), MAGIC, sizeof(MAGIC)) != 0)
+            throw std::runtime_error(path + " is not a result store (or it was not closed)");
+
+        uint64_t footer, n;
+        std::memcpy(&footer, data.data() + data.size() - trailer, sizeof(footer));
+        std::memcpy(&n, data.data() + data.size() - trailer + sizeof(footer), sizeof(n));
+        if (footer + n * sizeof(BlockInfo) + trailer != data.size())
+            throw std::runtime_error(path + ": corrupted footer");
+
+        blocks_.resize(n);
+        std::memcpy(blocks_.data(), data.data() + footer, n * sizeof(BlockInfo));
+        for (const auto& b : blocks_) {
+            for (int c = 0; c < COLUMN_NB; c++)
+                if (b.offset[c] + b.bytes[c] > footer) throw std::runtime_error(path + ": corrupted block index");
+            rows_ += b.rows;
+        }
+
+        // FNV-1a over the block index and the trailer, then the size and the modification time.
+        id_ = 0xcbf29ce484222325ull;
+        auto mix = [&](uint64_t v) { id_ = (id_ ^ v) * 0x100000001b3ull; };
+        for (size_t i = footer; i < data.size(); i++) mix(uint8_t(data[i]));
+        mix(data.size());
+        std::error_code ec;
+        const auto mtime = std::filesystem::last_write_time(path, ec);
+        if (!ec) mix(uint64_t(mtime.time_since_epoch().count()));
+    }
+
+    std::vector<int> Reader::depths(size_t b) const
+    {
+        auto col = column<uint8_t>(b, DEPTH);
+        const uint8_t *p = col.data();
+        std::vector<int> out(blocks_[b].rows);
+        int depth = 0;
+        for (auto& d : out) d = depth += int(s_unzigzag(s_get_varint(p)));
+        return out;
+    }
+
+    std::vector<uint32_t> Reader::move_counts(size_t b) const
+    {
+        auto col = column<uint8_t>(b, MOVE_COUNT);
+        const uint8_t *p = col.data();
+        std::vector<uint32_t> out(blocks_[b].rows);
+        for (auto& n : out) n = uint32_t(s_get_varint(p));
+        return out;
+    }
+
+    size_t Reader::block_of(uint64_t i) const
+    {
+        auto it = std::upper_bound(blocks_.begin(), blocks_.end(), i,
+                                   [](uint64_t r, const BlockInfo &b) { return r < b.first_row; });
+        return size_t(it - blocks_.begin()) - 1;
+    }
+
+    Row Reader::row(uint64_t i) const
+    {
+        if (i >= rows_) throw std::runtime_error("row " + std::to_string(i) + " out of range");
+        size_t b = block_of(i);
+        size_t k = size_t(i - blocks_[b].first_row);
+
+        Row row {};
+        row.key = keys(b)[k];
+        row.side_to_move = (column<uint64_t>(b, STM)[k / 64] >> (k % 64)) & 1 ? BLACK : WHITE;
+        row.fen = Unpack(column<uint8_t>(b, POSITION).data() + k * PACKED_POSITION_SIZE, row.side_to_move);
+        row.depth = depths(b)[k];
+        row.eval = evals(b)[k];
+        row.sharpness = sharpness(b)[k];
+
+        auto counts = move_counts(b);
+        size_t first = 0;
+        for (size_t j = 0; j < k; j++) first += counts[j];
+        for (auto m : moves(b).subspan(first, counts[k])) row.moves.push_back(Move(m));
+        auto evals = move_evals(b).subspan(first, counts[k]);
+        row.move_evals.assign(evals.begin(), evals.end());
+        return row;
+    }
+
+    std::vector<uint64_t> Reader::SharpnessAbove(float threshold) const
+    {
+        std::vector<uint64_t> out;
+        for (size_t b = 0; b < blocks_.size(); b++) {
+            if (!(blocks_[b].max_sharpness > threshold)) continue;
+            // branchless: every row is written, the cursor only moves past the matching ones.
+            auto col = sharpness(b);
+            size_t n = out.size();
+            out.resize(n + col.size());
+            uint64_t *dst = out.data() + n, first = blocks_[b].first_row;
+            for (size_t k = 0; k < col.size(); k++) {
+                *dst = first + k;
+                dst += col[k] > threshold;
+            }
+            out.resize(size_t(dst - out.data()));
+        }
+        return out;
+    }
+}
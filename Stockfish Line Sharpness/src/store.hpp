@@ -0,0 +1,158 @@
+//
+//  store.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef store_hpp
+#define store_hpp
+
+#include <stdio.h>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "mini_stock/position.h"
+#include "ingest.hpp"
+#include "output.hpp"
+
+// Columnar binary file of analysis results, for datasets too big to query as text.
+// Rows are grouped in blocks, and every block stores each column contiguously:
+//
+//   key         uint64, Canonical::key()
+//   stm         1 bit per row
+//   position    25 bytes per row: occupancy, 4 bit piece codes, castling and en passant
+//   depth       zigzag varint of the difference with the previous row
+//   eval        float
+//   sharpness   float
+//   move count  varint
+//   moves       uint16 per move (Stockfish::Move)
+//   move evals  float per move
+//
+// Fixed width columns are 8 byte aligned and can be scanned in place from the mapping. The footer
+// indexes the blocks, with the sharpness range of each block so that scans can skip whole blocks.
+namespace Store {
+
+    enum Column { KEY, STM, POSITION, DEPTH, EVAL, SHARPNESS, MOVE_COUNT, MOVES, MOVE_EVALS, COLUMN_NB };
+
+    static constexpr size_t PACKED_POSITION_SIZE = 25;
+
+    struct BlockInfo {
+        uint64_t first_row;
+        uint32_t rows;
+        float min_sharpness;
+        float max_sharpness;
+        uint32_t padding;
+        uint64_t offset[COLUMN_NB];
+        uint64_t bytes[COLUMN_NB];
+    };
+
+    struct Row {
+        Stockfish::Key key {};
+        std::string fen;                        // canonical FEN, counters "0 1"
+        Stockfish::Color side_to_move {};
+        int depth {};
+        float eval {};
+        float sharpness {};
+        std::vector<Stockfish::Move> moves;
+        std::vector<float> move_evals;
+    };
+
+    // Packs the canonical position (see Canonical) and unpacks it back to its FEN.
+    void Pack(const Stockfish::Position &pos, uint8_t (&out)[PACKED_POSITION_SIZE]);
+    std::string Unpack(const uint8_t *packed, Stockfish::Color stm);
+
+    // Appends rows to a new file. The footer is written by Close() (or the destructor): a file that
+    // was not closed cannot be read. Append() can be called from several threads.
+    // Throws std::runtime_error if the file cannot be written.
+    class Writer {
+    public:
+        explicit Writer(const std::string &path, size_t rows_per_block = 1 << 16);
+        ~Writer();
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        // The moves of the record are matched to pos by their LAN. Records with an error are skipped.
+        void Append(const Stockfish::Position &pos, const Output::Record &r);
+        void Close();
+
+        uint64_t rows() const { return rows_; }
+
+    private:
+        void FlushBlock();
+        void WriteColumn(BlockInfo &info, Column c, const void *data, size_t bytes);
+
+        std::mutex mtx_;
+        FILE *file_ {nullptr};
+        size_t rows_per_block_;
+        uint64_t rows_ {};
+        uint64_t offset_ {};
+        std::vector<BlockInfo> index_;
+
+        struct {
+            std::vector<uint64_t> keys;
+            std::vector<uint64_t> stm;
+            std::vector<uint8_t> positions;
+            std::vector<uint8_t> depths;
+            std::vector<float> evals;
+            std::vector<float> sharpness;
+            std::vector<uint8_t> move_counts;
+            std::vector<uint16_t> moves;
+            std::vector<float> move_evals;
+            uint32_t rows {};
+            int last_depth {};
+        } block_;
+    };
+
+    // Memory maps a closed file. Throws std::runtime_error if the file is not a valid store.
+    class Reader {
+    public:
+        explicit Reader(const std::string &path);
+
+        uint64_t rows() const { return rows_; }
+        size_t blocks() const { return blocks_.size(); }
+        // Identifies the file: a hash of its block index, its size and its modification time. The Writer
+        // starts the file over, a store written again has another id even with the same rows (see Lookup).
+        uint64_t id() const { return id_; }
+        const BlockInfo& block(size_t b) const { return blocks_[b]; }
+
+        // The fixed width columns of a block, straight from the mapping.
+        std::span<const uint64_t> keys(size_t b) const { return column<uint64_t>(b, KEY); }
+        std::span<const uint64_t> stm(size_t b) const { return column<uint64_t>(b, STM); }    // bit k: row k is black to move
+        std::span<const uint8_t> positions(size_t b) const { return column<uint8_t>(b, POSITION); }   // see Pack()
+        std::span<const float> evals(size_t b) const { return column<float>(b, EVAL); }
+        std::span<const float> sharpness(size_t b) const { return column<float>(b, SHARPNESS); }
+        std::span<const uint16_t> moves(size_t b) const { return column<uint16_t>(b, MOVES); }
+        std::span<const float> move_evals(size_t b) const { return column<float>(b, MOVE_EVALS); }
+
+        // Decoded varint columns of a block.
+        std::vector<int> depths(size_t b) const;
+        std::vector<uint32_t> move_counts(size_t b) const;
+
+        // The block holding row i (i < rows()).
+        size_t block_of(uint64_t i) const;
+
+        // Decodes the varint columns of the whole block, see Lookup for random access.
+        Row row(uint64_t i) const;
+
+        // Rows whose sharpness is above threshold, in order. Blocks below the threshold are not read.
+        std::vector<uint64_t> SharpnessAbove(float threshold) const;
+
+    private:
+        template<typename T>
+        std::span<const T> column(size_t b, Column c) const
+        {
+            auto base = reinterpret_cast<const T*>(file_.data().data() + blocks_[b].offset[c]);
+            return {base, blocks_[b].bytes[c] / sizeof(T)};
+        }
+
+        Ingest::MappedFile file_;
+        std::vector<BlockInfo> blocks_;
+        uint64_t rows_ {};
+        uint64_t id_ {};
+    };
+}
+
+#endif /* store_hpp */
@@ -0,0 +1,38 @@
+//
+//  benchmarks.cpp
+//  Benchmarks
+//
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+
+#include "../src/mini_stock/bitboard.h"
+#include "../src/mini_stock/position.h"
+#include "notation_bench.hpp"
+#include "cpu_dispatch_bench.hpp"
+#include "fen_bench.hpp"
+#include "count_legal_bench.hpp"
+#include "ingest_bench.hpp"
+#include "replay_bench.hpp"
+#include "store_bench.hpp"
+#include "lookup_bench.hpp"
+#include "rescore_bench.hpp"
+#include "sketch_bench.hpp"
+
+int main()
+{
+    Stockfish::Bitboards::init();
+    Stockfish::Position::init();
+
+    bench_notation();
+    bench_cpu_dispatch();
+    bench_fen();
+    bench_count_legal();
+    bench_ingest();
+    bench_replay();
+    bench_store();
+    bench_lookup();
+    bench_rescore();
+    bench_sketch();
+}
@@ -0,0 +1,87 @@
+//
+//  canonical_fen.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../src/canonical.hpp"
+#include "../src/position.hpp"
+#include "../src/utils.hpp"
+
+namespace Test {
+    namespace Canonical {
+        // Pairs of FENs of the same position, the second one is the canonical form.
+        static const std::vector<std::pair<std::string, std::string>> Equivalent {
+            // move counters
+            {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 7 23",
+             "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"},
+            // nobody can take en passant
+            {"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1",
+             "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1"},
+            // the capture is there but it would leave the king in check
+            {"8/8/8/KPp4r/8/8/8/7k w - c6 0 1",
+             "8/8/8/KPp4r/8/8/8/7k w - - 0 1"},
+            // the capture is legal
+            {"rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 3",
+             "rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1"},
+        };
+    }
+
+    bool CanonicalFens(const std::vector<std::pair<std::string, std::string>> &cases)
+    {
+        for (const auto& [fen, expected] : cases) {
+            auto canonical = ::Canonical::fen(fen);
+            std::cout << "\t" << fen << "\n\t\t" << canonical << std::endl;
+            if (canonical != expected) return false;
+            if (::Canonical::key(fen) != ::Canonical::key(expected)) return false;
+            // canonicalising twice changes nothing.
+            if (::Canonical::fen(canonical) != canonical) return false;
+        }
+        return true;
+    }
+}
+
+int test_canonical()
+{
+    using namespace Stockfish;
+    // makes sure the tables are initialized.
+    ::Position startpos {};
+
+    std::cout << "FENs of the same position have the same canonical form: \n";
+    if (!Test::CanonicalFens(Test::Canonical::Equivalent)) {
+        std::cout << "Failed" << std::endl; std::abort();
+    } std::cout << "Passed" << std::endl;
+
+    std::cout << "Castling rights without the rook in place are dropped: \n";
+    {
+        // Position::set() looks for the rook from the corner inwards and happily takes the one on g1.
+        StateInfo si;
+        Stockfish::Position pos;
+        pos.set("r3k2r/8/8/8/8/8/8/R3K1R1 w KQkq - 0 1", false, &si);
+        auto canonical = Canonical::fen(pos);
+        std::cout << "\t" << pos.fen() << "\n\t\t" << canonical << std::endl;
+        if (canonical != "r3k2r/8/8/8/8/8/8/R3K1R1 w Qkq - 0 1"
+            || Canonical::key(pos) != Canonical::key(canonical)) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    std::cout << "Transpositions from different move orders share the key: \n";
+    {
+        std::vector<std::string> line_a {"e2e4", "e7e5", "g1f3", "b8c6", "f1c4"};
+        std::vector<std::string> line_b {"g1f3", "b8c6", "e2e3", "e7e6", "e3e4", "e6e5", "f1c4"};
+        ::Position a {}, b {};
+        a.Advance(Utils::translate_moves(a, line_a, false));
+        b.Advance(Utils::translate_moves(b, line_b, false));
+        std::cout << "\t" << a.fen() << "\n\t" << b.fen() << std::endl;
+        if (a.fen() == b.fen() || Canonical::key(a) != Canonical::key(b) || Canonical::fen(a) != Canonical::fen(b)) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,49 @@
+//
+//  count_legal_bench.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/mini_stock/movegen.h"
+#include "../src/mini_stock/position.h"
+#include "notation_bench.hpp"
+
+// Counting the legal moves by generating them (MoveList<LEGAL>::size()) versus count_legal().
+int bench_count_legal()
+{
+    using namespace Stockfish;
+    static const int ROUNDS = 50;
+
+    auto fens = Bench::random_fens(5000);
+    std::deque<StateInfo> states;
+    std::deque<Position> positions;
+    for (const auto& fen : fens) {
+        states.emplace_back();
+        positions.emplace_back().set(fen, false, &states.back());
+        if (count_legal(positions.back()).total != int(MoveList<LEGAL>(positions.back()).size())) {
+            std::cout << "[Bench][count legal] mismatch for " << fen << std::endl;
+            std::abort();
+        }
+    }
+
+    size_t n_positions = positions.size() * ROUNDS;
+    uint64_t sink {};
+    auto generated = Bench::moves_per_second(n_positions, [&]{
+        for (int r = 0; r < ROUNDS; r++)
+            for (const auto& pos : positions) sink += MoveList<LEGAL>(pos).size();
+    });
+    auto counted = Bench::moves_per_second(n_positions, [&]{
+        for (int r = 0; r < ROUNDS; r++)
+            for (const auto& pos : positions) sink += count_legal(pos).total;
+    });
+
+    std::cout << "[Bench][count legal] MoveList<LEGAL>: " << generated << " positions/s" << '\n';
+    std::cout << "[Bench][count legal] count_legal(): " << counted << " positions/s" << '\n';
+    std::cout << "(checksum " << sink << ")" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,60 @@
+//
+//  cpu_dispatch_bench.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/mini_stock/bitboard.h"
+#include "../src/mini_stock/movegen.h"
+#include "../src/mini_stock/position.h"
+#include "../src/perft.hpp"
+
+// Runs the same perft with every kernel variant supported by the host: the node counts must agree,
+// and the variant picked by Bitboards::init() should be the fastest one.
+int bench_cpu_dispatch()
+{
+    using namespace Stockfish;
+    struct PerftCase { std::string fen; int depth; uint64_t nodes; };
+    static const std::vector<PerftCase> cases {
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603},
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624},
+    };
+
+    const CpuVariant detected = Bitboards::detect_cpu();
+    CpuVariant fastest = CPU_GENERIC;
+    double best_nps {};
+
+    std::cout << "[Bench][cpu dispatch] detected: " << Bitboards::variant_name(detected) << '\n';
+    for (int v = CPU_GENERIC; v <= detected; v++) {
+        Bitboards::init(CpuVariant(v));
+        uint64_t nodes {};
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& c : cases) {
+            StateInfo st;
+            Position pos;
+            pos.set(c.fen, false, &st);
+            auto n = Perft::perft(pos, c.depth);
+            if (n != c.nodes) {
+                std::cout << "[Bench][cpu dispatch] perft mismatch with " << Bitboards::variant_name(CpuVariant(v))
+                << ": " << n << " != " << c.nodes << " (" << c.fen << ")" << std::endl;
+                std::abort();
+            }
+            nodes += n;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        double nps = static_cast<double>(nodes) / elapsed.count();
+        std::cout << "[Bench][cpu dispatch] " << Bitboards::variant_name(CpuVariant(v)) << ":\t" << nps << " nodes/s" << '\n';
+        if (nps > best_nps) { best_nps = nps; fastest = CpuVariant(v); }
+    }
+    std::cout << "[Bench][cpu dispatch] fastest: " << Bitboards::variant_name(fastest)
+    << (fastest == detected ? " (selected at startup)" : " (NOT the one selected at startup)") << std::endl;
+
+    // leave the tables as the rest of the program expects them.
+    Bitboards::init();
+    return 0;
+}
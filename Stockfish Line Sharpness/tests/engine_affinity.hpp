@@ -0,0 +1,75 @@
+//
+//  engine_affinity.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/affinity.hpp"
+
+namespace Test {
+    namespace Affinity {
+        inline bool Is(const ::Affinity::Placement &p, std::vector<int> cpus, int node)
+        {
+            return p.cpus == cpus && p.node == node;
+        }
+    }
+}
+
+int test_affinity()
+{
+    {
+        std::cout << "[Test][affinity] CPU lists, engines spread over the nodes - ";
+        std::vector<int> cpus;
+        bool ok = Affinity::ParseCpuList("0-3,8,10-11\n", cpus) && cpus == std::vector<int>{0, 1, 2, 3, 8, 10, 11};
+        ok &= Affinity::ParseCpuList("", cpus) && cpus.empty();
+        ok &= !Affinity::ParseCpuList("3-1", cpus) && !Affinity::ParseCpuList("0,,1", cpus) && !Affinity::ParseCpuList("a", cpus);
+
+        // two sockets of four cores.
+        const std::vector<Affinity::Node> nodes {{0, {0, 1, 2, 3}}, {1, {4, 5, 6, 7}}};
+        auto core = Affinity::Place(Affinity::Pin::Core, nodes, 5, 1);
+        ok &= core.size() == 5 && Test::Affinity::Is(core[0], {0}, 0) && Test::Affinity::Is(core[1], {4}, 1)
+           && Test::Affinity::Is(core[2], {1}, 0) && Test::Affinity::Is(core[4], {2}, 0);
+        auto pairs = Affinity::Place(Affinity::Pin::Core, nodes, 6, 2);
+        ok &= Test::Affinity::Is(pairs[0], {0, 1}, 0) && Test::Affinity::Is(pairs[3], {6, 7}, 1)
+           && Test::Affinity::Is(pairs[4], {0, 1}, 0);
+        auto node = Affinity::Place(Affinity::Pin::Node, nodes, 3, 2);
+        ok &= Test::Affinity::Is(node[0], {0, 1, 2, 3}, 0) && Test::Affinity::Is(node[1], {4, 5, 6, 7}, 1)
+           && Test::Affinity::Is(node[2], {0, 1, 2, 3}, 0);
+
+        // an engine larger than a node spans them all, with no node; nothing is pinned without --pin.
+        auto wide = Affinity::Place(Affinity::Pin::Node, nodes, 1, 8);
+        ok &= Test::Affinity::Is(wide[0], {0, 1, 2, 3, 4, 5, 6, 7}, -1);
+        auto none = Affinity::Place(Affinity::Pin::None, nodes, 2, 1);
+        ok &= none.size() == 2 && Test::Affinity::Is(none[1], {}, -1);
+
+        Affinity::Pin pin {};
+        ok &= Affinity::ParsePin("node", pin) && pin == Affinity::Pin::Node && std::string(Affinity::Name(pin)) == "node";
+        ok &= !Affinity::ParsePin("socket", pin);
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][affinity] the thread is pinned in the scope only - ";
+        const auto before = Affinity::Topology();
+        bool ok = !before.empty() && !before[0].cpus.empty();
+        const int cpu = before[0].cpus.back();
+        {
+            Affinity::Scope pin({{cpu}, before[0].id});
+#if defined(__linux__)
+            const auto inside = Affinity::Topology();
+            ok &= inside.size() == 1 && inside[0].cpus == std::vector<int>{cpu};
+#endif
+        }
+        const auto after = Affinity::Topology();
+        ok &= after.size() == before.size() && after[0].cpus == before[0].cpus;
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    return 0;
+}
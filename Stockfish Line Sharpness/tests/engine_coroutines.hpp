@@ -0,0 +1,149 @@
+//
+//  engine_coroutines.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../src/coro.hpp"
+#include "../src/notation.hpp"
+#include "../src/utils.hpp"
+
+namespace Test {
+    namespace Coro {
+        // The score of the fake engine of engine_reactor.hpp is the length of the position.
+        inline double Expected(const std::string &position, Stockfish::Color col)
+        {
+            std::string info = "info depth 1 score cp " + std::to_string(position.size()) + " pv e2e4";
+            return Utils::lc0_cp_to_win(Utils::centipawns(col, std::vector<std::string>{info}) * 100);
+        }
+
+        // The position after `plies` moves, its evaluation and the ones of its moves.
+        inline ::Coro::Task<void> Analyse(::Coro::Engine &engine, int plies, bool &ok, size_t &done)
+        {
+            ::Position pos {};
+            for (int i = 0; i < plies; i++) pos.DoMove(pos.GetMoves().begin()[i % pos.GetMoves().size()]);
+            const auto fen = pos.fen();
+            auto moves = pos.GetMoves();
+
+            auto eval = co_await engine.Eval(pos);
+            auto evals = co_await engine.EvalMoves(moves, pos);
+            ok &= eval == Expected("fen " + fen, pos.side_to_move()) && evals.size() == moves.size();
+            for (size_t i = 0; i < moves.size(); i++) {
+                Notation::MoveBuffer lan;
+                Notation::to_lan(moves.begin()[i], lan);
+                ok &= evals[i] == Expected("fen " + fen + " moves " + std::string(lan), ~pos.side_to_move());
+            }
+            done++;
+        }
+
+        inline ::Coro::Task<std::string> BestMove(::Coro::Engine &engine, std::string position, size_t &ended)
+        {
+            auto result = co_await engine.Search(std::move(position));
+            ended++;
+            co_return result.bestmove;
+        }
+
+        // The searches of a crashing engine among others: the error reaches us once every search ended.
+        inline ::Coro::Task<void> Crash(::Coro::Engine &engine, size_t &ended, std::string &error)
+        {
+            std::vector<::Coro::Task<std::string>> searches;
+            for (int i = 0; i < 10; i++) {
+                searches.push_back(BestMove(engine, "fen ok", ended));
+                if (i == 5) searches.push_back(BestMove(engine, "crash", ended));
+            }
+            try {
+                co_await ::Coro::All(std::move(searches));
+            } catch (const std::runtime_error &e) {
+                error = e.what();
+            }
+        }
+
+        // The eval of a child is the search of the move of its parent, the best move and the eval of a
+        // position are the same search, the fullmove number does not matter, the depth does.
+        inline ::Coro::Task<void> Shared(::Coro::Engine &engine, bool &ok)
+        {
+            ::Position pos {};
+            ::Position child {};
+            const auto e4 = Utils::long_alg_to_move(child, "e2e4");
+            child.DoMove(e4);
+            ::Position later("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 5");
+
+            std::vector<::Coro::Task<double>> evals;
+            evals.push_back(engine.Eval(child));
+            evals.push_back(engine.EvalMove(e4, pos));
+            evals.push_back(engine.Eval(pos));
+            evals.push_back(engine.Eval(later));
+            evals.push_back(engine.At(engine.Depth() + 1).Eval(pos));
+            auto results = co_await ::Coro::All(std::move(evals));
+            ok &= results[0] == results[1] && results[2] == results[3];
+            ok &= co_await engine.GetBestMove(pos) == "e2e4";
+        }
+
+        inline ::Coro::Task<void> Throw()
+        {
+            throw std::runtime_error("thrown");
+            co_return;
+        }
+    }
+}
+
+int test_coro()
+{
+    {
+        std::cout << "[Test][coro] coroutines share the engines, their results are the searches' - ";
+        Reactor::Loop loop({.argv = Test::Reactor::FakeEngine(), .engines = 3});
+        Coro::Scheduler scheduler(loop);
+        Coro::Engine engine(loop, 10);
+        bool ok = true;
+        size_t done = 0;
+        for (int i = 0; i < 200; i++) scheduler.Spawn(Test::Coro::Analyse(engine, i % 40, ok, done));
+        ok &= scheduler.active() == 200;
+        scheduler.Run();
+        ok &= done == 200 && scheduler.active() == 0 && !loop.pending() && loop.alive() == 3;
+
+        ::Position pos {};
+        ok &= scheduler.Run(engine.GetBestMove(pos)) == "e2e4";
+        ok &= scheduler.Run(engine.Eval(pos)) == Test::Coro::Expected("fen " + pos.fen(), Stockfish::WHITE);
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][coro] errors reach the awaiter once every search ended, searches are shared - ";
+        Reactor::Loop loop({.argv = Test::Reactor::FakeEngine(), .engines = 3});
+        Coro::Scheduler scheduler(loop);
+        Coro::Engine engine(loop, 10);
+        size_t ended = 0;
+        std::string error;
+        scheduler.Run(Test::Coro::Crash(engine, ended, error));
+        bool ok = ended == 10 && error == "engine exited" && loop.alive() == 2;
+
+        // identical searches are run once, even while they run; the oldest results are forgotten.
+        Coro::Searches searches(3);
+        Coro::Engine shared(loop, 10, &searches);
+        scheduler.Run(Test::Coro::Shared(shared, ok));
+        ok &= searches.asked() == 6 && searches.searched() == 3;
+        ::Position pos {};
+        for (const auto depth : {1, 2, 3, 10}) scheduler.Run(shared.At(depth).Eval(pos));
+        ok &= searches.asked() == 10 && searches.searched() == 7;
+
+        // a task that ends without a search, one that throws.
+        ok &= scheduler.Run(Test::Coro::BestMove(engine, "fen ok", ended)) == "e2e4";
+        scheduler.Spawn(Test::Coro::Throw());
+        try {
+            scheduler.Run();
+            ok = false;
+        } catch (const std::runtime_error &e) {
+            ok &= std::string(e.what()) == "thrown" && scheduler.active() == 0;
+        }
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+//
+//  engine_plan.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/plan.hpp"
+
+namespace Test {
+    namespace Plan {
+        inline bool Is(const ::Plan::Layout &l, int engines, int threads, int hash_mb)
+        {
+            return l.engines == engines && l.threads == threads && l.hash_mb == hash_mb;
+        }
+    }
+}
+
+int test_plan()
+{
+    {
+        std::cout << "[Test][plan] shallow searches get an engine per core, a deep one every core - ";
+        using Plan::Workload;
+        bool ok = Test::Plan::Is(Plan::Make(Workload::Shallow, {.cores = 16}), 16, 1, 16);
+        ok &= Test::Plan::Is(Plan::Make(Workload::Deep, {.cores = 16}), 1, 16, 256);
+        ok &= Test::Plan::Is(Plan::Make(Workload::Shallow, {.cores = 8, .hash_mb = 1000}), 8, 1, 64);
+        ok &= Test::Plan::Is(Plan::Make(Workload::Deep, {.cores = 8, .hash_mb = 1000}), 1, 8, 512);
+
+        // the overrides, the rest of the budget split around them.
+        ok &= Test::Plan::Is(Plan::Make(Workload::Shallow, {.cores = 16, .engines = 4}), 4, 4, 64);
+        ok &= Test::Plan::Is(Plan::Make(Workload::Deep, {.cores = 16, .threads = 2}), 8, 2, 32);
+        ok &= Test::Plan::Is(Plan::Make(Workload::Shallow, {.cores = 4, .engines = 6}), 6, 1, 8);
+        ok &= Test::Plan::Is(Plan::Make(Workload::Shallow, {.cores = 4, .engines = 2, .threads = 3}), 2, 3, 32);
+        ok &= Test::Plan::Is(Plan::Make(Workload::Shallow, {.cores = 2, .hash_mb = 1, .engines = 4}), 4, 1, 1);
+        const auto here = Plan::Make(Workload::Deep, {});
+        ok &= here.engines == 1 && here.threads == Plan::Cores();
+
+        Plan::Workload w {};
+        ok &= Plan::ParseWorkload("deep", w) && w == Workload::Deep && std::string(Plan::Name(w)) == "deep";
+        ok &= Plan::ParseWorkload("shallow", w) && w == Workload::Shallow && !Plan::ParseWorkload("wide", w);
+        ok &= Plan::Describe({4, 2, 64}) == "4 engines x 2 threads, 64 MB hash each"
+           && Plan::Describe({1, 1, 16}) == "1 engine x 1 thread, 16 MB hash";
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][plan] the candidates split every core evenly - ";
+        std::vector<std::pair<int, int>> split;
+        for (const auto& l : Plan::Candidates({.cores = 12})) split.emplace_back(l.engines, l.threads);
+        bool ok = split == std::vector<std::pair<int, int>>{{1, 12}, {2, 6}, {4, 3}, {8, 1}, {12, 1}};
+        ok &= Plan::Candidates({.cores = 1}).size() == 1 && Plan::Candidates({.cores = 1})[0].threads == 1;
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    return 0;
+}
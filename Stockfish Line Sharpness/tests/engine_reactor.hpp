@@ -0,0 +1,194 @@
+//
+//  engine_reactor.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../src/reactor.hpp"
+
+namespace Test {
+    namespace Reactor {
+        // A UCI engine in a few lines of shell: the score of a search is the length of its position,
+        // a position starting with "crash" makes it exit, one starting with "flaky" unless it is its first,
+        // one starting with "hang" hang up without exiting.
+        inline std::vector<std::string> FakeEngine()
+        {
+            return {"/bin/sh", "-c",
+                "while read -r cmd rest; do case \"$cmd\" in "
+                "uci) echo 'id name fake'; echo uciok ;; "
+                "isready) echo readyok ;; "
+                "position) pos=\"$rest\" ;; "
+                "go) case \"$pos\" in crash*) exit 1 ;; flaky*) [ -n \"$n\" ] && sleep 0.1 && exit 1 ;; hang*) exec <&- >&-; sleep 3; exit 1 ;; esac; n=1; "
+                "echo \"info depth 1 score cp ${#pos} pv e2e4\"; echo 'bestmove e2e4 ponder e7e5' ;; "
+                "quit) exit 0 ;; "
+                "esac; done"};
+        }
+
+        // The same engine, whose searches tell which process ran them (seldepth) and count 100 nodes.
+        inline std::vector<std::string> CountingEngine()
+        {
+            return {"/bin/sh", "-c",
+                "while read -r cmd rest; do case \"$cmd\" in "
+                "uci) echo 'id name counting'; echo uciok ;; "
+                "isready) echo readyok ;; "
+                "go) echo \"info depth 1 seldepth $$ nodes 100 score cp 0 pv e2e4\"; echo 'bestmove e2e4' ;; "
+                "quit) exit 0 ;; "
+                "esac; done"};
+        }
+
+        inline std::string Process(const ::Reactor::Result &r)
+        {
+            const auto at = r.info.find("seldepth ");
+            return at == std::string::npos ? "" : r.info.substr(at + 9, r.info.find(' ', at + 9) - at - 9);
+        }
+
+        // Polls until nothing is pending, false if it takes more than a few seconds.
+        inline bool Drain(::Reactor::Loop &loop)
+        {
+            for (int i = 0; i < 10'000 && loop.pending(); i++) loop.Poll(1);
+            return !loop.pending();
+        }
+    }
+}
+
+int test_reactor()
+{
+    {
+        std::cout << "[Test][reactor] one thread drives every engine, every search ends once - ";
+        Reactor::Loop loop({.argv = Test::Reactor::FakeEngine(), .engines = 4, .options = {{"Threads", "1"}}});
+        const size_t searches = 400;
+        std::vector<int> ends(searches);
+        std::vector<std::string> infos(searches);
+        bool ok = true;
+        for (size_t i = 0; i < searches; i++) {
+            loop.Submit({"fen " + std::string(1 + i % 50, 'x'), 10, [&, i](const Reactor::Result &r) {
+                ends[i]++;
+                infos[i] = r.info;
+                ok &= r.bestmove == "e2e4" && r.error.empty();
+                // a search can be submitted from the end of another.
+                if (i == 0) loop.Submit({"fen chained", 10, [&](const Reactor::Result &r) { ok &= r.info.find("cp 11 ") != std::string::npos; }});
+            }});
+        }
+        ok &= Test::Reactor::Drain(loop) && loop.alive() == 4;
+        for (size_t i = 0; i < searches; i++)
+            ok &= ends[i] == 1 && infos[i] == "info depth 1 score cp " + std::to_string(5 + i % 50) + " pv e2e4";
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][reactor] engines that exit fail their search, the others go on - ";
+        Reactor::Loop loop({.argv = Test::Reactor::FakeEngine(), .engines = 3});
+        size_t failed = 0, passed = 0;
+        auto count = [&](const Reactor::Result &r) { (r.error.empty() ? passed : failed)++; };
+        loop.Submit({"crash", 10, count});
+        for (int i = 0; i < 20; i++) loop.Submit({"fen ok", 10, count});
+        bool ok = Test::Reactor::Drain(loop) && failed == 1 && passed == 20 && loop.alive() == 2;
+
+        // once none is left, searches fail right away.
+        for (int i = 0; i < 2; i++) loop.Submit({"crash", 10, count});
+        ok &= Test::Reactor::Drain(loop) && loop.alive() == 0;
+        loop.Submit({"fen ok", 10, count});
+        ok &= Test::Reactor::Drain(loop) && failed == 4 && passed == 20;
+
+        Reactor::Loop missing({.argv = {"/nonexistent/engine"}, .engines = 2});
+        std::string error;
+        missing.Submit({"fen ok", 10, [&](const Reactor::Result &r) { error = r.error; }});
+        ok &= Test::Reactor::Drain(missing) && !error.empty() && missing.alive() == 0;
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][reactor] an engine that hangs up but does not exit stalls no other - ";
+        bool ok = true;
+        {
+            Reactor::Loop loop({.argv = Test::Reactor::FakeEngine(), .engines = 2});
+            size_t failed = 0, passed = 0;
+            auto count = [&](const Reactor::Result &r) { (r.error.empty() ? passed : failed)++; };
+            loop.Submit({"hang", 10, count});
+            for (int i = 0; i < 20; i++) loop.Submit({"fen ok", 10, count});
+            const auto start = std::chrono::steady_clock::now();
+            ok &= Test::Reactor::Drain(loop) && failed == 1 && passed == 20 && loop.alive() == 1;
+            ok &= std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500);
+        }
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][reactor] a spare takes the place of an engine that exits, runs its search again, and is replaced - ";
+        Reactor::Loop loop({.argv = Test::Reactor::FakeEngine(), .engines = 2, .spares = 1});
+        size_t failed = 0, passed = 0;
+        auto count = [&](const Reactor::Result &r) { (r.error.empty() ? passed : failed)++; };
+        for (int i = 0; i < 20; i++) loop.Submit({"fen ok", 10, count});
+        // the engine that searched the position is the one that crashes on its move.
+        loop.Submit({"fen ok", 10, count, 7, 7});
+        bool ok = Test::Reactor::Drain(loop) && passed == 21 && loop.alive() == 2 && loop.spares() == 1;
+        // it exits in the middle of the search: the spare takes its groups, and runs the search again.
+        loop.Submit({"flaky", 10, count, 8, 7});
+        for (int i = 0; i < 10; i++) loop.Submit({"fen ok", 10, count});
+        ok &= Test::Reactor::Drain(loop) && failed == 0 && passed == 32 && loop.alive() == 2
+           && loop.replaced() == 1 && loop.retried() == 1;
+        loop.Poll(0);
+        ok &= loop.spares() == 1 && loop.engines() == 2;
+
+        // a search that takes down the engine it is run again on fails, once.
+        loop.Submit({"crash", 10, count});
+        ok &= Test::Reactor::Drain(loop) && failed == 1 && passed == 32 && loop.retried() == 2;
+
+        // an engine that cannot start is not started again: the spare goes with the engines.
+        Reactor::Loop failing({.argv = {"/bin/sh", "-c", "exit 1"}, .engines = 2, .spares = 2});
+        failing.Submit({"fen ok", 10, count});
+        for (int i = 0; i < 100 && (failing.alive() || failing.spares()); i++) failing.Poll(10);
+        ok &= failing.alive() == 0 && failing.spares() == 0;
+        ok &= Test::Reactor::Drain(failing) && failed == 2 && failing.alive() == 0 && failing.spares() == 0;
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][reactor] the searches of a group stay on one engine, unless another one is idle - ";
+        Reactor::Loop loop({.argv = Test::Reactor::CountingEngine(), .engines = 3});
+        const uint64_t groups = 20, per_group = 10;
+        std::map<uint64_t, std::string> by_key;
+        std::map<uint64_t, std::map<std::string, size_t>> by_group;
+        for (uint64_t g = 1; g <= groups; g++) {
+            for (uint64_t i = 0; i < per_group; i++) {
+                const uint64_t key = g * 1000 + i;
+                loop.Submit({"fen x", 10, [&, g, key](const Reactor::Result &r) {
+                    by_key[key] = Test::Reactor::Process(r);
+                    by_group[g][by_key[key]]++;
+                }, key, g});
+            }
+        }
+        bool ok = Test::Reactor::Drain(loop) && by_key.size() == groups * per_group;
+        // a search runs off the engine of its group only when it is stolen by an idle one.
+        size_t elsewhere = 0;
+        for (const auto& [g, engines] : by_group) {
+            size_t most = 0;
+            for (const auto& [pid, n] : engines) most = std::max(most, n);
+            elsewhere += per_group - most;
+        }
+        ok &= elsewhere <= loop.stolen();
+
+        // the moves of a position go to the engine that searched it, when it is free.
+        for (const uint64_t key : {1003, 2005, 7000, 12009, 20001}) {
+            std::string pid;
+            loop.Submit({"fen x moves e2e4", 10, [&](const Reactor::Result &r) { pid = Test::Reactor::Process(r); }, key + 1, key});
+            ok &= Test::Reactor::Drain(loop) && !pid.empty() && pid == by_key[key];
+        }
+        ok &= loop.completed() == groups * per_group + 5 && loop.nodes() == 100 * loop.completed();
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,55 @@
+//
+//  fen_bench.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/fen.hpp"
+#include "notation_bench.hpp"
+
+// Compares the old loading path (checkFEN followed by Position::set) with the single pass parser.
+int bench_fen()
+{
+    using namespace Stockfish;
+    static const int ROUNDS = 20;
+
+    auto fens = Bench::random_fens(5000);
+    StateInfo si, ref_si;
+    Position pos, ref;
+
+    for (const auto& fen : fens) {
+        ref.set(fen, false, &ref_si);
+        if (parseFEN(fen, pos, &si) != FEN_OK || pos.fen() != ref.fen() || pos.key() != ref.key()) {
+            std::cout << "[Bench][fen] mismatch for " << fen << std::endl;
+            std::abort();
+        }
+    }
+
+    size_t n_fens = fens.size() * ROUNDS;
+    uint64_t sink {};
+    auto two_pass = Bench::moves_per_second(n_fens, [&]{
+        for (int r = 0; r < ROUNDS; r++)
+            for (const auto& fen : fens) {
+                if (checkFEN(fen.c_str()) < 0) continue;
+                sink += ref.set(fen, false, &ref_si).key();
+            }
+    });
+    auto single_pass = Bench::moves_per_second(n_fens, [&]{
+        for (int r = 0; r < ROUNDS; r++)
+            for (const auto& fen : fens) {
+                if (parseFEN(fen, pos, &si) != FEN_OK) continue;
+                sink += pos.key();
+            }
+    });
+
+    std::cout << "[Bench][fen] checkFEN + Position::set: " << two_pass << " positions/s" << '\n';
+    std::cout << "[Bench][fen] parseFEN: " << single_pass << " positions/s" << '\n';
+    std::cout << "(checksum " << sink << ")" << std::endl;
+
+    return 0;
+}
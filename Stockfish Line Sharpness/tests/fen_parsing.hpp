@@ -0,0 +1,105 @@
+//
+//  fen_parsing.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/fen.hpp"
+#include "../src/position.hpp"
+
+namespace Test {
+    namespace Fen {
+        // Each of these trips a different check of checkFEN.
+        static const std::vector<std::string> Malformed {
+            "rnbqkbnr/pppppppp/9/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",     // not a digit
+            "rnbqkbnr/pppppppp/8/8/4P4/8/PPPP1PPP/RNBQKBNR w KQkq - 0 1",   // column overflow
+            "rnbqkbnr/ppppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",    // missing separator
+            "rnbqkbnr pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",     // wrong separator
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR",                  // missing fields
+            "rnbqkbnr/pppzpppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",     // unknown piece
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR x KQkq - 0 1",     // side to move
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR wKQkq - 0 1",      // missing space
+            "kkk5/8/8/8/8/8/8/4K3 w - - 0 1",                               // too many kings
+            "4k3/8/8/8/8/8/QQQQQQQQ/QQQK4 w - - 0 1",                       // too many queens
+            "4k3/8/8/8/8/8/NNNNNNNN/NNNK4 w - - 0 1",                       // too many knights
+            "4k3/8/8/8/8/8/RRRRRRRR/RRRK4 w - - 0 1",                       // too many rooks
+            "4k3/8/8/8/8/8/B1B1B1B1/1B1B1BK1 w - - 0 1",                    // too many light bishops
+            "P3k3/8/8/8/8/8/8/4K3 w - - 0 1",                               // pawn on the last rank
+            "4k3/8/8/8/8/8/8/p3K3 w - - 0 1",                               // pawn on the first rank
+            "rnbqkbnr/pppppppp/8/8/P7/P7/P1PPPPP1/RNBQKBNR w KQkq - 0 1",   // impossible pawn structure
+            "4k3/8/8/8/8/8/8/3K4 w K - 0 1",                                // castling without king or rook
+            "r7/8/8/8/8/8/8/4K2k w q - 0 1",                                // castling (q is checked against k)
+            "4k3/8/8/8/8/8/8/4K3 w X - 0 1",                                // castling character
+            "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e4 0 1",  // en passant rank
+            "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq z3 0 1",  // en passant file
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 x",     // move counters
+        };
+        static const std::vector<std::string> Valid {
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+            "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+            "1r2k2r/1pPp1p2/1b3qpn/4pP1p/pPB1P1bn/3P1NP1/P2BQ1NP/R3K2R b KQk b3 0 1",
+            "rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 3",  // capturable en passant
+            "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1",  // not capturable en passant
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -",         // no move counters
+            "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 12 40",
+        };
+    }
+
+    bool FenMatchesCheckFEN(const std::vector<std::string> &fens)
+    {
+        Stockfish::StateInfo si;
+        Stockfish::Position pos;
+        for (const auto& fen : fens) {
+            int expected = checkFEN(fen.c_str());
+            FenError err = parseFEN(fen, pos, &si);
+            std::cout << "\t" << fen << "\n\t\tcheckFEN: " << expected << " parseFEN: " << err
+            << " (" << fen_error_string(err) << ")" << std::endl;
+            if (expected == 0 || err != expected) return false;
+        }
+        return true;
+    }
+
+    bool FenSetsPosition(const std::vector<std::string> &fens)
+    {
+        Stockfish::StateInfo si, ref_si;
+        Stockfish::Position pos, ref;
+        for (const auto& fen : fens) {
+            FenError err = parseFEN(fen, pos, &si);
+            ref.set(fen, false, &ref_si);
+            std::cout << "\t" << fen << "\n\t\tparsed: " << (err == FEN_OK ? pos.fen() : fen_error_string(err)) << std::endl;
+            if (checkFEN(fen.c_str()) != 0 || err != FEN_OK) return false;
+            if (pos.fen() != ref.fen() || pos.key() != ref.key() || pos.game_ply() != ref.game_ply()) return false;
+        }
+        return true;
+    }
+}
+
+int test_fen()
+{
+    // makes sure the tables are initialized.
+    ::Position startpos {};
+
+    std::cout << "Malformed FENs give the same error as checkFEN: \n";
+    if (!Test::FenMatchesCheckFEN(Test::Fen::Malformed)) {
+        std::cout << "Failed" << std::endl; std::abort();
+    } std::cout << "Passed" << std::endl;
+
+    std::cout << "Valid FENs set the same position as Position::set(): \n";
+    if (!Test::FenSetsPosition(Test::Fen::Valid)) {
+        std::cout << "Failed" << std::endl; std::abort();
+    } std::cout << "Passed" << std::endl;
+
+    std::cout << "Positions without kings are rejected: \n";
+    {
+        Stockfish::StateInfo si;
+        Stockfish::Position pos;
+        if (parseFEN("8/8/8/8/8/8/8/8 w - - 0 1", pos, &si) != FEN_PIECE) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+//
+//  ingest_bench.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/ingest.hpp"
+#include "../src/perft.hpp"
+#include "notation_bench.hpp"
+
+// Splitting a big EPD file in records: std::getline against the memory mapped file scanned with find_byte,
+// single and multi threaded. The file is read once before timing, so all of them read from the page cache.
+int bench_ingest()
+{
+    static const size_t TARGET_MB = 64;
+    const int threads = std::max(1u, std::thread::hardware_concurrency());
+    auto path = (std::filesystem::temp_directory_path() / "line_sharpness_ingest_bench.epd").string();
+
+    {
+        auto fens = Bench::random_fens(5000);
+        std::ofstream os(path);
+        for (size_t written = 0; written < TARGET_MB << 20; )
+            for (const auto& fen : fens) {
+                os << fen << " ;id \"bench\"\n";
+                written += fen.size() + 13;
+            }
+    }
+
+    auto mb_per_second = [](size_t bytes, auto && f) {
+        auto start = std::chrono::steady_clock::now();
+        size_t records = f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return std::make_pair(records, static_cast<double>(bytes) / (1 << 20) / elapsed.count());
+    };
+
+    Ingest::MappedFile file(path);
+    const auto text = file.data();
+
+    auto [getline_records, getline_mbs] = mb_per_second(text.size(), [&] {
+        std::ifstream is(path);
+        std::string line;
+        size_t n {};
+        while (std::getline(is, line)) n += !line.empty();
+        return n;
+    });
+    auto [mapped_records, mapped_mbs] = mb_per_second(text.size(), [&] {
+        size_t n {};
+        Ingest::for_each_record(text, Ingest::Format::Lines, [&](std::string_view) { n++; });
+        return n;
+    });
+    auto [chunked_records, chunked_mbs] = mb_per_second(text.size(), [&] {
+        std::atomic<size_t> n {0};
+        Ingest::parallel_for_each_chunk(text, Ingest::Format::Lines, threads, 1 << 20,
+                                        [&](size_t, const std::vector<std::string_view> &r) { n += r.size(); });
+        return n.load();
+    });
+
+    if (getline_records != mapped_records || mapped_records != chunked_records) {
+        std::cout << "[Bench][ingest] record count mismatch: " << getline_records << " " << mapped_records
+        << " " << chunked_records << std::endl;
+        std::abort();
+    }
+
+    std::cout << "[Bench][ingest] " << (text.size() >> 20) << "MB, " << mapped_records << " records" << '\n';
+    std::cout << "[Bench][ingest] std::getline: " << getline_mbs << " MB/s" << '\n';
+    std::cout << "[Bench][ingest] mmap + find_byte: " << mapped_mbs << " MB/s" << '\n';
+    std::cout << "[Bench][ingest] mmap + chunks (" << threads << " threads): " << chunked_mbs << " MB/s" << '\n';
+
+    // with the positions parsed as well (parseFEN + count_legal).
+    auto [stream_positions, stream_mbs] = mb_per_second(text.size(), [&] {
+        std::ifstream is(path);
+        return Perft::branching_stats(is).positions;
+    });
+    auto [mapped_positions, parsed_mbs] = mb_per_second(text.size(), [&] {
+        return Perft::branching_stats(text, threads).positions;
+    });
+    std::cout << "[Bench][ingest] branching stats, stream: " << stream_mbs << " MB/s, mapped: " << parsed_mbs
+    << " MB/s (" << mapped_positions << " positions)" << std::endl;
+
+    std::remove(path.c_str());
+    return stream_positions == mapped_positions ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+//
+//  ingest_splitting.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../src/ingest.hpp"
+#include "../src/pgn.hpp"
+
+int test_ingest()
+{
+    {
+        std::cout << "[Test][ingest] find_byte agrees with memchr at every offset - ";
+        std::string text(200, 'x');
+        bool ok = true;
+        for (size_t at = 0; at < text.size(); at++) {
+            text[at] = '\n';
+            for (size_t from = 0; from <= at; from += 7) {
+                const char *found = Ingest::find_byte(text.data() + from, text.data() + text.size(), '\n');
+                ok &= found == std::memchr(text.data() + from, '\n', text.size() - from);
+            }
+            ok &= Ingest::find_byte(text.data() + at + 1, text.data() + text.size(), '\n') == text.data() + text.size();
+            text[at] = 'x';
+        }
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    const std::string lines = "first\r\n\nsecond line\nthird\n\n";
+    const std::string games = "[Event \"1\"]\n[Site \"?\"]\n\n1. e4 e5 {a comment\n\n[not a tag]} 1-0\n\n"
+                              "[Event \"2\"]\n\n1. d4 *\n\r\n[Event \"3\"]\n\n1. c4 *\n";
+    {
+        std::cout << "[Test][ingest] records - ";
+        std::vector<std::string_view> records;
+        Ingest::for_each_record(lines, Ingest::Format::Lines, [&](std::string_view r) { records.push_back(r); });
+        bool ok = records == std::vector<std::string_view>{"first", "second line", "third"};
+
+        std::vector<std::string> events;
+        Ingest::for_each_record(games, Ingest::Format::Pgn, [&](std::string_view r) {
+            Pgn::Game game;
+            if (Pgn::Parse(r, game)) events.push_back(game.Tag("Event") + ":" + std::to_string(game.plies.size()));
+        });
+        ok &= events == std::vector<std::string>{"1:2", "2:1", "3:1"};
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][ingest] chunks hold every record exactly once, whatever their size - ";
+        bool ok = true;
+        for (size_t chunk = 1; chunk < games.size() + 2; chunk++) {
+            std::vector<std::vector<std::string_view>> by_chunk((games.size() + chunk - 1) / chunk);
+            Ingest::parallel_for_each_chunk(games, Ingest::Format::Pgn, 3, chunk,
+                                            [&](size_t idx, const std::vector<std::string_view> &r) { by_chunk[idx] = r; });
+            std::vector<std::string_view> all, expected;
+            for (const auto& c : by_chunk) all.insert(all.end(), c.begin(), c.end());
+            Ingest::for_each_record(games, Ingest::Format::Pgn, [&](std::string_view r) { expected.push_back(r); });
+            ok &= all == expected;
+        }
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+//
+//  journal_resume.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/journal.hpp"
+
+namespace Test {
+    namespace Journal {
+        inline Output::Record Record(int i)
+        {
+            Output::Record r {};
+            r.id = "pos" + std::to_string(i);
+            r.fen = "8/8/8/8/8/8/8/K6k w - - 0 " + std::to_string(i + 1);
+            r.depth = 20;
+            r.legal_moves = 3;
+            r.eval = 0.25 * i;
+            r.sharpness = 1.0 / (i + 1);
+            if (i % 2) r.complexity = 0.5;
+            r.seconds = 12.5;
+            r.moves = {{"Kb1", "a1b1", 0.1, 0.15, "good"}, {"Ka2", "a1a2", -0.4, 0.65, "bad"},
+                       {"Kb2", "a1b2", 0, 0.25, "inaccuracy"}};
+            return r;
+        }
+
+        inline bool Same(const Output::Record &a, const Output::Record &b)
+        {
+            bool same = a.id == b.id && a.fen == b.fen && a.depth == b.depth && a.legal_moves == b.legal_moves
+                     && a.eval == b.eval && a.sharpness == b.sharpness && a.complexity == b.complexity
+                     && a.seconds == b.seconds && a.error == b.error && a.moves.size() == b.moves.size();
+            for (size_t j = 0; same && j < a.moves.size(); j++)
+                same = a.moves[j].san == b.moves[j].san && a.moves[j].lan == b.moves[j].lan
+                    && a.moves[j].eval == b.moves[j].eval && a.moves[j].loss == b.moves[j].loss
+                    && a.moves[j].verdict == b.moves[j].verdict;
+            return same;
+        }
+    }
+}
+
+int test_journal()
+{
+    const auto path = (std::filesystem::temp_directory_path() / "line_sharpness_journal_test.bin").string();
+    const std::string run = "batch depth 20";
+
+    {
+        std::cout << "[Test][journal] records read back on resume - ";
+        {
+            ::Journal::Log log(path, run, false, {.sync_every = 7});
+            for (int i = 0; i < 100; i++) log.Append(uint64_t(i), Test::Journal::Record(i));
+            auto failed = Test::Journal::Record(100);
+            failed.error = "engine died";
+            log.Append(100, failed);
+        }
+        ::Journal::Log log(path, run, true);
+        bool ok = log.resumed() == 100 && !log.Find(100, Test::Journal::Record(100).fen);
+        for (int i = 0; ok && i < 100; i++) {
+            auto r = log.Find(uint64_t(i), Test::Journal::Record(i).fen);
+            ok = r && Test::Journal::Same(*r, Test::Journal::Record(i)) && !log.Find(uint64_t(i), "another fen");
+        }
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][journal] a torn last record is dropped, appending goes on after the last good one - ";
+        auto size = std::filesystem::file_size(path);
+        std::filesystem::resize_file(path, size - 5);
+        bool ok;
+        {
+            ::Journal::Log log(path, run, true);
+            ok = log.resumed() == 99 && !log.Find(99, Test::Journal::Record(99).fen);
+            log.Append(99, Test::Journal::Record(99));
+        }
+        {
+            // garbage after the last record, as left by a crash in the middle of a write.
+            std::ofstream os(path, std::ios::app | std::ios::binary);
+            os << "\x10\x00\x00\x00garbage";
+        }
+        ::Journal::Log log(path, run, true);
+        ok &= log.resumed() == 100 && log.Find(99, Test::Journal::Record(99).fen);
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][journal] other runs are rejected, no resume starts over - ";
+        bool ok = false;
+        try { ::Journal::Log log(path, "line depth 20", true); } catch (const std::runtime_error &) { ok = true; }
+        {
+            ::Journal::Log log(path, "line depth 20", false);
+            ok &= log.resumed() == 0;
+        }
+        ::Journal::Log log(path, "line depth 20", true);
+        ok &= log.resumed() == 0;
+        std::filesystem::remove(path);
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    return 0;
+}
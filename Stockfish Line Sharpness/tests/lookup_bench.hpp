@@ -0,0 +1,69 @@
+//
+//  lookup_bench.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/canonical.hpp"
+#include "../src/lookup.hpp"
+#include "../src/position.hpp"
+#include "../src/store.hpp"
+#include "notation_bench.hpp"
+
+// Index lookups over a store of a million distinct positions: the key search alone, then the whole record.
+int bench_lookup()
+{
+    using namespace Stockfish;
+    static const size_t POSITIONS = 1'000'000, QUERIES = 2'000'000;
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto store_path = (dir / "line_sharpness_lookup_bench.bin").string();
+    const auto index_path = (dir / "line_sharpness_lookup_bench.idx").string();
+
+    auto fens = Bench::random_fens(POSITIONS);
+    std::vector<Key> keys;
+    {
+        Store::Writer writer(store_path);
+        Output::Record r {};
+        r.depth = 15;
+        for (const auto& fen : fens) {
+            ::Position pos(fen);
+            writer.Append(pos, r);
+            keys.push_back(Canonical::key(pos));
+        }
+    }
+
+    Store::Reader store(store_path);
+    auto start = std::chrono::steady_clock::now();
+    Lookup::Build(store, index_path);
+    std::chrono::duration<double> build = std::chrono::steady_clock::now() - start;
+    Lookup::Index index(index_path);
+
+    PRNG rng(5);
+    size_t found {};
+    auto find_qps = Bench::moves_per_second(QUERIES, [&]{
+        for (size_t i = 0; i < QUERIES; i++) {
+            // every other query is a miss.
+            Key key = keys[rng.rand<uint64_t>() % keys.size()] ^ (i & 1);
+            found += index.Find(key) != nullptr;
+        }
+    });
+
+    std::vector<std::unique_ptr<::Position>> positions;
+    for (size_t i = 0; i < 1000; i++) positions.push_back(std::make_unique<::Position>(fens[i * 997 % fens.size()]));
+    auto record_qps = Bench::moves_per_second(QUERIES / 10, [&]{
+        for (size_t i = 0; i < QUERIES / 10; i++) found += Lookup::Find(store, index, *positions[i % positions.size()]).has_value();
+    });
+
+    std::cout << "[Bench][lookup] " << index.size() << " positions, index built in " << build.count() << "s" << '\n';
+    std::cout << "[Bench][lookup] key search: " << 1e9 / find_qps << " ns/query (" << found << " found)" << '\n';
+    std::cout << "[Bench][lookup] FEN to record: " << 1e6 / record_qps << " us/query" << std::endl;
+
+    std::filesystem::remove(store_path);
+    std::filesystem::remove(index_path);
+    return 0;
+}
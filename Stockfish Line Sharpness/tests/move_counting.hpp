@@ -0,0 +1,102 @@
+//
+//  move_counting.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/mini_stock/movegen.h"
+#include "../src/mini_stock/position.h"
+#include "../src/perft.hpp"
+
+namespace Test {
+    // Breakdown of a MoveList<LEGAL>, to check count_legal() against.
+    Stockfish::MoveCounts GeneratedCounts(const Stockfish::Position &pos)
+    {
+        using namespace Stockfish;
+        MoveCounts mc {};
+        for (const auto m : MoveList<LEGAL>(pos)) {
+            mc.total++;
+            mc.captures   += pos.capture(m);
+            mc.promotions += type_of(m) == PROMOTION;
+            mc.castling   += type_of(m) == CASTLING;
+            mc.enPassant  += type_of(m) == EN_PASSANT;
+        }
+        return mc;
+    }
+
+    // Walks the tree up to depth and compares the counts in every node.
+    bool CountsMatch(Stockfish::Position &pos, int depth, std::string &failed)
+    {
+        using namespace Stockfish;
+        auto expected = GeneratedCounts(pos);
+        auto counted = count_legal(pos);
+        if (   expected.total != counted.total || expected.captures != counted.captures
+            || expected.promotions != counted.promotions || expected.castling != counted.castling
+            || expected.enPassant != counted.enPassant) {
+            failed = pos.fen();
+            return false;
+        }
+        if (depth == 0) return true;
+
+        StateInfo st;
+        for (const auto m : MoveList<LEGAL>(pos)) {
+            pos.do_move(m, st);
+            bool ok = CountsMatch(pos, depth - 1, failed);
+            pos.undo_move(m);
+            if (!ok) return false;
+        }
+        return true;
+    }
+}
+
+int test_count_legal()
+{
+    using namespace Stockfish;
+    // makes sure the tables are initialized.
+    ::Position startpos {};
+
+    std::cout << "count_legal() agrees with MoveList<LEGAL> on the perft suite (2 plies deep): \n";
+    {
+        std::istringstream is(Perft::StandardSuite);
+        for (const auto& entry : Perft::parse_epd(is)) {
+            StateInfo st;
+            Stockfish::Position pos;
+            std::string failed;
+            pos.set(entry.fen, false, &st);
+            if (!Test::CountsMatch(pos, 2, failed)) {
+                std::cout << "\t" << failed << "\nFailed" << std::endl; std::abort();
+            }
+        }
+    } std::cout << "Passed" << std::endl;
+
+    std::cout << "Branching statistics over a stream of positions: \n";
+    {
+        std::istringstream is(
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1\n"
+            "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - ;D1 48\n"
+            "\n"
+            "not a fen\n"
+            "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1\n");
+        size_t rejected {}, rejected_text {};
+        auto stats = Perft::branching_stats(is, &rejected);
+        // the in memory version, in parallel, gives the same results.
+        auto text_stats = Perft::branching_stats(is.str(), 2, &rejected_text);
+        if (   rejected != rejected_text || text_stats.positions != stats.positions || text_stats.moves != stats.moves
+            || !std::equal(std::begin(stats.histogram), std::end(stats.histogram), std::begin(text_stats.histogram))) {
+            std::cout << "Failed" << std::endl; std::abort();
+        }
+        std::cout << "\tpositions: " << stats.positions << " rejected: " << rejected
+        << " mean: " << stats.mean() << " median: " << stats.percentile(0.5) << std::endl;
+        if (   stats.positions != 3 || rejected != 1 || stats.moves != 20 + 48 + 14
+            || stats.histogram[20] != 1 || stats.histogram[48] != 1 || stats.histogram[14] != 1
+            || stats.castling != 2 || stats.percentile(0.5) != 20 || stats.percentile(1.0) != 48) {
+            std::cout << "Failed" << std::endl; std::abort();
+        }
+    } std::cout << "Passed" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,130 @@
+//
+//  notation_bench.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef notation_bench_hpp
+#define notation_bench_hpp
+
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/notation.hpp"
+#include "../src/mini_stock/movegen.h"
+
+namespace Bench {
+
+    // Random playouts from a few varied positions, to get a realistic mix of moves (castling, promotions,
+    // en passant, disambiguations) rather than just opening moves.
+    inline std::vector<std::string> random_fens(size_t count, uint64_t seed = 1070372)
+    {
+        static const std::vector<std::string> roots {
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+            "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+            "1r2k2r/1pPp1p2/1b3qpn/4pP1p/pPB1P1bn/3P1NP1/P2BQ1NP/R3K2R w KQk - 0 1",
+            "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        };
+
+        PRNG rng(seed);
+        std::vector<std::string> fens;
+        std::deque<Stockfish::StateInfo> states;
+        Stockfish::Position pos;
+
+        while (fens.size() < count) {
+            for (const auto& root : roots) {
+                states.clear();
+                states.emplace_back();
+                pos.set(root, false, &states.back());
+                for (int ply = 0; ply < 80 && fens.size() < count; ply++) {
+                    Stockfish::MoveList<Stockfish::LEGAL> moves(pos);
+                    if (moves.size() == 0) break;
+                    fens.push_back(pos.fen());
+                    states.emplace_back();
+                    pos.do_move(moves[rng.rand<uint64_t>() % moves.size()], states.back());
+                }
+            }
+        }
+        return fens;
+    }
+
+    template<typename F>
+    double moves_per_second(size_t n_moves, F && f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return static_cast<double>(n_moves) / elapsed.count();
+    }
+}
+
+int bench_notation()
+{
+    using namespace Stockfish;
+    static const int ROUNDS = 20;
+
+    auto fens = Bench::random_fens(2000);
+    std::deque<StateInfo> states;
+    std::deque<Position> positions;
+    std::vector<std::vector<Move>> moves;
+    std::vector<std::vector<std::string>> sans, lans;
+    size_t n_moves {};
+
+    for (const auto& fen : fens) {
+        states.emplace_back();
+        positions.emplace_back().set(fen, false, &states.back());
+        auto& pos = positions.back();
+        auto& ms = moves.emplace_back();
+        auto& ss = sans.emplace_back();
+        auto& ls = lans.emplace_back();
+        for (const auto m : MoveList<LEGAL>(pos)) {
+            Notation::MoveBuffer buf;
+            ms.push_back(m);
+            Notation::to_san(pos, m, buf); ss.emplace_back(buf);
+            Notation::to_lan(m, buf); ls.emplace_back(buf);
+            // every legal move must survive the round trip in both notations.
+            if (Notation::from_san(pos, ss.back()) != m || Notation::from_lan(pos, ls.back()) != m) {
+                std::cout << "[Bench][notation] round trip failed: " << ss.back() << " (" << ls.back() << ") in " << fen << std::endl;
+                std::abort();
+            }
+        }
+        n_moves += ms.size();
+    }
+    std::cout << "[Bench][notation] " << positions.size() << " positions, " << n_moves << " moves" << '\n';
+
+    size_t sink {};
+    auto encode_san = Bench::moves_per_second(n_moves * ROUNDS, [&]{
+        Notation::MoveBuffer buf;
+        for (int r = 0; r < ROUNDS; r++)
+            for (size_t i = 0; i < positions.size(); i++)
+                for (const auto m : moves[i]) sink += Notation::to_san(positions[i], m, buf);
+    });
+    auto encode_lan = Bench::moves_per_second(n_moves * ROUNDS, [&]{
+        Notation::MoveBuffer buf;
+        for (int r = 0; r < ROUNDS; r++)
+            for (size_t i = 0; i < positions.size(); i++)
+                for (const auto m : moves[i]) sink += Notation::to_lan(m, buf);
+    });
+    auto decode_san = Bench::moves_per_second(n_moves * ROUNDS, [&]{
+        for (int r = 0; r < ROUNDS; r++)
+            for (size_t i = 0; i < positions.size(); i++)
+                for (const auto& s : sans[i]) sink += Notation::from_san(positions[i], s);
+    });
+    auto decode_lan = Bench::moves_per_second(n_moves * ROUNDS, [&]{
+        for (int r = 0; r < ROUNDS; r++)
+            for (size_t i = 0; i < positions.size(); i++)
+                for (const auto& s : lans[i]) sink += Notation::from_lan(positions[i], s);
+    });
+
+    std::cout << "[Bench][notation] encode SAN: " << encode_san << " moves/s" << '\n';
+    std::cout << "[Bench][notation] encode LAN: " << encode_lan << " moves/s" << '\n';
+    std::cout << "[Bench][notation] decode SAN: " << decode_san << " moves/s" << '\n';
+    std::cout << "[Bench][notation] decode LAN: " << decode_lan << " moves/s" << '\n';
+    std::cout << "(checksum " << sink << ")" << std::endl;
+
+    return 0;
+}
+
+#endif /* notation_bench_hpp */
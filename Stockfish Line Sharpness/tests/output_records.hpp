@@ -0,0 +1,72 @@
+//
+//  output_records.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/output.hpp"
+
+int test_output()
+{
+    Output::Record r {};
+    r.id = "say \"hi\"\t,";
+    r.fen = "4k3/8/8/8/8/8/8/4K3 w - - 0 1";
+    r.depth = 12;
+    r.legal_moves = 2;
+    r.eval = 0.25;
+    r.sharpness = 0.5;
+    r.seconds = 1.5;
+    r.moves = {{"Kd2", "e1d2", 0.25, 0, "good"}, {"Kf1", "e1f1", -0.75, 1, "bad"}};
+
+    {
+        std::cout << "[Test][output] JSON record - ";
+        std::string s;
+        Output::AppendJson(s, r);
+        bool ok = s == "{\"id\":\"say \\\"hi\\\"\\t,\",\"fen\":\"4k3/8/8/8/8/8/8/4K3 w - - 0 1\",\"depth\":12,"
+                       "\"legal_moves\":2,\"eval\":0.25,\"sharpness\":0.5,\"complexity\":null,\"good\":1,"
+                       "\"inaccuracies\":0,\"bad\":1,\"seconds\":1.5,\"moves\":["
+                       "{\"san\":\"Kd2\",\"lan\":\"e1d2\",\"eval\":0.25,\"loss\":0,\"verdict\":\"good\"},"
+                       "{\"san\":\"Kf1\",\"lan\":\"e1f1\",\"eval\":-0.75,\"loss\":1,\"verdict\":\"bad\"}]}\n";
+        if (!ok) {
+            std::cout << "Failed\n" << s << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][output] CSV record - ";
+        std::string s;
+        Output::AppendCsv(s, r);
+        bool ok = s == "\"say \"\"hi\"\"\t,\",4k3/8/8/8/8/8/8/4K3 w - - 0 1,12,2,0.25,0.5,,1,0,1,1.5,"
+                       "Kd2:0.25:good Kf1:-0.75:bad,\n";
+        if (!ok) {
+            std::cout << "Failed\n" << s << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][output] the writer keeps the order, whatever the queue capacity - ";
+        bool ok = true;
+        for (size_t capacity : {1, 3, 1024}) {
+            std::ostringstream os;
+            std::string expected;
+            Output::AppendCsvHeader(expected);
+            {
+                Output::Writer writer(os, Output::Format::Csv, capacity);
+                for (int i = 0; i < 2000; i++) {
+                    Output::Record ri = r;
+                    ri.id = std::to_string(i);
+                    Output::AppendCsv(expected, ri);
+                    writer.Push(std::move(ri));
+                }
+            }
+            ok &= os.str() == expected;
+        }
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    return 0;
+}
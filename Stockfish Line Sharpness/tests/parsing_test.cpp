@@ -12,6 +12,24 @@
 
 #include "../src/utils.hpp"
 #include "notation_translation.hpp"
+#include "fen_parsing.hpp"
+#include "canonical_fen.hpp"
+#include "move_counting.hpp"
+#include "pgn_parsing.hpp"
+#include "ingest_splitting.hpp"
+#include "trusted_replay.hpp"
+#include "position_dedupe.hpp"
+#include "output_records.hpp"
+#include "result_store.hpp"
+#include "sharpness_lookup.hpp"
+#include "journal_resume.hpp"
+#include "rescore_metrics.hpp"
+#include "quantile_sketch.hpp"
+#include "position_sampling.hpp"
+#include "engine_reactor.hpp"
+#include "engine_coroutines.hpp"
+#include "engine_plan.hpp"
+#include "engine_affinity.hpp"
 
 static const std::vector<std::string> output_example = {
     "info string NNUE evaluation using nn-0000000000a0.nnue",
@@ -75,4 +93,22 @@ int main()
 {
     test_translations();
     test_parsing();
+    test_fen();
+    test_canonical();
+    test_count_legal();
+    test_pgn();
+    test_ingest();
+    test_replay();
+    test_dedupe();
+    test_output();
+    test_store();
+    test_lookup();
+    test_journal();
+    test_rescore();
+    test_sketch();
+    test_sample();
+    test_reactor();
+    test_coro();
+    test_plan();
+    test_affinity();
 }
@@ -0,0 +1,56 @@
+//
+//  perft.cpp
+//  Perft
+//
+
+#include <stdio.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "../src/perft.hpp"
+
+static void s_print_usage()
+{
+    std::cout << "Usage is: perft [-d <depth>] [-t <threads>] [-H <MB>] [-f <EPD file>]\n";
+    std::cout << "\t -h prints this message" << '\n';
+    std::cout << "\t -d <int> maximum depth to run from the suite, default = 5" << '\n';
+    std::cout << "\t -t <int> threads splitting the root moves, default = 1" << '\n';
+    std::cout << "\t -H <int> hash table size in MB, default = 0 (disabled)" << '\n';
+    std::cout << "\t -f <path> EPD file with ';D<depth> <nodes>' operations, default = built-in suite" << '\n';
+    std::exit(0);
+}
+
+int main(int argc, char * const argv[])
+{
+    Perft::Options opts {};
+    std::string epd_path {};
+
+    int ch;
+    while ((ch = getopt(argc, argv, "hd:t:H:f:")) != -1) {
+        switch (ch) {
+            case 'd': opts.max_depth    = std::stoi(optarg); break;
+            case 't': opts.threads      = std::stoi(optarg); break;
+            case 'H': opts.hash_mb      = std::stoul(optarg); break;
+            case 'f': epd_path          = optarg; break;
+            default: s_print_usage();
+        }
+    }
+
+    Stockfish::Bitboards::init();
+    Stockfish::Position::init();
+
+    std::vector<Perft::EpdEntry> suite;
+    if (epd_path.empty()) {
+        std::istringstream is(Perft::StandardSuite);
+        suite = Perft::parse_epd(is);
+    } else {
+        std::ifstream is(epd_path);
+        if (!is) { std::cout << "Could not open " << epd_path << std::endl; return 1; }
+        suite = Perft::parse_epd(is);
+    }
+
+    return Perft::run_suite(suite, opts) ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+//
+//  pgn_parsing.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/pgn.hpp"
+#include "../src/notation.hpp"
+#include "../src/position.hpp"
+
+namespace Test {
+    namespace Pgn {
+        static const std::string Games = R"([Event "Quotes \"and\" backslashes \\"]
+[White "A"]
+[Black "B"]
+[Result "1-0"]
+
+{Before the first move} 1. e4 e5 2.Nf3 $1 {a good move} Nc6 3. Bb5 a6?! (3... Nf6 {the Berlin (solid)}
+4. O-O) 4. Ba4 Nf6 5. O-O Be7 ; rest of the line
+6. Re1 1-0
+
+[Event "From a position"]
+[FEN "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1"]
+
+1... c5 2. Nf3 d6!! *
+[Event "No result"]
+1. d4 d5
+)";
+
+        // the checks left unmarked, as some sources write them.
+        static const std::string Unmarked = R"(1. e4 e5 2. Bc4 Nc6 3. Bxf7 Kxf7 4. Qh5 g6 *
+
+1. e4 e5 2. Qh5 Nc6 3. Bc4 Nf6 4. Qxf7 1-0
+
+[FEN "5k2/8/8/8/8/8/8/4K2R w K - 0 1"]
+
+1. O-O *
+)";
+    }
+
+    bool SameGame(const ::Pgn::Game &a, const ::Pgn::Game &b)
+    {
+        if (a.tags != b.tags || a.comment != b.comment || a.result != b.result || a.plies.size() != b.plies.size())
+            return false;
+        for (size_t i = 0; i < a.plies.size(); i++)
+            if (a.plies[i].san != b.plies[i].san || a.plies[i].nags != b.plies[i].nags
+                || a.plies[i].comment != b.plies[i].comment) return false;
+        return true;
+    }
+}
+
+int test_pgn()
+{
+    std::vector<Pgn::Game> games;
+    {
+        std::istringstream is(Test::Pgn::Games);
+        Pgn::Reader reader(is);
+        for (Pgn::Game game; reader.Next(game); ) games.push_back(game);
+    }
+
+    std::cout << "[Test][pgn] games: " << games.size() << " - ";
+    if (games.size() != 3) {
+        std::cout << "Failed" << std::endl; std::abort();
+    } std::cout << "Passed" << std::endl;
+
+    {
+        const auto& g = games[0];
+        std::cout << "[Test][pgn] tags, movetext, comments and NAGs - ";
+        if (g.Tag("Event") != "Quotes \"and\" backslashes \\" || g.Tag("White") != "A" || g.result != "1-0"
+            || g.comment != "Before the first move" || g.plies.size() != 11
+            || g.plies[2].san != "Nf3" || g.plies[2].nags != std::vector<int>{1} || g.plies[2].comment != "a good move"
+            || g.plies[5].san != "a6" || g.plies[5].nags != std::vector<int>{6} || !g.plies[5].comment.empty()
+            || g.plies[6].san != "Ba4" // the variation is skipped
+            || g.plies[9].san != "Be7" || g.plies[9].comment != "rest of the line") {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        const auto& g = games[1];
+        std::cout << "[Test][pgn] game starting from a FEN - ";
+        if (g.InitialFen() != "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1" || g.result != "*"
+            || g.plies.size() != 3 || g.plies[0].san != "c5" || g.plies[2].nags != std::vector<int>{3}) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        const auto& g = games[2];
+        std::cout << "[Test][pgn] missing result - ";
+        if (g.InitialFen() != Pgn::StartFen || g.result != "*" || g.plies.size() != 2) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][pgn] written games read back the same - ";
+        std::stringstream ss;
+        for (const auto& g : games) Pgn::Write(ss, g);
+        Pgn::Reader reader(ss);
+        Pgn::Game game;
+        bool ok = true;
+        for (const auto& g : games) ok &= reader.Next(game) && Test::SameGame(g, game);
+        ok &= !reader.Next(game);
+
+        std::string line;
+        for (ss.clear(), ss.seekg(0); std::getline(ss, line); ) ok &= line.size() < 80;
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    {
+        std::cout << "[Test][pgn] checks and mates are marked in the SAN written back - ";
+        std::istringstream is(Test::Pgn::Unmarked);
+        Pgn::Reader reader(is);
+        std::vector<Pgn::Game> marked;
+        bool ok = true;
+        for (Pgn::Game game; reader.Next(game); marked.push_back(game)) {
+            ::Position pos(game.InitialFen());
+            for (auto& ply : game.plies) {
+                Move m = Notation::from_san(pos, ply.san);
+                Notation::MoveBuffer san;
+                Notation::to_san(pos, m, san, Notation::Checks::Pgn);
+                ok &= m != MOVE_NONE && Notation::from_san(pos, san) == m;
+                ply.san = san;
+                pos.DoMove(m);
+            }
+        }
+        ok &= marked.size() == 3 && marked[0].plies[4].san == "Bxf7+" && marked[0].plies[6].san == "Qh5+"
+           && marked[1].plies[6].san == "Qxf7#" && marked[2].plies[0].san == "O-O+";
+
+        std::stringstream ss;
+        for (const auto& g : marked) Pgn::Write(ss, g);
+        Pgn::Reader back(ss);
+        Pgn::Game game;
+        for (const auto& g : marked) ok &= back.Next(game) && Test::SameGame(g, game);
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    return 0;
+}
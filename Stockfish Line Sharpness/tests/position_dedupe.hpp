@@ -0,0 +1,110 @@
+//
+//  position_dedupe.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/canonical.hpp"
+#include "../src/dedupe.hpp"
+#include "../src/notation.hpp"
+#include "../src/position.hpp"
+#include "random_games.hpp"
+
+namespace Test {
+    namespace Dedupe {
+        // Games sharing their first moves (a narrow choice in the opening, then anything), plus the
+        // reference count of every canonical position computed with the validated path.
+        inline std::string OpeningGames(size_t count, std::map<Stockfish::Key, uint64_t> &reference)
+        {
+            return Test::RandomGames(count, {.seed = 3141, .plies = 100, .opening_plies = 8, .opening_width = 2,
+                                             .visit = [&](const ::Position &pos) { reference[::Canonical::key(pos)]++; }});
+        }
+
+        inline std::map<Stockfish::Key, uint64_t> Drain(::Dedupe::PositionSet &set, bool &fens_match)
+        {
+            std::map<Stockfish::Key, uint64_t> counts;
+            Stockfish::Key last {};
+            fens_match = true;
+            set.Drain([&](const ::Dedupe::Entry &e) {
+                fens_match &= counts.empty() || e.key > last;   // key order, no duplicates
+                fens_match &= ::Canonical::key(e.fen) == e.key;
+                counts[e.key] = e.count;
+                last = e.key;
+            });
+            return counts;
+        }
+    }
+}
+
+int test_dedupe()
+{
+    std::map<Stockfish::Key, uint64_t> reference;
+    auto pgn = Test::Dedupe::OpeningGames(400, reference);
+    bool fens_match;
+
+    {
+        std::cout << "[Test][dedupe] counts match the reference, in memory - ";
+        Dedupe::PositionSet set;
+        auto stats = Dedupe::AddGames(set, std::string_view(pgn));
+        auto counts = Test::Dedupe::Drain(set, fens_match);
+        if (stats.games != 400 || stats.rejected || set.runs() || counts != reference || !fens_match) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed (" << reference.size() << " unique positions)" << std::endl;
+    }
+    {
+        std::cout << "[Test][dedupe] counts match the reference, spilling to disk - ";
+        Dedupe::PositionSet set({.memory_mb = 1});
+        std::istringstream is(pgn);
+        Dedupe::AddGames(set, is);
+        auto counts = Test::Dedupe::Drain(set, fens_match);
+        if (set.runs() < 2 || counts != reference || !fens_match) {
+            std::cout << "Failed (" << set.runs() << " runs)" << std::endl; std::abort();
+        } std::cout << "Passed (" << set.runs() << " runs)" << std::endl;
+    }
+    {
+        std::cout << "[Test][dedupe] the Bloom filter drops the positions seen once, the others are exact - ";
+        std::map<Stockfish::Key, uint64_t> repeated;
+        for (const auto& [key, count] : reference)
+            if (count > 1) repeated[key] = count;
+
+        Dedupe::PositionSet set({.memory_mb = 1, .bloom_mb = 1});
+        Dedupe::AddGames(set, std::string_view(pgn));
+        auto counts = Test::Dedupe::Drain(set, fens_match);
+        if (counts != repeated || !fens_match) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed (" << repeated.size() << " repeated positions)" << std::endl;
+    }
+    {
+        std::cout << "[Test][dedupe] transpositions and counters, EPD output - ";
+        // 1. Nf3 Nf6 2. Nc3 Nc6 and 1. Nc3 Nc6 2. Nf3 Nf6 reach the same position, with other counters than
+        // the start position: the two are the only positions seen twice.
+        std::string games = "[Event \"a\"]\n\n1. Nf3 Nf6 2. Nc3 Nc6 *\n\n[Event \"b\"]\n\n1. Nc3 Nc6 2. Nf3 Nf6 *\n";
+        std::ostringstream out, log;
+        Dedupe::Run(std::string_view(games), out, log, {.min_count = 2});
+
+        std::vector<std::string> expected;
+        for (const auto fen : {Pgn::StartFen, "r1bqkb1r/pppppppp/2n2n2/8/8/2N2N2/PPPPPPPP/R1BQKB1R w KQkq - 4 3"}) {
+            char id[17];
+            std::snprintf(id, sizeof(id), "%016llx", static_cast<unsigned long long>(Canonical::key(fen)));
+            std::string epd(fen);
+            epd.erase(epd.rfind(' ', epd.rfind(' ') - 1));
+            expected.push_back(epd + " id \"" + id + "\"; c0 \"2\";");
+        }
+        std::vector<std::string> lines;
+        std::istringstream is(out.str());
+        for (std::string line; std::getline(is, line); ) lines.push_back(line);
+        std::sort(expected.begin(), expected.end());
+        std::sort(lines.begin(), lines.end());
+        bool ok = lines == expected;
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    return 0;
+}
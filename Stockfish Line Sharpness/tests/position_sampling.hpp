@@ -0,0 +1,181 @@
+//
+//  position_sampling.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/notation.hpp"
+#include "../src/position.hpp"
+#include "../src/sample.hpp"
+#include "random_games.hpp"
+
+namespace Test {
+    namespace Sample {
+        // Random games long enough to reach every phase, with their number of positions.
+        inline std::string RandomGames(size_t count, size_t &positions)
+        {
+            positions = 0;
+            return Test::RandomGames(count, {.seed = 2718, .plies = 160,
+                                             .visit = [&](const ::Position &) { positions++; }});
+        }
+
+        struct Stratum {
+            size_t kept {};
+            double weight {};
+        };
+
+        inline std::map<std::string, Stratum> Strata(const std::string &pgn, const ::Sample::Options &opts, std::string *out = nullptr)
+        {
+            std::map<std::string, Stratum> strata;
+            ::Sample::Sampler sampler(opts);
+            ::Sample::AddInput(sampler, std::string_view(pgn));
+            std::ostringstream os;
+            sampler.Drain([&](const ::Sample::Entry &e) {
+                auto& s = strata[std::string(e.stratum)];
+                s.kept++;
+                s.weight = e.weight;
+                ::Sample::WriteEntry(os, e);
+            });
+            if (out) *out = os.str();
+            return strata;
+        }
+
+        // The fullmove number of an entry written by WriteEntry().
+        inline int Fullmove(const std::string &line)
+        {
+            auto at = line.find("fmvn ");
+            return at == std::string::npos ? 0 : std::stoi(line.substr(at + 5));
+        }
+    }
+}
+
+int test_sample()
+{
+    size_t positions;
+    auto pgn = Test::Sample::RandomGames(300, positions);
+
+    {
+        std::cout << "[Test][sample] every item has the same chance to be kept - ";
+        std::vector<size_t> kept(100);
+        const size_t trials = 20'000;
+        for (size_t t = 0; t < trials; t++) {
+            Sample::Reservoir reservoir(10, t);
+            std::vector<size_t> slots(10);
+            for (size_t i = 0; i < kept.size(); i++)
+                if (auto slot = reservoir.Offer(); slot != Sample::Reservoir::NONE) slots[slot] = i;
+            for (const auto i : slots) kept[i]++;
+        }
+        // 2000 expected per item, the standard deviation is about 42.
+        auto [lo, hi] = std::minmax_element(kept.begin(), kept.end());
+        Sample::Reservoir big(10, 1);
+        for (size_t i = 0; i < 1'000'000; i++) big.Offer();
+        bool ok = *lo > 1800 && *hi < 2200 && big.size() == 10 && big.seen() == 1'000'000;
+        if (!ok) {
+            std::cout << "Failed (" << *lo << " to " << *hi << ")" << std::endl; std::abort();
+        } std::cout << "Passed (" << *lo << " to " << *hi << " in 2000 expected)" << std::endl;
+    }
+    {
+        std::cout << "[Test][sample] strata keep their share and weigh for the positions left out - ";
+        bool ok = true;
+        for (const auto strata : {"none", "phase", "material", "ply/20"}) {
+            Sample::Options all {.size = 1'000'000};
+            Sample::Options opts {.size = 50};
+            ok &= Sample::ParseStrata(strata, all) && Sample::ParseStrata(strata, opts);
+            auto whole = Test::Sample::Strata(pgn, all);
+            auto sampled = Test::Sample::Strata(pgn, opts);
+            size_t total = 0;
+            for (const auto& [name, s] : whole) total += s.kept;
+            ok &= total == positions && whole.size() == sampled.size();
+            for (const auto& [name, s] : sampled) {
+                const auto& w = whole[name];
+                ok &= w.weight == 1 && s.kept == std::min<size_t>(50, w.kept) && std::abs(s.weight * s.kept - w.kept) < 1e-6;
+            }
+        }
+        auto phases = Test::Sample::Strata(pgn, {.size = 50, .strata = Sample::Strata::Phase});
+        ok &= phases.size() == 3 && phases.count("opening") && phases.count("endgame");
+        for (const auto bad : {"elo", "ply/", "ply/0", "ply/x", "plys"}) {
+            Sample::Options opts;
+            ok &= !Sample::ParseStrata(bad, opts);
+        }
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][sample] same seed same sample, weighted means are unbiased - ";
+        std::string a, b, c;
+        Test::Sample::Strata(pgn, {.size = 40, .strata = Sample::Strata::Material, .seed = 7}, &a);
+        Test::Sample::Strata(pgn, {.size = 40, .strata = Sample::Strata::Material, .seed = 7}, &b);
+        Test::Sample::Strata(pgn, {.size = 40, .strata = Sample::Strata::Material, .seed = 8}, &c);
+        std::ostringstream streamed, log;
+        std::istringstream is(pgn);
+        Sample::Run(is, streamed, log, {.size = 40, .strata = Sample::Strata::Material, .seed = 7});
+        bool ok = a == b && a != c && streamed.str() == a && log.str().find("300 games (0 rejected)") != std::string::npos;
+
+        // the stratum of every position is its material.
+        std::istringstream lines(a);
+        for (std::string line; std::getline(lines, line); ) {
+            auto board = line.substr(0, line.find(' '));
+            auto stratum = line.substr(line.find("stratum \"") + 9);
+            stratum = stratum.substr(0, stratum.find('"'));
+            for (const char piece : std::string("QRBNPqrbnp")) {
+                auto side = piece < 'a' ? stratum.substr(0, stratum.find('v')) : stratum.substr(stratum.find('v'));
+                ok &= std::count(board.begin(), board.end(), piece) == std::count(side.begin(), side.end(), char(std::toupper(piece)));
+            }
+        }
+
+        // the mean fullmove number of the positions, against its estimates over a few seeds.
+        std::string all;
+        Test::Sample::Strata(pgn, {.size = 1'000'000}, &all);
+        double mean = 0;
+        std::istringstream all_lines(all);
+        for (std::string line; std::getline(all_lines, line); ) mean += Test::Sample::Fullmove(line);
+        mean /= double(positions);
+        double estimates = 0;
+        const int seeds = 20;
+        for (int seed = 0; seed < seeds; seed++) {
+            std::string sample;
+            Test::Sample::Strata(pgn, {.size = 30, .strata = Sample::Strata::Phase, .seed = uint64_t(seed)}, &sample);
+            double sum = 0, weights = 0;
+            std::istringstream sample_lines(sample);
+            for (std::string line; std::getline(sample_lines, line); ) {
+                double weight = std::stod(line.substr(line.find("weight \"") + 8));
+                sum += weight * Test::Sample::Fullmove(line);
+                weights += weight;
+            }
+            ok &= std::abs(weights - double(positions)) < 1e-6 * double(positions);    // weights are written with 10 digits
+            estimates += sum / weights;
+        }
+        estimates /= seeds;
+        ok &= std::abs(estimates - mean) < 0.05 * mean;
+        if (!ok) {
+            std::cout << "Failed (" << estimates << " for " << mean << ")" << std::endl; std::abort();
+        } std::cout << "Passed (" << estimates << " for " << mean << ")" << std::endl;
+    }
+    {
+        std::cout << "[Test][sample] EPD and FEN lines keep their operations - ";
+        std::string text = "# positions\n"
+                           "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 c0 \"start\";\r\n"
+                           "\n"
+                           "8/8/8/8 w - - id \"broken\";\n"
+                           "4k3/8/8/8/8/8/8/4K2R w K - id \"a; b\"; eco \"A00\";\n";
+        std::ostringstream out, log;
+        auto kept = Sample::Run(std::string_view(text), out, log, {.size = 10});
+        bool ok = kept == 2 && out.str() ==
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - hmvc 0; fmvn 1; c0 \"start\"; weight \"1\";\n"
+            "4k3/8/8/8/8/8/8/4K2R w K - id \"a; b\"; eco \"A00\"; weight \"1\";\n"
+            && log.str().find("3 lines (1 rejected), 2 positions") != std::string::npos;
+        if (!ok) {
+            std::cout << "Failed" << std::endl << out.str() << log.str(); std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+//
+//  quantile_sketch.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/sketch.hpp"
+
+namespace Test {
+    namespace Sketch {
+        // The rank of x in the sorted values, as a fraction.
+        inline double Rank(const std::vector<float> &sorted, float x)
+        {
+            auto lo = std::lower_bound(sorted.begin(), sorted.end(), x) - sorted.begin();
+            auto hi = std::upper_bound(sorted.begin(), sorted.end(), x) - sorted.begin();
+            return double(lo + hi) / 2 / double(sorted.size());
+        }
+
+        // Largest rank error over the quantiles of the report.
+        inline double RankError(const ::Sketch::Kll &kll, const std::vector<float> &sorted)
+        {
+            double error = 0;
+            for (const double q : {0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99})
+                error = std::max(error, std::abs(Rank(sorted, kll.Quantile(q)) - q));
+            return error;
+        }
+    }
+}
+
+int test_sketch()
+{
+    using namespace Stockfish;
+    PRNG rng(1729);
+    // sharpness-like values: most near 0, a long tail.
+    std::vector<float> values(1'000'000);
+    for (auto& x : values) {
+        double u = double(rng.rand<uint64_t>() % 1'000'000) / 1'000'000;
+        x = float(-std::log(1 - u) / 20);
+    }
+    std::vector<float> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+
+    {
+        std::cout << "[Test][sketch] quantiles within 1% of their rank, in a few KB - ";
+        Sketch::Kll kll;
+        for (const float x : values) kll.Add(x);
+        double error = Test::Sketch::RankError(kll, sorted);
+        bool ok = kll.count() == values.size() && error < 0.01 && kll.retained() < 1000
+               && kll.Quantile(0) >= sorted.front() && kll.Quantile(1) <= sorted.back() && Sketch::Kll().Quantile(0.5) == 0;
+        if (!ok) {
+            std::cout << "Failed (" << error << ")" << std::endl; std::abort();
+        } std::cout << "Passed (rank error " << error << ", " << kll.retained() << " values kept)" << std::endl;
+    }
+    {
+        std::cout << "[Test][sketch] shards merge into the sketch of the whole - ";
+        std::vector<Sketch::Kll> shards(16);
+        for (size_t i = 0; i < values.size(); i++) shards[i * 7 % shards.size()].Add(values[i]);
+        Sketch::Kll merged;
+        for (const auto& shard : shards) {
+            std::string bytes;
+            shard.Encode(bytes);
+            std::string_view in = bytes;
+            Sketch::Kll decoded;
+            if (!decoded.Decode(in) || !in.empty()) { std::cout << "Failed" << std::endl; std::abort(); }
+            merged.Merge(decoded);
+        }
+        double error = Test::Sketch::RankError(merged, sorted);
+        bool ok = merged.count() == values.size() && error < 0.015 && merged.retained() < 1000;
+        if (!ok) {
+            std::cout << "Failed (" << error << ")" << std::endl; std::abort();
+        } std::cout << "Passed (rank error " << error << ")" << std::endl;
+    }
+    {
+        std::cout << "[Test][sketch] groups by fields and bands - ";
+        Sketch::Grouping grouping("eco,WhiteElo/200,stm");
+        std::map<std::string, std::string> tags {{"eco", "B90"}, {"WhiteElo", "2251"}};
+        Sketch::Fields f {BLACK, 20, 30, 15, [&](std::string_view name) {
+            auto it = tags.find(std::string(name));
+            return it == tags.end() ? std::string() : it->second;
+        }};
+        bool ok = grouping.Key(f) == std::vector<std::string>{"B90", "2200-2399", "b"};
+        tags["WhiteElo"] = "-5";
+        tags.erase("eco");
+        ok &= grouping.Key(f) == std::vector<std::string>{"", "-200--1", "b"};
+        ok &= Sketch::Grouping("pieces/8,moves").Key(f) == std::vector<std::string>{"16-23", "30"};
+        for (const auto bad : {"eco,", "elo/0", "elo/x", ",stm"}) {
+            try { Sketch::Grouping g(bad); ok = false; } catch (const std::runtime_error &) {}
+        }
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][sketch] reports of separate runs merge, through their files - ";
+        const auto dir = std::filesystem::temp_directory_path();
+        const auto a_path = (dir / "line_sharpness_sketch_a.bin").string(), b_path = (dir / "line_sharpness_sketch_b.bin").string();
+        Sketch::Grouping grouping("ECO");
+        Sketch::Report a("totalvar", grouping), b("totalvar", grouping), whole("totalvar", grouping);
+        std::string eco;
+        Sketch::Fields f {WHITE, 32, 20, 15, [&](std::string_view) { return eco; }};
+        for (size_t i = 0; i < 100'000; i++) {
+            eco = i % 3 ? "C42" : "B90, \"Najdorf\"";
+            (i % 2 ? a : b).Add(f, values[i]);
+            whole.Add(f, values[i]);
+        }
+        a.Save(a_path);
+        b.Save(b_path);
+        auto merged = Sketch::Report::Load(a_path);
+        merged->Merge(*Sketch::Report::Load(b_path));
+
+        std::ostringstream merged_csv, whole_csv;
+        merged->Write(merged_csv);
+        whole.Write(whole_csv);
+        // counts, means, min and max are exact; the quantiles are not, but close.
+        auto exact = [](const std::string &csv) {
+            std::istringstream is(csv);
+            std::string out;
+            for (std::string line; std::getline(is, line); ) {
+                std::vector<std::string> cells;
+                std::string cell;
+                for (std::istringstream ls(line); std::getline(ls, cell, ','); ) cells.push_back(cell);
+                out += cells[0] + cells[cells.size() - 10] + cells[cells.size() - 9] + cells[cells.size() - 8] + cells.back() + '\n';
+            }
+            return out;
+        };
+        bool ok = merged->count() == 100'000 && merged->groups() == 2 && exact(merged_csv.str()) == exact(whole_csv.str())
+               && merged_csv.str().find("\"B90, \"\"Najdorf\"\"\",33334,") != std::string::npos
+               && merged_csv.str().rfind("ECO,count,mean,min,p10,", 0) == 0;
+
+        Sketch::Report other("ratio lc0 0.5 1.1 3", grouping);
+        try { merged->Merge(other); ok = false; } catch (const std::runtime_error &) {}
+        std::filesystem::resize_file(a_path, std::filesystem::file_size(a_path) - 3);
+        try { Sketch::Report::Load(a_path); ok = false; } catch (const std::runtime_error &) {}
+        std::filesystem::remove(a_path);
+        std::filesystem::remove(b_path);
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+//
+//  random_games.hpp
+//  Stockfish Line Sharpness
+//
+
+#ifndef random_games_hpp
+#define random_games_hpp
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../src/notation.hpp"
+#include "../src/position.hpp"
+
+namespace Test {
+
+    struct RandomGamesOptions {
+        uint64_t seed {1};
+        int plies {100};                                // at most, a game ends earlier on mate or stalemate
+        std::vector<std::string> roots {};              // game g starts from roots[g % size], the start position if none
+        // the first opening_plies moves are picked among the first opening_width legal ones, 0 for any:
+        // games that share their openings.
+        int opening_plies {};
+        size_t opening_width {};
+        std::function<std::string(int ply)> after {};   // written after the SAN of a ply, a space if not set
+        std::function<void(const ::Position&)> visit {};    // every position of the games, the roots included
+    };
+
+    // Random legal games written as PGN, the moves picked uniformly by a seeded PRNG: the same options
+    // give the same games. A game from a root other than the first one has its FEN tag.
+    inline std::string RandomGames(size_t count, const RandomGamesOptions &opts)
+    {
+        PRNG rng(opts.seed);
+        std::string pgn;
+        for (size_t g = 0; g < count; g++) {
+            const std::string root = opts.roots.empty() ? "" : opts.roots[g % opts.roots.size()];
+            ::Position pos {};
+            if (!root.empty()) pos.Set(root);
+            if (opts.visit) opts.visit(pos);
+
+            pgn += "[Event \"random " + std::to_string(g) + "\"]\n";
+            if (!opts.roots.empty() && g % opts.roots.size() != 0) pgn += "[SetUp \"1\"]\n[FEN \"" + root + "\"]\n";
+            pgn += "\n";
+            if (pos.side_to_move() == Stockfish::BLACK) pgn += std::to_string(pos.game_ply() / 2 + 1) + "... ";
+
+            for (int ply = 0; ply < opts.plies; ply++) {
+                auto moves = pos.GetMoves();
+                if (moves.size() == 0) break;
+                size_t width = moves.size();
+                if (ply < opts.opening_plies && opts.opening_width) width = std::min(width, opts.opening_width);
+                auto m = moves.begin()[rng.rand<uint64_t>() % width];
+                Notation::MoveBuffer san;
+                Notation::to_san(pos, m, san);
+                if (pos.side_to_move() == Stockfish::WHITE) pgn += std::to_string(pos.game_ply() / 2 + 1) + ". ";
+                pgn += san;
+                pgn += opts.after ? opts.after(ply) : " ";
+                pos.DoMove(m);
+                if (opts.visit) opts.visit(pos);
+            }
+            pgn += "*\n\n";
+        }
+        return pgn;
+    }
+}
+
+#endif /* random_games_hpp */
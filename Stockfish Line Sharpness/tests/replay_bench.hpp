@@ -0,0 +1,62 @@
+//
+//  replay_bench.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/ingest.hpp"
+#include "../src/notation.hpp"
+#include "../src/pgn.hpp"
+#include "../src/position.hpp"
+#include "../src/replay.hpp"
+#include "notation_bench.hpp"
+#include "random_games.hpp"
+
+// Replays the same games with the validated path (Pgn::Game, ::Position, from_san) and the trusted one.
+int bench_replay()
+{
+    using namespace Stockfish;
+    static const size_t GAMES = 2000;
+
+    size_t n_plies {};
+    auto pgn = Test::RandomGames(GAMES, {.seed = 4242, .plies = 200,
+                                         .after = [](int ply) { return ply % 8 == 7 ? "\n" : " "; },
+                                         .visit = [&](const ::Position &) { n_plies++; }});
+    n_plies -= GAMES;   // the start positions are not plies
+    std::vector<std::string_view> records;
+    Ingest::for_each_record(pgn, Ingest::Format::Pgn, [&](std::string_view r) { records.push_back(r); });
+    std::cout << "[Bench][replay] " << records.size() << " games, " << n_plies << " plies" << '\n';
+
+    size_t slow_plies {}, fast_plies {};
+    Key sink {};
+    auto slow = Bench::moves_per_second(n_plies, [&]{
+        Pgn::Game game;
+        for (const auto& record : records) {
+            Pgn::Parse(record, game);
+            ::Position pos(game.InitialFen());
+            for (const auto& ply : game.plies) {
+                pos.DoMove(Notation::from_san(pos, ply.san));
+                sink ^= pos.key();
+                slow_plies++;
+            }
+        }
+    });
+    auto fast = Bench::moves_per_second(n_plies, [&]{
+        Replay::Replayer replayer;
+        for (const auto& record : records)
+            fast_plies += Replay::replay_game(replayer, record, [&](const Stockfish::Position &pos) { sink ^= pos.key(); });
+    });
+    if (slow_plies != n_plies || fast_plies != n_plies) {
+        std::cout << "[Bench][replay] ply count mismatch: " << slow_plies << " / " << fast_plies << std::endl;
+        std::abort();
+    }
+
+    std::cout << "[Bench][replay] validated: " << slow << " plies/s" << '\n';
+    std::cout << "[Bench][replay] trusted:   " << fast << " plies/s (" << fast / slow << "x)" << '\n';
+    std::cout << "(checksum " << sink << ")" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+//
+//  rescore_bench.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/metrics.hpp"
+#include "../src/notation.hpp"
+#include "../src/position.hpp"
+#include "../src/store.hpp"
+#include "notation_bench.hpp"
+
+// Rescores a store of a million positions with all their moves: loading the blocks (under both mappings),
+// each metric on its own, then a ten step threshold sweep.
+int bench_rescore()
+{
+    using namespace Stockfish;
+    static const size_t ROWS = 1'000'000;
+    const auto path = (std::filesystem::temp_directory_path() / "line_sharpness_rescore_bench.bin").string();
+
+    auto fens = Bench::random_fens(1000);
+    PRNG rng(7);
+    size_t moves {};
+    {
+        std::vector<std::unique_ptr<::Position>> positions;
+        std::vector<Output::Record> records;
+        for (const auto& fen : fens) {
+            positions.push_back(std::make_unique<::Position>(fen));
+            Output::Record r {};
+            r.depth = 15;
+            for (const auto m : positions.back()->GetMoves()) {
+                Notation::MoveBuffer lan;
+                Notation::to_lan(m, lan);
+                r.moves.push_back({"", lan});
+            }
+            records.push_back(std::move(r));
+        }
+        Store::Writer writer(path);
+        for (size_t i = 0; i < ROWS; i++) {
+            auto& r = records[i % records.size()];
+            r.eval = double(rng.rand<uint64_t>() % 2001) / 1000 - 1;
+            for (auto& m : r.moves) m.eval = r.eval - double(rng.rand<uint64_t>() % 601) / 1000 + 0.05;
+            writer.Append(*positions[i % positions.size()], r);
+            moves += r.moves.size();
+        }
+    }
+
+    Store::Reader store(path);
+    Metrics::Batch batch {};
+    auto load = [&](Metrics::Mapping mapping) {
+        batch.mapping = mapping;
+        return Bench::moves_per_second(ROWS, [&]{
+            for (size_t b = 0; b < store.blocks(); b++) Metrics::Load(store, b, batch);
+        });
+    };
+    auto lc0_rps = load(Metrics::Mapping::Lc0);
+    auto lichess_rps = load(Metrics::Mapping::Lichess);
+
+    std::cout << "[Bench][rescore] " << ROWS << " positions, " << double(moves) / ROWS << " moves each" << '\n';
+    std::cout << "[Bench][rescore] load: " << lc0_rps << " positions/s (lc0), " << lichess_rps << " positions/s (lichess)" << '\n';
+
+    // the first block stands for the store, scored many times over.
+    batch.mapping = Metrics::Mapping::Lc0;
+    Metrics::Load(store, 0, batch);
+    std::vector<double> out(batch.size());
+    for (const auto name : {"totalvar", "ratio", "wdl"}) {
+        auto metric = Metrics::Make(name, {});
+        static const int ROUNDS = 50;
+        auto rps = Bench::moves_per_second(batch.size() * ROUNDS, [&]{
+            for (int i = 0; i < ROUNDS; i++) metric->Score(batch, out);
+        });
+        std::cout << "[Bench][rescore] " << name << ": " << rps << " positions/s, " << rps * double(batch.losses.size()) / batch.size() / 1e9 << " G moves/s" << '\n';
+    }
+
+    std::vector<std::unique_ptr<Metrics::Metric>> owned;
+    std::vector<const Metrics::Metric*> metrics;
+    for (int i = 0; i < 10; i++) {
+        owned.push_back(Metrics::Make("totalvar", {.inaccuracy = 0.1 * (i + 1)}));
+        metrics.push_back(owned.back().get());
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto summaries = Metrics::Sweep(store, Metrics::Mapping::Lc0, metrics);
+    std::chrono::duration<double> sweep = std::chrono::steady_clock::now() - start;
+    std::cout << "[Bench][rescore] totalvar sweep, 10 thresholds: " << sweep.count() << "s (mean " << summaries[0].mean
+    << " .. " << summaries.back().mean << ")" << std::endl;
+
+    std::filesystem::remove(path);
+    return 0;
+}
@@ -0,0 +1,207 @@
+//
+//  rescore_metrics.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "../src/metrics.hpp"
+#include "../src/notation.hpp"
+#include "../src/position.hpp"
+#include "../src/utils.hpp"
+
+namespace Test {
+    namespace Rescore {
+        // Sharpness::TotalVar as written, on the double evaluations of the engine.
+        inline double TotalVar(const std::vector<double> &evals, double base_eval, Stockfish::Color col, double threshold)
+        {
+            double tv {};
+            auto sorted_perm = Utils::sort_evals_perm(evals, col);
+            if (sorted_perm.size() < 2) return 0;
+            size_t i = 0;
+            double count = 0;
+            while (std::abs(base_eval - evals[sorted_perm[i]]) < threshold) {
+                tv += std::abs(evals[sorted_perm[i]] - evals[sorted_perm[i + 1]]);
+                count++;
+                i++;
+                if (i >= sorted_perm.size() - 1) break;
+            }
+            return count ? tv / count : 0;
+        }
+
+        // Evaluations end in .25 or .75 centipawns: no move is right on a threshold.
+        struct Position {
+            double eval;                    // centipawns, white's point of view
+            Stockfish::Color col;
+            std::vector<double> moves;
+        };
+
+        inline std::vector<Position> Random(size_t n, uint64_t seed)
+        {
+            PRNG rng(seed);
+            std::vector<Position> positions(n);
+            for (auto& p : positions) {
+                p.col = rng.rand<uint64_t>() % 2 ? Stockfish::BLACK : Stockfish::WHITE;
+                p.eval = double(rng.rand<uint64_t>() % 1601) - 800.25;
+                size_t moves = rng.rand<uint64_t>() % 40;
+                for (size_t j = 0; j < moves; j++) {
+                    // most moves lose a little, some a lot, a few are better than the position (shallower search).
+                    double loss = double(rng.rand<uint64_t>() % (j % 5 ? 120 : 900)) - 19.5;
+                    p.moves.push_back(p.col == Stockfish::WHITE ? p.eval - loss : p.eval + loss);
+                }
+            }
+            return positions;
+        }
+
+        inline Metrics::Batch Load(const std::vector<Position> &positions, Metrics::Mapping mapping)
+        {
+            Metrics::Batch batch {.mapping = mapping};
+            std::vector<float> evals;
+            for (const auto& p : positions) {
+                evals.clear();
+                for (const double cp : p.moves) evals.push_back(float(Utils::lc0_cp_to_win(cp)));
+                batch.Add(float(Utils::lc0_cp_to_win(p.eval)), p.col == Stockfish::BLACK, evals);
+            }
+            return batch;
+        }
+
+        inline std::vector<double> Score(std::string_view metric, const Metrics::Batch &batch, const Metrics::Params &params = {})
+        {
+            std::vector<double> out(batch.size());
+            Metrics::Make(metric, params)->Score(batch, out);
+            return out;
+        }
+    }
+}
+
+int test_rescore()
+{
+    using namespace Stockfish;
+    using Metrics::Mapping;
+    auto positions = Test::Rescore::Random(5000, 161803);
+    auto batch = Test::Rescore::Load(positions, Mapping::Lc0);
+    {
+        std::cout << "[Test][rescore] totalvar matches Sharpness::TotalVar - ";
+        bool ok = true;
+        for (const double inaccuracy : {0.5, 0.2, 1.0}) {
+            auto scores = Test::Rescore::Score("totalvar", batch, {.inaccuracy = inaccuracy});
+            const double threshold = std::abs(Utils::lc0_cp_to_win(inaccuracy * 100));
+            for (size_t i = 0; i < positions.size(); i++) {
+                const auto& p = positions[i];
+                std::vector<double> evals;
+                for (const double cp : p.moves) evals.push_back(float(Utils::lc0_cp_to_win(cp)));
+                double expected = Test::Rescore::TotalVar(evals, float(Utils::lc0_cp_to_win(p.eval)), p.col, threshold);
+                ok &= std::abs(scores[i] - expected) < 1e-6;
+            }
+        }
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][rescore] ratio and wdl count the moves as the verdicts do - ";
+        auto ratio = Test::Rescore::Score("ratio", batch, {.mistake = 2});
+        auto wdl = Test::Rescore::Score("wdl", batch);
+        bool ok = true;
+        // a mistake loses as much expected score as going from equality to -2 pawns.
+        const double mistake = std::abs(Utils::lc0_cp_to_win(200));
+        for (size_t i = 0; i < positions.size(); i++) {
+            const auto& p = positions[i];
+            const double sign = p.col == WHITE ? 1 : -1;
+            auto outcome = [](double cp) { return (cp > 300) - (cp < -300); };
+            size_t bad = 0, worse = 0;
+            for (const double cp : p.moves) {
+                bad += sign * (Utils::lc0_cp_to_win(p.eval) - Utils::lc0_cp_to_win(cp)) >= mistake;
+                worse += outcome(sign * cp) < outcome(sign * p.eval);
+            }
+            const double n = double(std::max<size_t>(p.moves.size(), 1));
+            ok &= ratio[i] == bad / n && wdl[i] == worse / n;
+        }
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+        std::cout << "[Test][rescore] unknown metric - ";
+        try { Metrics::Make("sharpest", {}); std::cout << "Failed" << std::endl; std::abort(); }
+        catch (const std::runtime_error &) { std::cout << "Passed" << std::endl; }
+    }
+    {
+        std::cout << "[Test][rescore] lichess mapping recomputes the losses from the centipawns - ";
+        auto lichess = Test::Rescore::Load(positions, Mapping::Lichess);
+        bool ok = lichess.size() == positions.size();
+        for (size_t i = 0; ok && i < positions.size(); i++) {
+            const auto& p = positions[i];
+            const double sign = p.col == WHITE ? 1 : -1;
+            std::vector<double> losses;
+            for (const double cp : p.moves)
+                losses.push_back(sign * (Metrics::Win(Mapping::Lichess, p.eval) - Metrics::Win(Mapping::Lichess, cp)));
+            std::sort(losses.begin(), losses.end());
+            ok &= lichess.offsets[i + 1] - lichess.offsets[i] == losses.size()
+               && std::abs(lichess.values[i] - sign * Metrics::Win(Mapping::Lichess, p.eval)) < 1e-4;
+            for (size_t j = 0; ok && j < losses.size(); j++)
+                ok &= std::abs(lichess.losses[lichess.offsets[i] + j] - losses[j]) < 1e-4;
+        }
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][rescore] store blocks load as the evaluations written, sweeps summarise them - ";
+        const auto path = (std::filesystem::temp_directory_path() / "line_sharpness_rescore_test.bin").string();
+        PRNG rng(31415);
+        Metrics::Batch expected {};
+        {
+            Store::Writer writer(path, 100);
+            ::Position pos {};
+            std::vector<float> evals;
+            while (expected.size() < 1000) {
+                auto moves = pos.GetMoves();
+                if (moves.size() == 0 || pos.game_ply() > 40) { pos.Set(Pgn::StartFen); continue; }
+                Output::Record r {};
+                r.depth = 12;
+                r.eval = float(double(rng.rand<uint64_t>() % 2001) / 1000 - 1);
+                evals.clear();
+                for (const auto m : moves) {
+                    Notation::MoveBuffer lan;
+                    Notation::to_lan(m, lan);
+                    evals.push_back(float(double(rng.rand<uint64_t>() % 2001) / 1000 - 1));
+                    r.moves.push_back({"", lan, evals.back()});
+                }
+                writer.Append(pos, r);
+                expected.Add(float(r.eval), pos.side_to_move() == BLACK, evals);
+                pos.DoMove(moves.begin()[rng.rand<uint64_t>() % moves.size()]);
+            }
+        }
+        Store::Reader store(path);
+        Metrics::Batch loaded {}, all {};
+        for (size_t b = 0; b < store.blocks(); b++) {
+            Metrics::Load(store, b, loaded);
+            for (size_t i = 0; i < loaded.size(); i++) {
+                all.values.push_back(loaded.values[i]);
+                all.losses.insert(all.losses.end(), loaded.losses.begin() + loaded.offsets[i], loaded.losses.begin() + loaded.offsets[i + 1]);
+                all.offsets.push_back(uint32_t(all.losses.size()));
+            }
+        }
+        bool ok = all.values == expected.values && all.offsets == expected.offsets && all.losses == expected.losses;
+
+        auto tight = Metrics::Make("ratio", {.mistake = 0.5}), loose = Metrics::Make("ratio", {.mistake = 2});
+        std::vector<const Metrics::Metric*> metrics {tight.get(), loose.get()};
+        auto summaries = Metrics::Sweep(store, Mapping::Lc0, metrics);
+        auto scores = Test::Rescore::Score("ratio", expected, {.mistake = 0.5});
+        double mean = std::accumulate(scores.begin(), scores.end(), 0.0) / scores.size();
+        std::nth_element(scores.begin(), scores.begin() + 499, scores.end());
+        ok &= summaries.size() == 2 && std::abs(summaries[0].mean - mean) < 1e-6 && summaries[0].p50 == float(scores[499])
+           && summaries[1].mean < summaries[0].mean && summaries[0].p90 <= summaries[0].p99;
+        std::filesystem::remove(path);
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+//
+//  result_store.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/canonical.hpp"
+#include "../src/notation.hpp"
+#include "../src/position.hpp"
+#include "../src/store.hpp"
+
+int test_store()
+{
+    using namespace Stockfish;
+    const auto path = (std::filesystem::temp_directory_path() / "line_sharpness_store_test.bin").string();
+
+    // Positions from random playouts, with made up results.
+    PRNG rng(777);
+    std::vector<std::string> fens;
+    std::vector<Output::Record> records;
+    {
+        Store::Writer writer(path, 100);
+        ::Position pos {};
+        while (records.size() < 1050) {
+            auto moves = pos.GetMoves();
+            if (moves.size() == 0 || pos.game_ply() > 120) { pos.Set(Pgn::StartFen); continue; }
+
+            Output::Record r {};
+            r.fen = pos.fen();
+            r.depth = 10 + int(rng.rand<uint64_t>() % 8);
+            r.eval = double(rng.rand<uint64_t>() % 2001) / 1000 - 1;
+            r.sharpness = double(rng.rand<uint64_t>() % 1001) / 1000;
+            for (const auto m : moves) {
+                Notation::MoveBuffer lan;
+                Notation::to_lan(m, lan);
+                r.moves.push_back({"", lan, double(rng.rand<uint64_t>() % 2001) / 1000 - 1, 0, "good"});
+            }
+            writer.Append(pos, r);
+            fens.push_back(Canonical::fen(pos));
+            records.push_back(std::move(r));
+
+            pos.DoMove(moves.begin()[rng.rand<uint64_t>() % moves.size()]);
+        }
+    }
+
+    Store::Reader reader(path);
+    {
+        std::cout << "[Test][store] every row reads back - ";
+        bool ok = reader.rows() == records.size() && reader.blocks() == 11;
+        for (uint64_t i = 0; ok && i < reader.rows(); i++) {
+            auto row = reader.row(i);
+            const auto& r = records[i];
+            ::Position pos(r.fen);
+            ok &= row.fen == fens[i] && row.key == Canonical::key(pos) && row.side_to_move == pos.side_to_move()
+               && row.depth == r.depth && row.eval == float(r.eval) && row.sharpness == float(r.sharpness)
+               && row.moves.size() == r.moves.size();
+            for (size_t j = 0; ok && j < row.moves.size(); j++) {
+                Notation::MoveBuffer lan;
+                Notation::to_lan(row.moves[j], lan);
+                ok &= r.moves[j].lan == lan && row.move_evals[j] == float(r.moves[j].eval);
+            }
+        }
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][store] sharpness scan - ";
+        std::vector<uint64_t> expected;
+        for (size_t i = 0; i < records.size(); i++)
+            if (float(records[i].sharpness) > 0.9f) expected.push_back(i);
+        bool ok = reader.SharpnessAbove(0.9f) == expected && reader.SharpnessAbove(1.0f).empty();
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed (" << expected.size() << " rows)" << std::endl;
+    }
+    {
+        std::cout << "[Test][store] a file that was not closed is rejected - ";
+        std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+        bool ok = false;
+        try { Store::Reader broken(path); } catch (const std::runtime_error &) { ok = true; }
+        std::filesystem::remove(path);
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+//
+//  sharpness_lookup.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../src/canonical.hpp"
+#include "../src/lookup.hpp"
+#include "../src/notation.hpp"
+#include "../src/position.hpp"
+#include "../src/store.hpp"
+
+int test_lookup()
+{
+    using namespace Stockfish;
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto store_path = (dir / "line_sharpness_lookup_test.bin").string();
+    const auto index_path = (dir / "line_sharpness_lookup_test.idx").string();
+
+    // Random playouts from the start position: the first plies come back many times, with another depth.
+    PRNG rng(2718);
+    std::map<Key, std::pair<int, uint64_t>> expected;    // key -> deepest, then latest, depth and row
+    std::vector<std::string> misses, fens;
+    {
+        Store::Writer writer(store_path, 64);
+        ::Position pos {};
+        uint64_t row = 0;
+        while (row < 3000) {
+            auto moves = pos.GetMoves();
+            if (moves.size() == 0 || pos.game_ply() > 60) { pos.Set(Pgn::StartFen); continue; }
+
+            Output::Record r {};
+            r.depth = 10 + int(rng.rand<uint64_t>() % 8);
+            r.eval = double(rng.rand<uint64_t>() % 2001) / 1000 - 1;
+            r.sharpness = double(rng.rand<uint64_t>() % 1001) / 1000;
+            for (const auto m : moves) {
+                Notation::MoveBuffer lan;
+                Notation::to_lan(m, lan);
+                r.moves.push_back({"", lan, double(rng.rand<uint64_t>() % 2001) / 1000 - 1});
+            }
+            writer.Append(pos, r);
+            fens.push_back(pos.fen());
+
+            auto [it, inserted] = expected.try_emplace(Canonical::key(pos), r.depth, row);
+            if (!inserted && r.depth >= it->second.first) it->second = {r.depth, row};
+            row++;
+
+            auto m = moves.begin()[rng.rand<uint64_t>() % moves.size()];
+            pos.DoMove(m);
+            // one ply further than the playouts go: stored only by a transposition, checked below.
+            if (pos.game_ply() == 61) misses.push_back(pos.fen());
+        }
+    }
+
+    std::erase_if(misses, [&](const auto &fen) { return expected.count(Canonical::key(fen)); });
+
+    Store::Reader store(store_path);
+    Lookup::Build(store, index_path);
+    Lookup::Index index(index_path);
+    {
+        std::cout << "[Test][lookup] every position finds its deepest analysis - ";
+        bool ok = index.size() == expected.size() && index.store_rows() == store.rows();
+        for (const auto& [key, e] : expected) {
+            auto slot = index.Find(key);
+            ok &= slot && slot->row == e.second && slot->depth == e.first;
+        }
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed (" << index.size() << " positions, " << store.rows() << " rows)" << std::endl;
+    }
+    {
+        std::cout << "[Test][lookup] records read back, the move counters do not matter - ";
+        // after 1. Nf3 Nf6 2. Ng1 Ng8 the start position has other counters.
+        ::Position pos {};
+        for (const auto san : {"Nf3", "Nf6", "Ng1", "Ng8"}) pos.DoMove(Notation::from_san(pos, san));
+        auto r = Lookup::Find(store, index, pos);
+        auto row = store.row(index.Find(Canonical::key(pos))->row);
+        bool ok = r && r->fen == pos.fen() && r->depth == row.depth && r->eval == double(row.eval)
+               && r->sharpness == double(row.sharpness) && r->legal_moves == 20 && r->moves.size() == 20;
+        for (size_t j = 0; ok && j < r->moves.size(); j++) {
+            const auto& m = r->moves[j];
+            ok &= Notation::from_san(pos, m.san) == row.moves[j] && Notation::from_lan(pos, m.lan) == row.moves[j]
+               && m.eval == double(row.move_evals[j]) && m.loss == r->eval - m.eval;
+        }
+        for (const auto& fen : misses) ok &= !Lookup::Find(store, index, ::Position(fen));
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed (" << misses.size() << " misses)" << std::endl;
+    }
+    {
+        std::cout << "[Test][lookup] a store written again with as many rows makes the index stale - ";
+        // the same positions with a single move each: the slots of the index point past the moves.
+        {
+            Store::Writer writer(store_path, 64);
+            for (const auto& fen : fens) {
+                ::Position pos(fen);
+                Output::Record r {};
+                r.depth = 5;
+                Notation::MoveBuffer lan;
+                Notation::to_lan(*pos.GetMoves().begin(), lan);
+                r.moves.push_back({"", lan, 0.5});
+                writer.Append(pos, r);
+            }
+        }
+        Store::Reader again(store_path);
+        bool ok = again.rows() == store.rows() && again.id() != index.store_id();
+        size_t found = 0;
+        for (const auto& fen : fens) {
+            ::Position pos(fen);
+            auto r = Lookup::Find(again, index, pos);
+            if (!r) continue;
+            found++;
+            for (const auto& m : r->moves) ok &= Notation::from_lan(pos, m.lan) != MOVE_NONE;
+        }
+        ok &= found < fens.size();
+
+        Lookup::Build(again, index_path);
+        Lookup::Index rebuilt(index_path);
+        ok &= rebuilt.store_id() == again.id();
+        for (const auto& fen : fens) {
+            auto r = Lookup::Find(again, rebuilt, ::Position(fen));
+            ok &= r && r->depth == 5 && r->moves.size() == 1;
+        }
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed (" << found << " stale hits)" << std::endl;
+    }
+    {
+        std::cout << "[Test][lookup] empty and corrupted indexes - ";
+        {
+            Store::Writer empty(store_path);
+        }
+        Store::Reader empty(store_path);
+        Lookup::Build(empty, index_path);
+        Lookup::Index none(index_path);
+        bool ok = none.size() == 0 && !none.Find(Canonical::key(Pgn::StartFen));
+
+        std::filesystem::resize_file(index_path, std::filesystem::file_size(index_path) + 8);
+        try { Lookup::Index broken(index_path); ok = false; } catch (const std::runtime_error &) {}
+        std::filesystem::remove(store_path);
+        std::filesystem::remove(index_path);
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,48 @@
+//
+//  sketch_bench.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/sketch.hpp"
+#include "notation_bench.hpp"
+
+// Values added to a sketch, then a thousand shard sketches merged into one, as a report of many runs would.
+int bench_sketch()
+{
+    using namespace Stockfish;
+    static const size_t VALUES = 20'000'000, SHARDS = 1000;
+
+    PRNG rng(11);
+    std::vector<float> values(1 << 20);
+    for (auto& x : values) x = float(-std::log(1 - double(rng.rand<uint64_t>() % 1'000'000) / 1'000'000) / 20);
+
+    Sketch::Kll kll;
+    auto add_vps = Bench::moves_per_second(VALUES, [&]{
+        for (size_t i = 0; i < VALUES; i++) kll.Add(values[i & (values.size() - 1)]);
+    });
+
+    std::vector<Sketch::Kll> shards(SHARDS);
+    for (size_t i = 0; i < SHARDS * 10'000; i++) shards[i % SHARDS].Add(values[i & (values.size() - 1)]);
+    Sketch::Kll merged;
+    auto merge_sps = Bench::moves_per_second(SHARDS, [&]{
+        for (const auto& shard : shards) merged.Merge(shard);
+    });
+
+    float median {};
+    auto quantile_qps = Bench::moves_per_second(10'000, [&]{
+        for (int i = 0; i < 10'000; i++) median += merged.Quantile(0.5);
+    });
+
+    std::string bytes;
+    kll.Encode(bytes);
+    std::cout << "[Bench][sketch] add: " << add_vps << " values/s, " << kll.retained() << " values kept ("
+    << bytes.size() << " bytes)" << '\n';
+    std::cout << "[Bench][sketch] merge: " << merge_sps << " sketches/s, quantile: " << 1e6 / quantile_qps
+    << " us (median " << median / 10'000 << ")" << std::endl;
+    return 0;
+}
@@ -0,0 +1,58 @@
+//
+//  store_bench.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/position.hpp"
+#include "../src/store.hpp"
+#include "notation_bench.hpp"
+
+// Writes a few million rows and scans the sharpness column, the scan should run at memory bandwidth.
+int bench_store()
+{
+    using namespace Stockfish;
+    static const size_t ROWS = 4'000'000;
+    const auto path = (std::filesystem::temp_directory_path() / "line_sharpness_store_bench.bin").string();
+
+    auto fens = Bench::random_fens(1000);
+    std::vector<std::unique_ptr<::Position>> positions;
+    for (const auto& fen : fens) positions.push_back(std::make_unique<::Position>(fen));
+
+    PRNG rng(99);
+    Output::Record r {};
+    r.depth = 15;
+    for (int i = 0; i < 4; i++) r.moves.push_back({"", "e2e4", 0.1, 0, "good"});
+
+    auto write_rps = Bench::moves_per_second(ROWS, [&]{
+        Store::Writer writer(path);
+        for (size_t i = 0; i < ROWS; i++) {
+            r.eval = double(rng.rand<uint64_t>() % 2001) / 1000 - 1;
+            r.sharpness = double(rng.rand<uint64_t>() % 10001) / 10000;
+            writer.Append(*positions[i % positions.size()], r);
+        }
+    });
+    auto file_bytes = std::filesystem::file_size(path);
+
+    Store::Reader reader(path);
+    size_t matches {}, column_bytes {};
+    for (size_t b = 0; b < reader.blocks(); b++) column_bytes += reader.block(b).bytes[Store::SHARPNESS];
+
+    static const int SCANS = 20;
+    auto scan_rps = Bench::moves_per_second(ROWS * SCANS, [&]{
+        for (int s = 0; s < SCANS; s++) matches += reader.SharpnessAbove(0.9f).size();
+    });
+
+    std::cout << "[Bench][store] " << ROWS << " rows, " << double(file_bytes) / ROWS << " bytes/row" << '\n';
+    std::cout << "[Bench][store] append: " << write_rps << " rows/s" << '\n';
+    std::cout << "[Bench][store] sharpness > 0.9 scan: " << scan_rps << " rows/s, "
+    << scan_rps * double(column_bytes) / ROWS / 1e9 << " GB/s (" << matches / SCANS << " matches)" << std::endl;
+
+    std::filesystem::remove(path);
+    return 0;
+}
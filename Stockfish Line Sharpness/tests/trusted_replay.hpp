@@ -0,0 +1,108 @@
+//
+//  trusted_replay.hpp
+//  Stockfish Line Sharpness
+//
+
+#include <deque>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/notation.hpp"
+#include "../src/pgn.hpp"
+#include "../src/position.hpp"
+#include "../src/ingest.hpp"
+#include "../src/replay.hpp"
+#include "random_games.hpp"
+
+namespace Test {
+    namespace Replay {
+        static const std::vector<std::string> Roots {
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+            "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+            "1r2k2r/1pPp1p2/1b3qpn/4pP1p/pPB1P1bn/3P1NP1/P2BQ1NP/R3K2R w KQk - 0 1",
+            "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+            "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1",
+        };
+
+        // Random legal games written as PGN, with the decorations the cursor has to skip.
+        inline std::string RandomGames(size_t count, uint64_t seed)
+        {
+            return Test::RandomGames(count, {.seed = seed, .plies = 300, // long enough to wrap the ring of states
+                                             .roots = Roots, .after = [](int ply) {
+                std::string s;
+                if (ply % 17 == 3) s += "!? $14";
+                if (ply % 23 == 5) s += " {a (comment)}";
+                if (ply % 29 == 7) s += " (1. e4 {no} (1. d4) e5)";
+                return s + (ply % 8 == 7 ? "\n" : " ");
+            }});
+        }
+    }
+}
+
+int test_replay()
+{
+    using namespace Stockfish;
+    {
+        std::cout << "[Test][replay] trusted SAN decodes every legal move - ";
+        bool ok = true;
+        for (const auto& root : Test::Replay::Roots) {
+            ::Position pos(root);
+            for (const auto m : pos.GetMoves()) {
+                Notation::MoveBuffer san;
+                Notation::to_san(pos, m, san);
+                ok &= Notation::from_trusted_san(pos, san) == m;
+            }
+        }
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][replay] movetext cursor - ";
+        const std::string game = "[Event \"x\"]\n[FEN \"4k3/8/8/8/8/8/8/R3K2R w KQ - 0 1\"]\n\n"
+                                 "% escaped\n1.O-O {c} 1...Kd7 $1 (1... Ke7 2. Ra7+) 2. Rd1+ ; line\n Kc6 1/2-1/2";
+        ::Replay::MovetextCursor cursor(game);
+        std::vector<std::string_view> sans;
+        for (std::string_view san; cursor.Next(san); ) sans.push_back(san);
+        bool ok = cursor.Fen() == "4k3/8/8/8/8/8/8/R3K2R w KQ - 0 1"
+               && sans == std::vector<std::string_view>{"O-O", "Kd7", "Rd1+", "Kc6"};
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed" << std::endl;
+    }
+    {
+        std::cout << "[Test][replay] fast replay matches the validated path at every ply - ";
+        auto pgn = Test::Replay::RandomGames(60, 2026);
+        std::istringstream is(pgn);
+        Pgn::Reader reader(is);
+        ::Replay::Replayer replayer;
+        Ingest::RecordCursor records(pgn, Ingest::Format::Pgn);
+
+        bool ok = true;
+        size_t games {}, plies {};
+        Pgn::Game game;
+        for (std::string_view record; ok && records.Next(record); games++) {
+            ok &= reader.Next(game);
+            ::Position slow(game.InitialFen());
+            size_t ply = 0;
+            int played = ::Replay::replay_game(replayer, record, [&](const Stockfish::Position &fast) {
+                if (ply >= game.plies.size()) { ok = false; return; }
+                Move m = Notation::from_san(slow, game.plies[ply++].san);
+                if (m == MOVE_NONE) { ok = false; return; }
+                slow.DoMove(m);
+                ok &= fast.key() == slow.key() && fast.fen() == slow.fen()
+                   && fast.checkers() == slow.checkers() && fast.rule50_count() == slow.rule50_count();
+            });
+            ok &= played == int(game.plies.size()) && ply == game.plies.size();
+            plies += ply;
+        }
+        ok &= games == 60 && !reader.Next(game);
+        if (!ok) {
+            std::cout << "Failed" << std::endl; std::abort();
+        } std::cout << "Passed (" << plies << " plies)" << std::endl;
+    }
+
+    return 0;
+}